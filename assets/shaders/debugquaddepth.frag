@@ -4,7 +4,9 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D depthMap;
+uniform sampler2DArray depthMap;
+// Shadow cascade to show
+uniform int layer;
 uniform float near_plane;
 uniform float far_plane;
 
@@ -17,8 +19,8 @@ float LinearizeDepth(float depth)
 
 void main()
 {             
-    float depthValue = texture(depthMap, TexCoords).r;
-    // FragColor = vec4(vec3(depthValue), 1.0); // orthographic
-    FragColor = vec4(vec3(LinearizeDepth(depthValue) / far_plane), 1.0); // perspective
+    float depthValue = texture(depthMap, vec3(TexCoords, layer)).r;
+    FragColor = vec4(vec3(depthValue), 1.0); // orthographic
+    // FragColor = vec4(vec3(LinearizeDepth(depthValue) / far_plane), 1.0); // perspective
     // FragColor = vec4(1.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
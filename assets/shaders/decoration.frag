@@ -1,4 +1,4 @@
-#version 330 core
+#version 400 core
 
 in vec3 worldNormal;
 in vec3 worldPosition;
@@ -7,7 +7,8 @@ in vec2 texcoord;
 layout(location = 0) out vec4 fragColor;
 
 uniform bool bLight;
-uniform sampler2D albedo;
+uniform sampler2DArray materialTextures[8];
+uniform ivec2 albedoLayer;
 uniform vec4 lightColor;
 
 void main(){
@@ -15,6 +16,6 @@ void main(){
 		fragColor = lightColor;
 	}
 	else {
-		fragColor = texture(albedo, texcoord) * 0.5;
+		fragColor = texture(materialTextures[albedoLayer.x], vec3(texcoord, albedoLayer.y)) * 0.5;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#version 430 core
+
+layout (location = 0) out vec4 fragColor;
+
+#include "lighting.glsl"
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+
+uniform float gamma = 2.2;
+uniform float gammaInversed = 1.0 / 2.2;
+
+// Matches GBufferMaterial
+struct SurfaceMaterial {
+	vec4 ambient;
+	vec4 diffuse;
+	// Shininess in w
+	vec4 specular;
+	// Reflection factor, refraction factor, eta
+	vec4 factors;
+	// Ke, ior in w
+	vec4 emission;
+};
+
+layout (std430, binding = 3) readonly buffer SurfaceMaterials {
+	SurfaceMaterial surfaceMaterials[];
+};
+
+vec3 decodeNormal(vec2 encoded) {
+	encoded = encoded * 2.0 - 1.0;
+
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+	if (normal.z < 0.0) {
+		normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	}
+
+	return normalize(normal);
+}
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	// Nothing was drawn here, keep the skybox
+	if (depth == 1.0) {
+		discard;
+	}
+
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+	vec4 position = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	position /= position.w;
+
+	vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+	vec3 normal = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+
+	SurfaceMaterial surface = surfaceMaterials[uint(albedo.a * 255.0 + 0.5)];
+
+	Material material;
+	material.Ka = surface.ambient.rgb;
+	material.Kd = surface.diffuse.rgb;
+	material.Ks = surface.specular.rgb;
+	material.Ke = surface.emission.rgb;
+	material.shininess = surface.specular.w;
+	material.reflectionFactor = surface.factors.x;
+	material.refractionFactor = surface.factors.y;
+	material.ior = surface.emission.w;
+	material.eta = surface.factors.z;
+	material.hasNormalMap = false;
+
+	float viewDepth = -(viewMatrix * vec4(position.xyz, 1.0)).z;
+	vec3 viewDirection = normalize(eye - position.xyz);
+
+	vec3 reflectionDirection = reflect(-viewDirection, normal);
+	vec3 refractionDirection = refract(-viewDirection, normal, material.eta);
+
+	vec3 finalColor = shadeSurface(position.xyz, viewDepth, normal, viewDirection, pow(albedo.rgb, vec3(gamma)), material, reflectionDirection, refractionDirection);
+
+	fragColor = vec4(pow(finalColor, vec3(gammaInversed)), 1.0);
+
+	// Later forward draws (ornaments, snowflakes) depth test against the scene
+	gl_FragDepth = depth;
+}
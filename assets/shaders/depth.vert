@@ -1,10 +1,40 @@
-#version 330 core
+#version 430 core
+
+// Permutations, see ShaderVariants
+#pragma feature INSTANCED
+#pragma feature TERRAIN
 
 layout (location = 0) in vec3 inPosition;
 
-uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
+#ifdef INSTANCED
+// Position and uniform scale of each instance, see SmokeSystem
+layout (std430, binding = 8) readonly buffer Instances {
+	vec4 instances[];
+};
+
+uniform int instanceOffset;
+// See TransformView::modelScale
+uniform vec3 modelScale = vec3(1.0);
+uniform mat4 viewProjection;
+#elif defined(TERRAIN)
+#include "terrain.glsl"
+
+uniform mat4 viewProjection;
+#else
+// lightSpaceMatrix * model
+uniform mat4 mvpMatrix;
+#endif
+
+// Must match scene.vert bit for bit, the depth pre-pass relies on GL_EQUAL
+invariant gl_Position;
 
 void main() {
-	gl_Position = lightSpaceMatrix * model * vec4(inPosition, 1.0);
+#ifdef INSTANCED
+	vec4 instance = instances[instanceOffset + gl_InstanceID];
+	gl_Position = viewProjection * vec4(inPosition * instance.w * modelScale + instance.xyz, 1.0);
+#elif defined(TERRAIN)
+	gl_Position = viewProjection * vec4(getTerrainVertex(inPosition.xz).position, 1.0);
+#else
+	gl_Position = mvpMatrix * vec4(inPosition, 1.0);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,8 @@
+#version 430 core
+
+// Fullscreen triangle from gl_VertexID, drawn without vertex buffers
+// (deferred lighting, shadow prefiltering)
+void main() {
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,59 @@
+#version 430 core
+
+// Permutations, see ShaderVariants
+#pragma feature NORMAL_MAP
+#pragma feature DOUBLE_SIDED
+
+in vec3 worldNormal;
+in vec3 tangentToWorld1;
+in vec3 tangentToWorld2;
+in vec3 tangentToWorld3;
+in vec2 texcoord;
+
+// See GBuffer for the layout
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec2 outNormal;
+
+// Material textures are layers of texture arrays (see TextureArrayPool),
+// x selects the array and y the layer
+uniform sampler2DArray materialTextures[8];
+uniform ivec2 diffuseLayer;
+uniform ivec2 normalLayer;
+
+// Index into the material table of the lighting pass
+uniform int materialId;
+
+// Octahedral mapping of a unit vector into [0, 1]^2
+vec2 encodeNormal(vec3 normal) {
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+
+	vec2 encoded = normal.xy;
+
+	if (normal.z < 0.0) {
+		encoded = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	}
+
+	return encoded * 0.5 + 0.5;
+}
+
+void main() {
+	vec3 normal = normalize(worldNormal);
+
+#ifdef NORMAL_MAP
+	normal = texture(materialTextures[normalLayer.x], vec3(texcoord, normalLayer.y)).rgb;
+	normal = normal * 2.0 - 1.0;
+	normal = normalize(vec3(dot(tangentToWorld1, normal), dot(tangentToWorld2, normal), dot(tangentToWorld3, normal)));
+#endif
+
+#ifdef DOUBLE_SIDED
+	if (!gl_FrontFacing) {
+		normal = -normal;
+	}
+#endif
+
+	// Gamma encoded, the lighting pass linearizes it like scene.frag does
+	vec3 albedo = texture(materialTextures[diffuseLayer.x], vec3(texcoord, diffuseLayer.y)).rgb;
+
+	outAlbedo = vec4(albedo, float(materialId) / 255.0);
+	outNormal = encodeNormal(normal);
+}
@@ -0,0 +1,331 @@
+// Lighting shared by scene.frag and deferred.frag, see Shader::loadSource()
+// for how it is included
+
+// Permutations, see ShaderVariants. At most one shadow filter is defined,
+// none means 3x3 PCF.
+#pragma feature HARDWARE_SHADOWS
+#pragma feature VARIANCE_SHADOWS
+#pragma feature EXPONENTIAL_SHADOWS
+#pragma feature POINT_LIGHTS
+
+struct Light{
+	vec4 color;
+	vec4 position;
+	vec3 direction;
+    float exponent;
+    float cutoff;
+	float outerCutoff;
+	float intensity;
+	float Kc;
+    float Kl;
+    float Kq;
+	int type;
+};
+
+struct Material{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+    vec3 Ke;
+    float shininess;
+    float reflectionFactor;
+    float refractionFactor;
+    // relative index of refraction(n1/n2)
+    float ior;
+    float eta;
+    bool hasNormalMap;
+};
+
+struct Fog {
+	float minDistance;
+	float maxDistance;
+	float density;
+	vec4 color;
+};
+
+uniform Light lights[5];
+
+// Clustered point lights, see LightClusters
+struct PointLight {
+	// Radius of influence in w
+	vec4 positionRadius;
+	// Premultiplied by intensity
+	vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer PointLights {
+	PointLight pointLights[];
+};
+
+// Offset into clusterLightIndices (x) and light count (y) per cluster
+layout (std430, binding = 1) readonly buffer Clusters {
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 2) readonly buffer ClusterLightIndices {
+	uint clusterLightIndices[];
+};
+
+const uvec3 ClusterCounts = uvec3(16, 9, 24);
+uniform float clusterNear;
+uniform float clusterFar;
+uniform vec2 clusterTanHalfFov;
+uniform mat4 viewMatrix;
+
+uniform Fog fog;
+
+uniform vec3 eye;
+
+uniform samplerCube skybox1;
+// Cascaded shadow maps, one layer per cascade
+const int CascadeCount = 4;
+uniform sampler2DArray shadowMap;
+uniform mat4 cascadeMatrices[CascadeCount];
+// View space distance where each cascade ends
+uniform float cascadeSplits[CascadeCount];
+
+#if defined(HARDWARE_SHADOWS)
+// shadowMap through a comparison sampler
+uniform sampler2DArrayShadow shadowMapCompare;
+#elif defined(VARIANCE_SHADOWS) || defined(EXPONENTIAL_SHADOWS)
+// Blurred moments of shadowMap, see ShadowFilter
+uniform sampler2DArray shadowMoments;
+uniform float shadowExponent;
+uniform float lightBleedingReduction;
+#endif
+
+uniform float ambientIntensity = 1.0;
+
+uniform float shadowmapBias;
+
+float computeAttenuation(Light light, float distance) {
+	return 1.0 / (light.Kc + light.Kl * distance + light.Kq * pow(distance, 2.0));
+}
+
+float computeLinearFog(Fog fog, float distance) {
+	return clamp((fog.maxDistance - distance) / (fog.maxDistance - fog.minDistance), 0.0, 1.0);
+}
+
+float computeExponentFog(Fog fog, float distance, float power) {
+	return exp(-pow(fog.density * distance, power));
+}
+
+vec3 blinnPhong(Light light, vec3 worldPosition, vec3 normal, vec3 viewDirection, vec3 albedo, Material material, out float dotLightNormal) {
+	vec3 lightDirection  = vec3(0.0);
+	float attenuation = 1.0;
+
+	if (light.position.w == 0.0) {
+		lightDirection = normalize(-light.position.xyz);
+		dotLightNormal = dot(normal, lightDirection);
+	}
+	else if (light.position.w >= 1.0) {
+		lightDirection = normalize(light.position.xyz - worldPosition);
+		float distance = length(worldPosition - light.position.xyz);
+		attenuation = computeAttenuation(light, distance);
+	}
+
+	float nDotL = dot(normal, lightDirection);
+	 
+	// Standard Lambert's law
+	vec3 diffuse = max(0.0, nDotL) * albedo * material.Kd;
+
+	// Half Lambert
+	// vec3 diffuse = (0.5 * nDotL + 0.5) * albedo * material.Kd;
+	
+	vec3 reflected = reflect(-lightDirection, normal);
+
+	vec3 halfVector = normalize(lightDirection + viewDirection);
+	
+	vec3 specular = vec3(0.0);
+
+	if(nDotL > 0.0) {
+		specular = pow(max(0.0, dot(halfVector, normal)), material.shininess) * albedo * material.Ks;
+	}
+
+	// Spot Light
+	// I = (θ - γ) / ϵ, ϵ = Φ - γ 
+	// θ = angle between spotlight direction and -lightDirection
+	// Φ = inner cone angle
+	// γ = outer cone angle
+	// see https://learnopengl.com/Lighting/Light-casters
+	if (light.position.w == 2.0) {
+		vec3 spotLightDirection = normalize(light.direction);
+		float theta = dot(-lightDirection, spotLightDirection);
+		float epsilon = light.cutoff - light.outerCutoff;
+		attenuation = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
+	}
+
+	return (diffuse + specular) * light.color.rgb * light.intensity * attenuation;
+	// return diffuse;
+	// return diffuse * light.color.rgb * light.intensity * attenuation;
+	// return vec3(nDotL);
+}
+
+vec3 clusteredPointLights(vec3 position, vec3 normal, vec3 viewDirection, vec3 albedo, Material material) {
+	vec3 viewPosition = (viewMatrix * vec4(position, 1.0)).xyz;
+	float depth = -viewPosition.z;
+
+	if (depth < clusterNear || depth > clusterFar) {
+		return vec3(0.0);
+	}
+
+	// Depth slices are exponential, matching LightClusters::binSlice()
+	uint slice = min(uint(log(depth / clusterNear) / log(clusterFar / clusterNear) * float(ClusterCounts.z)), ClusterCounts.z - 1);
+	vec2 ndc = viewPosition.xy / (depth * clusterTanHalfFov);
+	uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * vec2(ClusterCounts.xy), vec2(0.0), vec2(ClusterCounts.xy) - 1.0));
+
+	uvec2 cluster = clusters[(slice * ClusterCounts.y + tile.y) * ClusterCounts.x + tile.x];
+
+	vec3 color = vec3(0.0);
+
+	for (uint i = 0; i < cluster.y; i++) {
+		PointLight light = pointLights[clusterLightIndices[cluster.x + i]];
+
+		vec3 toLight = light.positionRadius.xyz - position;
+		float distance = length(toLight);
+		float radius = light.positionRadius.w;
+
+		if (distance >= radius) {
+			continue;
+		}
+
+		// Inverse square, windowed to reach zero at the radius
+		float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (distance * distance + 1.0);
+
+		vec3 lightDirection = toLight / max(distance, 0.0001);
+		float nDotL = dot(normal, lightDirection);
+
+		if (nDotL <= 0.0) {
+			continue;
+		}
+
+		vec3 halfVector = normalize(lightDirection + viewDirection);
+
+		vec3 diffuse = nDotL * albedo * material.Kd;
+		vec3 specular = pow(max(0.0, dot(halfVector, normal)), material.shininess) * albedo * material.Ks;
+
+		color += (diffuse + specular) * light.color.rgb * attenuation;
+	}
+
+	return color;
+}
+
+float shadowCalculation(vec3 position, float viewDepth, float dotLightNormal) {
+	// Beyond the last cascade nothing is shadowed
+	if (viewDepth > cascadeSplits[CascadeCount - 1]) {
+		return 1.0;
+	}
+
+	int cascade = CascadeCount - 1;
+
+	for (int i = 0; i < CascadeCount; i++) {
+		if (viewDepth < cascadeSplits[i]) {
+			cascade = i;
+			break;
+		}
+	}
+
+	// Orthographic, no perspective divide needed
+	vec3 projectedCoords = (cascadeMatrices[cascade] * vec4(position, 1.0)).xyz;
+
+	projectedCoords = projectedCoords * 0.5 + 0.5;
+
+	if (projectedCoords.z > 1.0) {
+		projectedCoords.z = 1.0;
+	}
+
+	float bias = max(shadowmapBias * (1.0 - dotLightNormal), 0.0005);
+
+	float currentDepth = projectedCoords.z;
+
+#if defined(HARDWARE_SHADOWS)
+	{
+		// Each fetch compares and bilinearly weights 4 texels
+		vec2 texelSize = 1.0 / textureSize(shadowMapCompare, 0).xy;
+		float shadow = 0.0;
+
+		for (int x = 0; x < 2; x++) {
+			for (int y = 0; y < 2; y++) {
+				vec2 offset = (vec2(x, y) - 0.5) * texelSize;
+				shadow += texture(shadowMapCompare, vec4(projectedCoords.xy + offset, cascade, currentDepth - shadowmapBias));
+			}
+		}
+
+		return shadow * 0.25;
+	}
+#elif defined(VARIANCE_SHADOWS)
+	{
+		vec2 moments = texture(shadowMoments, vec3(projectedCoords.xy, cascade)).rg;
+
+		if (currentDepth - shadowmapBias <= moments.x) {
+			return 1.0;
+		}
+
+		// Chebyshev upper bound of the lit fraction
+		float variance = max(moments.y - moments.x * moments.x, 0.00002);
+		float difference = currentDepth - moments.x;
+		float litFraction = variance / (variance + difference * difference);
+
+		return clamp((litFraction - lightBleedingReduction) / (1.0 - lightBleedingReduction), 0.0, 1.0);
+	}
+#elif defined(EXPONENTIAL_SHADOWS)
+	{
+		float occluder = texture(shadowMoments, vec3(projectedCoords.xy, cascade)).r;
+
+		return clamp(occluder * exp(-shadowExponent * (currentDepth - shadowmapBias)), 0.0, 1.0);
+	}
+#else
+	// PCF (Percentage-Closer Filter)
+	float shadow = 0.0;
+	vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			float closestDepth = texture(shadowMap, vec3(projectedCoords.xy + vec2(x, y) * texelSize, cascade)).r;
+			shadow += (closestDepth + shadowmapBias) < currentDepth ? 0.0 : 1.0;
+		}
+	}
+
+	return shadow / 9.0;
+#endif
+}
+
+// Everything after the surface inputs are known, shared by forward shading
+// (scene.frag) and the deferred lighting pass (deferred.frag). Returns linear
+// color.
+vec3 shadeSurface(vec3 position, float viewDepth, vec3 normal, vec3 viewDirection, vec3 albedo, Material material, vec3 reflectionDirection, vec3 refractionDirection) {
+	vec3 ambient = material.Ka * albedo * ambientIntensity;
+
+	float dotLightNormal = 0.0;
+
+	vec3 light1 = blinnPhong(lights[0], position, normal, viewDirection, albedo, material, dotLightNormal);
+
+	vec3 light2 = blinnPhong(lights[1], position, normal, viewDirection, albedo, material, dotLightNormal);
+
+	vec3 light3 = blinnPhong(lights[2], position, normal, viewDirection, albedo, material, dotLightNormal);
+
+	vec3 light4 = blinnPhong(lights[3], position, normal, viewDirection, albedo, material, dotLightNormal);
+
+	vec3 light5 = blinnPhong(lights[4], position, normal, viewDirection, albedo, material, dotLightNormal);
+
+	float distance = length(eye - position);
+
+	float fogFactor = computeExponentFog(fog, distance, 2.0);
+
+	float shadow = shadowCalculation(position, viewDepth, dotLightNormal);
+
+	// Point lights don't cast shadows
+#ifdef POINT_LIGHTS
+	vec3 pointLight = clusteredPointLights(position, normal, viewDirection, albedo, material);
+#else
+	vec3 pointLight = vec3(0.0);
+#endif
+
+	// Emission (Ke) is neither lit nor shadowed, only fogged
+	vec3 finalColor = mix(fog.color.rgb, (light1 + light2 + light3 + light4 + light5) * shadow + pointLight + ambient + material.Ke, fogFactor);
+
+	vec4 reflectionColor = texture(skybox1, reflectionDirection);
+	vec4 refractionColor = texture(skybox1, refractionDirection);
+
+	return mix(mix(vec4(finalColor, 1.0), reflectionColor, material.reflectionFactor), refractionColor, material.refractionFactor).rgb;
+}
@@ -0,0 +1,59 @@
+#version 430 core
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexcoord;
+
+// See particles.comp
+struct Flake {
+	vec4 positionAge;
+	vec4 state;
+};
+
+layout (std430, binding = 4) readonly buffer Particles {
+	Flake particles[];
+};
+
+layout (std430, binding = 6) readonly buffer Visible {
+	uint visible[];
+};
+
+uniform mat4 viewProjection;
+uniform vec3 eye;
+
+#include "particle_lod.glsl"
+
+out vec2 texcoord;
+
+// Same as glm::rotate()
+mat3 axisRotation(vec3 axis, float angle) {
+	float s = sin(angle);
+	float c = cos(angle);
+	vec3 t = (1.0 - c) * axis;
+
+	return mat3(c + t.x * axis.x, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+				t.y * axis.x - s * axis.z, c + t.y * axis.y, t.y * axis.z + s * axis.x,
+				t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, c + t.z * axis.z);
+}
+
+void main() {
+	Flake flake = particles[visible[gl_InstanceID]];
+
+	vec3 position = flake.positionAge.xyz;
+
+	// Camera facing, spinning quad, as getParticleWorldMatrix() builds it
+	vec3 forward = normalize(eye - position);
+	vec3 up = vec3(0.0, 1.0, 0.0);
+	vec3 right = cross(forward, up);
+
+	mat3 rotation = transpose(mat3(right, up, forward));
+	mat3 spin = axisRotation(forward, radians(flake.state.x));
+
+	// Stands in for the thinned out flakes around it
+	float size = 0.3 * inversesqrt(flakeKeepFraction(distance(eye, position)));
+
+	vec3 worldPosition = rotation * spin * (inPosition * size) + position;
+
+	texcoord = inTexcoord;
+	gl_Position = viewProjection * vec4(worldPosition, 1.0);
+}
@@ -0,0 +1,16 @@
+// Distance thinning of the snow, see ParticleLod
+
+uniform float lodNear;
+uniform float lodFar;
+uniform float lodMerge = 1.0;
+
+// ParticleLod::getKeepFraction()
+float flakeKeepFraction(float distance) {
+	float t = clamp((distance - lodNear) / max(lodFar - lodNear, 0.001), 0.0, 1.0);
+	return mix(1.0, 1.0 / lodMerge, t);
+}
+
+// ParticleLod::getFlakeKey()
+float flakeKey(float gravityEffect) {
+	return fract(gravityEffect * 4099.0);
+}
@@ -1,4 +1,8 @@
-#version 330 core
+#version 430 core
+
+// Permutations, see ShaderVariants
+#pragma feature INSTANCED
+#pragma feature TERRAIN
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inTangent;
@@ -6,15 +10,39 @@ layout (location = 2) in vec3 inBinormal;
 layout (location = 3) in vec3 inNormal;
 layout (location = 4) in vec2 inTexcoord;
 
-uniform mat4 worldMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+
+#ifdef INSTANCED
+// Position and uniform scale of each instance, see SmokeSystem
+layout (std430, binding = 8) readonly buffer Instances {
+	vec4 instances[];
+};
+
+uniform int instanceOffset;
+// See TransformView::modelScale
+uniform vec3 modelScale = vec3(1.0);
+
+// Built per instance at the start of main()
+mat4 worldMatrix;
+mat4 normalMatrix;
+mat4 mvpMatrix;
+#elif defined(TERRAIN)
+#include "terrain.glsl"
+
+// Same product as depth.vert, the depth pre-pass relies on GL_EQUAL
+uniform mat4 viewProjection;
+
+// Tiles are in world space already
+mat4 worldMatrix = mat4(1.0);
+mat4 normalMatrix = mat4(1.0);
+#else
+uniform mat4 worldMatrix;
 uniform mat4 normalMatrix;
 uniform mat4 mvpMatrix;
-uniform mat4 lightSpaceMatrix;
+#endif
 uniform mat4 projectorTransform;
 uniform vec3 eye;
-uniform bool drawSkybox = false;
 
 out vec3 worldNormal;
 out vec3 worldViewDirection;
@@ -27,7 +55,11 @@ out vec3 reflectionDirection;	// Reflected direction
 out vec3 refractionDirection;	// Transmitted direction
 out vec4 projectorTexcoord;
 out vec3 fragPos;
-out vec4 fragPosLightSpace;
+// Distance along the view direction, selects the shadow cascade
+out float viewDepth;
+
+// Must match depth.vert bit for bit, the depth pre-pass relies on GL_EQUAL
+invariant gl_Position;
 
 struct Material{
 	vec3 Ka;
@@ -46,25 +78,43 @@ struct Material{
 uniform Material material;
 
 void main() {
-	if (drawSkybox) {
-		// inPosition - origin(0, 0, 0) = inPosition
-		reflectionDirection = inPosition;
-	}
-	else {
-		worldPosition = (worldMatrix * vec4(inPosition, 1.0)).xyz;
-		worldNormal = normalize((transpose(inverse(worldMatrix)) * vec4(inNormal, 0.0)).xyz);
-		worldViewDirection = normalize(eye - worldPosition);
-		reflectionDirection = reflect(-worldViewDirection, worldNormal);
-		refractionDirection = refract(-worldViewDirection, worldNormal, material.eta);
-
-		projectorTexcoord = projectorTransform * vec4(worldPosition, 1.0);
-		projectorTexcoord = vec4(projectorTexcoord.xyz * 0.5 + 0.5 * projectorTexcoord.w, projectorTexcoord.w);
-
-		fragPos = vec3(worldMatrix * vec4(inPosition, 1.0));
-		fragPosLightSpace = lightSpaceMatrix * vec4(fragPos, 1.0);
-	}
-
-	vec3 worldTangent = normalize((worldMatrix * vec4(inTangent, 0.0)).xyz);
+	vec3 vertexPosition = inPosition;
+	vec3 vertexNormal = inNormal;
+	vec3 vertexTangent = inTangent;
+	vec2 vertexTexcoord = inTexcoord;
+
+#ifdef TERRAIN
+	TerrainVertex terrain = getTerrainVertex(inPosition.xz);
+	vertexPosition = terrain.position;
+	vertexNormal = terrain.normal;
+	vertexTangent = terrain.tangent;
+	vertexTexcoord = terrain.texcoord;
+#endif
+
+#ifdef INSTANCED
+	vec4 instance = instances[instanceOffset + gl_InstanceID];
+	vec3 scale = instance.w * modelScale;
+
+	worldMatrix = mat4(vec4(scale.x, 0.0, 0.0, 0.0), vec4(0.0, scale.y, 0.0, 0.0), vec4(0.0, 0.0, scale.z, 0.0), vec4(instance.xyz, 1.0));
+	normalMatrix = mat4(transpose(inverse(mat3(worldMatrix))));
+	mvpMatrix = projectionMatrix * viewMatrix * worldMatrix;
+#endif
+
+	worldPosition = (worldMatrix * vec4(vertexPosition, 1.0)).xyz;
+	worldNormal = normalize(mat3(normalMatrix) * vertexNormal);
+	worldViewDirection = normalize(eye - worldPosition);
+	reflectionDirection = reflect(-worldViewDirection, worldNormal);
+	refractionDirection = refract(-worldViewDirection, worldNormal, material.eta);
+
+#ifdef PROJECTOR
+	projectorTexcoord = projectorTransform * vec4(worldPosition, 1.0);
+	projectorTexcoord = vec4(projectorTexcoord.xyz * 0.5 + 0.5 * projectorTexcoord.w, projectorTexcoord.w);
+#endif
+
+	fragPos = vec3(worldMatrix * vec4(vertexPosition, 1.0));
+	viewDepth = -(viewMatrix * vec4(worldPosition, 1.0)).z;
+
+	vec3 worldTangent = normalize((worldMatrix * vec4(vertexTangent, 0.0)).xyz);
 	vec3 worldBinormal = normalize(cross(worldNormal, worldTangent)); // normalize(worldMatrix * vec4(inBinormal, 0.0)).xyz);
 
 	worldTangent = normalize(worldTangent - dot(worldTangent, worldNormal) * worldNormal);
@@ -77,11 +127,15 @@ void main() {
 	tangentToWorld2 = vec3(worldTangent.y, worldBinormal.y, worldNormal.y);
 	tangentToWorld3 = vec3(worldTangent.z, worldBinormal.z, worldNormal.z);
 
-	texcoord = inTexcoord;
+	texcoord = vertexTexcoord;
 
 	// gl_Position = viewMatrix * worldMatrix * vec4(inPosition, 1.0);
 	// gl_Position = worldMatrix * vec4(inPosition, 1.0);
 	// gl_Position = vec4(inPosition, 1.0);
 	// gl_Position = projectionMatrix * vec4(inPosition, 1.0);
-	gl_Position = mvpMatrix * vec4(inPosition, 1.0);
+#ifdef TERRAIN
+	gl_Position = viewProjection * vec4(vertexPosition, 1.0);
+#else
+	gl_Position = mvpMatrix * vec4(vertexPosition, 1.0);
+#endif
 }
\ No newline at end of file
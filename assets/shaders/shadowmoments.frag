@@ -0,0 +1,63 @@
+#version 430 core
+
+layout (location = 0) out vec4 outMoments;
+
+// Cascade depth array (bFromDepth) or the horizontally blurred moments
+uniform sampler2DArray source;
+uniform int layer;
+uniform bool bFromDepth;
+// Blur axis in texels
+uniform ivec2 direction;
+// Depth texels per moments texel
+uniform int downsample;
+// Matches ShadowFilterMode
+uniform int filterMode;
+uniform float exponent;
+
+const int ShadowFilterVariance = 2;
+
+// 5 tap binomial kernel
+const float weights[3] = float[](0.375, 0.25, 0.0625);
+
+vec2 computeMoments(float depth) {
+	if (filterMode == ShadowFilterVariance) {
+		return vec2(depth, depth * depth);
+	}
+
+	return vec2(exp(exponent * depth), 0.0);
+}
+
+// Box filtered moments of the depth texels under one moments texel
+vec2 fetchDepthMoments(ivec2 texel) {
+	ivec2 size = textureSize(source, 0).xy;
+	vec2 moments = vec2(0.0);
+
+	for (int y = 0; y < downsample; y++) {
+		for (int x = 0; x < downsample; x++) {
+			ivec2 depthTexel = clamp(texel * downsample + ivec2(x, y), ivec2(0), size - 1);
+			moments += computeMoments(texelFetch(source, ivec3(depthTexel, layer), 0).r);
+		}
+	}
+
+	return moments / float(downsample * downsample);
+}
+
+vec2 fetchMoments(ivec2 texel) {
+	if (bFromDepth) {
+		return fetchDepthMoments(clamp(texel, ivec2(0), textureSize(source, 0).xy / downsample - 1));
+	}
+
+	return texelFetch(source, ivec3(clamp(texel, ivec2(0), textureSize(source, 0).xy - 1), layer), 0).rg;
+}
+
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	vec2 moments = fetchMoments(texel) * weights[0];
+
+	for (int i = 1; i < 3; i++) {
+		moments += (fetchMoments(texel + direction * i) + fetchMoments(texel - direction * i)) * weights[i];
+	}
+
+	outMoments = vec4(moments, 0.0, 1.0);
+}
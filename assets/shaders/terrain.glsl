@@ -0,0 +1,86 @@
+// Terrain tiles, see TerrainSystem. Each instance is a quadtree node drawing
+// the shared grid, whose positions are grid coordinates in [0, terrainGridSize],
+// or a quarter of the node drawing the grid's first quadrant moved over.
+// The grid is displaced by the node's layer of terrainHeights and morphed
+// towards the next coarser grid over the node's morph range (CDLOD).
+
+struct TerrainTile {
+	// xz of the minimum corner, size, layer of terrainHeights
+	vec4 originSizeLayer;
+	// Morph start and end distance, quadrant drawn or -1 for all
+	vec4 morph;
+};
+
+layout (std430, binding = 9) readonly buffer TerrainTiles {
+	TerrainTile terrainTiles[];
+};
+
+uniform int terrainTileOffset;
+uniform sampler2DArray terrainHeights;
+uniform float terrainGridSize;
+// The camera's, in every pass, so shadows see the same morph
+uniform vec3 terrainEye;
+uniform float terrainTexcoordScale;
+
+struct TerrainVertex {
+	vec3 position;
+	vec3 normal;
+	vec3 tangent;
+	vec2 texcoord;
+};
+
+// Tiles have a border of one sample, grid vertex (0, 0) is texel (1, 1)
+float terrainHeightAt(ivec2 grid, int layer) {
+	return texelFetch(terrainHeights, ivec3(grid + 1, layer), 0).r;
+}
+
+float terrainHeight(vec2 grid, int layer) {
+	vec2 base = floor(grid);
+	vec2 weight = grid - base;
+	ivec2 corner = ivec2(base);
+
+	float h00 = terrainHeightAt(corner, layer);
+	float h10 = terrainHeightAt(corner + ivec2(1, 0), layer);
+	float h01 = terrainHeightAt(corner + ivec2(0, 1), layer);
+	float h11 = terrainHeightAt(corner + ivec2(1, 1), layer);
+
+	return mix(mix(h00, h10, weight.x), mix(h01, h11, weight.x), weight.y);
+}
+
+TerrainVertex getTerrainVertex(vec2 grid) {
+	TerrainTile tile = terrainTiles[terrainTileOffset + gl_InstanceID];
+
+	vec2 origin = tile.originSizeLayer.xy;
+	float spacing = tile.originSizeLayer.z / terrainGridSize;
+	int layer = int(tile.originSizeLayer.w);
+	int quadrant = int(tile.morph.z);
+
+	// By half the grid, even, so odd vertices stay odd
+	if (quadrant >= 0) {
+		grid += vec2(quadrant & 1, quadrant >> 1) * (terrainGridSize * 0.5);
+	}
+
+	// How far the vertex moves depends on where it is unmorphed
+	vec3 position = vec3(origin.x + grid.x * spacing, terrainHeightAt(ivec2(grid), layer), origin.y + grid.y * spacing);
+	float morph = clamp((distance(terrainEye, position) - tile.morph.x) / (tile.morph.y - tile.morph.x), 0.0, 1.0);
+
+	// Odd vertices slide onto their even neighbour, a vertex of the coarser
+	// grid, and take its height once there
+	vec2 morphed = grid - mod(grid, 2.0) * morph;
+
+	TerrainVertex vertex;
+	vertex.position = vec3(origin.x + morphed.x * spacing, terrainHeight(morphed, layer), origin.y + morphed.y * spacing);
+
+	// Central differences around the nearest sample
+	ivec2 nearest = ivec2(morphed + 0.5);
+	float left = terrainHeightAt(nearest - ivec2(1, 0), layer);
+	float right = terrainHeightAt(nearest + ivec2(1, 0), layer);
+	float back = terrainHeightAt(nearest - ivec2(0, 1), layer);
+	float front = terrainHeightAt(nearest + ivec2(0, 1), layer);
+
+	vertex.normal = normalize(vec3(left - right, 2.0 * spacing, back - front));
+	vertex.tangent = normalize(vec3(2.0 * spacing, right - left, 0.0));
+	vertex.texcoord = vertex.position.xz * terrainTexcoordScale;
+
+	return vertex;
+}
@@ -0,0 +1,176 @@
+#include "Harness.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace {
+	// Linear interpolation between the closest ranks of sorted samples
+	double percentile(const std::vector<double>& sorted, double fraction) {
+		double rank = fraction * static_cast<double>(sorted.size() - 1);
+		size_t below = static_cast<size_t>(rank);
+		size_t above = std::min(below + 1, sorted.size() - 1);
+		double weight = rank - static_cast<double>(below);
+
+		return sorted[below] * (1.0 - weight) + sorted[above] * weight;
+	}
+
+	std::string escapeJson(const std::string& text) {
+		std::string escaped;
+
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+				escaped += c;
+			}
+			else if (c == '\n') {
+				escaped += "\\n";
+			}
+			else if (c == '\t') {
+				escaped += "\\t";
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				// JSON allows no raw control characters in strings
+				char code[8];
+				std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+				escaped += code;
+			}
+			else {
+				escaped += c;
+			}
+		}
+
+		return escaped;
+	}
+}
+
+Harness::Harness(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		bool bHasValue = i + 1 < argc;
+
+		if (std::strcmp(argv[i], "--filter") == 0 && bHasValue) {
+			filter = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && bHasValue) {
+			jsonPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--samples") == 0 && bHasValue) {
+			sampleCount = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && bHasValue) {
+			warmupCount = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--list") == 0) {
+			bListOnly = true;
+		}
+		else {
+			std::printf("Unknown or incomplete option %s, see bench/Harness.hpp\n", argv[i]);
+		}
+	}
+}
+
+bool Harness::isSelected(const std::string& name) const {
+	return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+void Harness::check(const std::string& name, bool bPassed, const std::string& details) {
+	if (bListOnly) {
+		return;
+	}
+
+	checks.push_back({ name, bPassed, details });
+
+	std::printf("  check %-40s %s %s\n", name.c_str(), bPassed ? "ok    " : "FAILED", details.c_str());
+}
+
+void Harness::section(const std::string& title) {
+	if (!bListOnly) {
+		std::printf("\n%s\n", title.c_str());
+	}
+}
+
+void Harness::record(const std::string& name, const std::string& baseline, size_t itemCount, size_t callsPerSample, std::vector<double>& samples) {
+	std::sort(samples.begin(), samples.end());
+
+	Result result;
+	result.name = name;
+	result.baseline = baseline;
+	result.itemCount = itemCount;
+	result.callsPerSample = callsPerSample;
+	result.sampleCount = samples.size();
+	result.minimum = samples.front();
+	result.median = percentile(samples, 0.5);
+	result.p90 = percentile(samples, 0.9);
+	result.p99 = percentile(samples, 0.99);
+	result.maximum = samples.back();
+	result.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+
+	std::printf("  %-40s median %10.3f ns   p90 %10.3f ns   p99 %10.3f ns", name.c_str(), result.median, result.p90, result.p99);
+
+	auto reference = std::find_if(results.begin(), results.end(), [&baseline](const Result& earlier) { return earlier.name == baseline; });
+
+	if (reference != results.end()) {
+		std::printf("   %6.2fx %s", reference->median / result.median, baseline.c_str());
+	}
+
+	std::printf("\n");
+
+	results.push_back(result);
+}
+
+int Harness::finish() {
+	int failures = static_cast<int>(std::count_if(checks.begin(), checks.end(), [](const Check& check) { return !check.bPassed; }));
+
+	if (!jsonPath.empty() && !bListOnly) {
+		std::ofstream file(jsonPath);
+
+		if (!file) {
+			std::printf("Can't write %s\n", jsonPath.c_str());
+			return 1;
+		}
+
+		file << "{\n  \"unit\": \"ns/item\",\n  \"benchmarks\": [";
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const auto& result = results[i];
+
+			file << (i > 0 ? "," : "") << "\n    { \"name\": \"" << escapeJson(result.name) << "\""
+				<< ", \"items\": " << result.itemCount
+				<< ", \"calls_per_sample\": " << result.callsPerSample
+				<< ", \"samples\": " << result.sampleCount
+				<< ", \"min\": " << result.minimum
+				<< ", \"median\": " << result.median
+				<< ", \"p90\": " << result.p90
+				<< ", \"p99\": " << result.p99
+				<< ", \"max\": " << result.maximum
+				<< ", \"mean\": " << result.mean;
+
+			if (!result.baseline.empty()) {
+				file << ", \"baseline\": \"" << escapeJson(result.baseline) << "\"";
+			}
+
+			file << " }";
+		}
+
+		file << "\n  ],\n  \"checks\": [";
+
+		for (size_t i = 0; i < checks.size(); i++) {
+			file << (i > 0 ? "," : "") << "\n    { \"name\": \"" << escapeJson(checks[i].name) << "\", \"passed\": " << (checks[i].bPassed ? "true" : "false")
+				<< ", \"details\": \"" << escapeJson(checks[i].details) << "\" }";
+		}
+
+		file << "\n  ]\n}\n";
+
+		std::printf("\nResults written to %s\n", jsonPath.c_str());
+	}
+
+	if (failures > 0) {
+		std::printf("\n%d check(s) failed\n", failures);
+	}
+
+	// Not the count, exit codes wrap at 256
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Times benchmarks and checks their results.
+//
+// run() calls the operation a few times to warm the caches, then picks how
+// many calls make up one sample so each sample lasts about a millisecond,
+// then takes the samples. Results are nanoseconds per item (matrix, vertex,
+// particle...), summarised by percentiles, printed as they finish and
+// written as JSON by finish() when --json is given.
+//
+// Command line:
+//   --filter <text>   only run benchmarks whose name contains text
+//   --samples <n>     samples per benchmark, 30 by default
+//   --warmup <n>      calls before timing, 3 by default
+//   --json <file>     write the results to file
+//   --list            print the names without running anything
+class Harness {
+public:
+	struct Result {
+		std::string name;
+		std::string baseline;
+		size_t itemCount = 0;
+		size_t callsPerSample = 0;
+		size_t sampleCount = 0;
+
+		// Nanoseconds per item
+		double minimum = 0.0;
+		double median = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+		double maximum = 0.0;
+		double mean = 0.0;
+	};
+
+	struct Check {
+		std::string name;
+		bool bPassed = false;
+		std::string details;
+	};
+
+	Harness(int argc, char** argv);
+
+	bool isSelected(const std::string& name) const;
+
+	// Times operation(), which processes itemCount items per call. With a
+	// baseline, the speedup over that earlier result is printed too.
+	template <typename Operation>
+	void run(const std::string& name, size_t itemCount, Operation&& operation, const std::string& baseline = "");
+
+	// Records a correctness check, failed ones make finish() non-zero
+	void check(const std::string& name, bool bPassed, const std::string& details = "");
+
+	// Prints a heading for the benchmarks that follow
+	void section(const std::string& title);
+
+	// Writes the JSON file and returns the exit code, 1 if a check failed or
+	// the file couldn't be written
+	int finish();
+
+	const std::vector<Result>& getResults() const {
+		return results;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Long enough to keep the clock's resolution out of the results, short
+	// enough for slow benchmarks to stay quick
+	static constexpr double TargetSampleNanoseconds = 1000000.0;
+
+	void record(const std::string& name, const std::string& baseline, size_t itemCount, size_t callsPerSample, std::vector<double>& samples);
+
+	std::string filter;
+	std::string jsonPath;
+	int32_t sampleCount = 30;
+	int32_t warmupCount = 3;
+	bool bListOnly = false;
+
+	std::vector<Result> results;
+	std::vector<Check> checks;
+};
+
+template <typename Operation>
+void Harness::run(const std::string& name, size_t itemCount, Operation&& operation, const std::string& baseline) {
+	if (!isSelected(name)) {
+		return;
+	}
+
+	if (bListOnly) {
+		std::printf("%s\n", name.c_str());
+		return;
+	}
+
+	// The last warmup call sizes the samples
+	double callNanoseconds = 0.0;
+
+	for (int32_t i = 0; i < std::max(warmupCount, 1); i++) {
+		auto start = Clock::now();
+		operation();
+		callNanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	size_t callsPerSample = static_cast<size_t>(std::max(1.0, TargetSampleNanoseconds / std::max(callNanoseconds, 1.0)));
+
+	std::vector<double> samples(sampleCount);
+
+	for (auto& sample : samples) {
+		auto start = Clock::now();
+
+		for (size_t call = 0; call < callsPerSample; call++) {
+			operation();
+		}
+
+		sample = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (static_cast<double>(callsPerSample) * std::max<size_t>(itemCount, 1));
+	}
+
+	record(name, baseline, itemCount, callsPerSample, samples);
+}
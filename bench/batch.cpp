@@ -0,0 +1,208 @@
+// vmlib batch kernels against glm one element at a time, on a cache sized
+// batch and on one large enough to be split across threads
+
+#include "benchmarks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../vmlib/batch.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+namespace {
+	volatile float sink = 0.0f;
+
+	glm::mat4 toGlm(const Mat44f& matrix) {
+		return glm::transpose(glm::make_mat4(matrix.v));
+	}
+
+	// SoA storage for the views of batch.hpp
+	struct Soa {
+		std::vector<float> x, y, z, w;
+
+		explicit Soa(size_t count) : x(count), y(count), z(count), w(count) {}
+
+		Vec3fArrays vec3() { return { x.data(), y.data(), z.data() }; }
+		ConstVec3fArrays constVec3() const { return { x.data(), y.data(), z.data() }; }
+		Vec4fArrays vec4() { return { x.data(), y.data(), z.data(), w.data() }; }
+		ConstVec4fArrays constVec4() const { return { x.data(), y.data(), z.data(), w.data() }; }
+	};
+
+	void benchmarkCount(Harness& harness, size_t count, const ParallelFor& parallel) {
+		std::mt19937 generator(static_cast<uint32_t>(count));
+		std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+		Soa points(count);
+		Soa extents(count);
+		std::vector<glm::vec4> glmPoints(count);
+		std::vector<glm::vec3> glmExtents(count);
+
+		for (size_t i = 0; i < count; i++) {
+			points.x[i] = position(generator);
+			points.y[i] = position(generator);
+			points.z[i] = position(generator);
+			points.w[i] = size(generator);
+			extents.x[i] = points.x[i] + size(generator);
+			extents.y[i] = points.y[i] + size(generator);
+			extents.z[i] = points.z[i] + size(generator);
+
+			glmPoints[i] = glm::vec4(points.x[i], points.y[i], points.z[i], points.w[i]);
+			glmExtents[i] = glm::vec3(extents.x[i], extents.y[i], extents.z[i]);
+		}
+
+		Mat44f model = make_translation({ 3.0f, -1.0f, 8.0f }) * make_rotation_y(40.0f) * make_scaling(1.5f, 2.0f, 0.5f);
+		Mat44f viewProjection = make_perspective_projection(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * make_translation({ 0.0f, 0.0f, -20.0f });
+		glm::mat4 glmModel = toGlm(model);
+		glm::mat4 glmViewProjection = toGlm(viewProjection);
+
+		Soa results(count);
+		Soa resultsMax(count);
+		std::vector<glm::vec4> glmResults(count);
+		std::vector<glm::vec3> glmResultsMax(count);
+		std::vector<uint8_t> visible(count);
+		std::vector<uint8_t> glmVisible(count);
+
+		const ParallelFor* none = nullptr;
+
+		// batch/<kernel>/<count>/<implementation>
+		auto name = [count](const char* kernel, const char* implementation) {
+			return std::string("batch/") + kernel + "/" + std::to_string(count) + "/" + implementation;
+		};
+
+		// glm one element at a time, the kernel on this thread, the kernel
+		// on every thread
+		auto runAll = [&](const char* kernel, auto reference, auto batch) {
+			harness.run(name(kernel, "glm"), count, reference);
+			harness.run(name(kernel, "batch"), count, batch(none), name(kernel, "glm"));
+			harness.run(name(kernel, "threaded"), count, batch(&parallel), name(kernel, "glm"));
+		};
+
+		auto pointsReference = [&] {
+			for (size_t i = 0; i < count; i++) {
+				glmResults[i] = glmModel * glm::vec4(glm::vec3(glmPoints[i]), 1.0f);
+			}
+		};
+		auto pointsBatch = [&](const ParallelFor* threads) {
+			return [&, threads] { transform_points(model, points.constVec3(), results.vec3(), count, threads); };
+		};
+		runAll("points", pointsReference, pointsBatch);
+
+		float pointError = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			pointError = std::max({ pointError, std::abs(results.x[i] - glmResults[i].x), std::abs(results.y[i] - glmResults[i].y), std::abs(results.z[i] - glmResults[i].z) });
+		}
+
+		auto vec4Reference = [&] {
+			for (size_t i = 0; i < count; i++) {
+				glmResults[i] = glmViewProjection * glmPoints[i];
+			}
+		};
+		auto vec4Batch = [&](const ParallelFor* threads) {
+			return [&, threads] { transform_vec4s(viewProjection, points.constVec4(), results.vec4(), count, threads); };
+		};
+		runAll("vec4s", vec4Reference, vec4Batch);
+
+		float vec4Error = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			vec4Error = std::max({ vec4Error, std::abs(results.x[i] - glmResults[i].x), std::abs(results.y[i] - glmResults[i].y), std::abs(results.z[i] - glmResults[i].z), std::abs(results.w[i] - glmResults[i].w) });
+		}
+
+		// Eight corners per box, how a caller without batch.hpp would do it
+		auto aabbReference = [&] {
+			for (size_t i = 0; i < count; i++) {
+				glm::vec3 low(glmPoints[i]);
+				glm::vec3 high = glmExtents[i];
+				glm::vec3 resultMin(INFINITY);
+				glm::vec3 resultMax(-INFINITY);
+
+				for (int32_t corner = 0; corner < 8; corner++) {
+					glm::vec3 point((corner & 1) ? high.x : low.x, (corner & 2) ? high.y : low.y, (corner & 4) ? high.z : low.z);
+					glm::vec3 transformed(glmModel * glm::vec4(point, 1.0f));
+					resultMin = glm::min(resultMin, transformed);
+					resultMax = glm::max(resultMax, transformed);
+				}
+
+				glmResults[i] = glm::vec4(resultMin, 0.0f);
+				glmResultsMax[i] = resultMax;
+			}
+		};
+		auto aabbBatch = [&](const ParallelFor* threads) {
+			return [&, threads] { transform_aabbs(model, points.constVec3(), extents.constVec3(), results.vec3(), resultsMax.vec3(), count, threads); };
+		};
+		runAll("aabbs", aabbReference, aabbBatch);
+
+		float aabbError = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			aabbError = std::max({ aabbError, std::abs(results.x[i] - glmResults[i].x), std::abs(results.y[i] - glmResults[i].y), std::abs(results.z[i] - glmResults[i].z),
+				std::abs(resultsMax.x[i] - glmResultsMax[i].x), std::abs(resultsMax.y[i] - glmResultsMax[i].y), std::abs(resultsMax.z[i] - glmResultsMax[i].z) });
+		}
+
+		FrustumPlanes frustum = make_frustum_planes(viewProjection);
+		glm::vec4 planes[6];
+		for (size_t p = 0; p < 6; p++) {
+			planes[p] = glm::vec4(frustum.planes[p].x, frustum.planes[p].y, frustum.planes[p].z, frustum.planes[p].w);
+		}
+
+		auto cullReference = [&] {
+			for (size_t i = 0; i < count; i++) {
+				bool inside = true;
+				for (const auto& plane : planes) {
+					inside = inside && glm::dot(glm::vec3(plane), glm::vec3(glmPoints[i])) + plane.w + glmPoints[i].w >= 0.0f;
+				}
+				glmVisible[i] = inside ? 1 : 0;
+			}
+		};
+		size_t visibleCount = 0;
+		auto cullBatch = [&](const ParallelFor* threads) {
+			return [&, threads] { visibleCount = cull_spheres(frustum, points.constVec4(), visible.data(), count, threads); };
+		};
+		runAll("spheres", cullReference, cullBatch);
+
+		// Rounding may only flip spheres that touch a plane
+		size_t cullMismatches = 0;
+		size_t flaggedCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			flaggedCount += visible[i];
+
+			if (visible[i] != glmVisible[i]) {
+				float closest = INFINITY;
+				for (const auto& plane : planes) {
+					closest = std::min(closest, glm::dot(glm::vec3(plane), glm::vec3(glmPoints[i])) + plane.w + glmPoints[i].w);
+				}
+				cullMismatches += std::abs(closest) > 1e-4f ? 1 : 0;
+			}
+		}
+
+		sink = results.x[count / 2] + resultsMax.x[count / 2] + glmResults[count / 2].x + glmResultsMax[count / 2].x;
+
+		// Coordinates up to a few hundred, so 1e-3 is a few ulps
+		std::string suffix = " " + std::to_string(count);
+		harness.check("batch/points == glm" + suffix, pointError < 1e-3f, "largest difference " + std::to_string(pointError));
+		harness.check("batch/vec4s == glm" + suffix, vec4Error < 1e-3f, "largest difference " + std::to_string(vec4Error));
+		harness.check("batch/aabbs == glm corners" + suffix, aabbError < 1e-3f, "largest difference " + std::to_string(aabbError));
+		harness.check("batch/spheres == glm" + suffix, cullMismatches == 0 && visibleCount == flaggedCount,
+			std::to_string(visibleCount) + " visible, " + std::to_string(cullMismatches) + " wrong");
+	}
+}
+
+void benchmarkBatch(Harness& harness) {
+	ParallelFor parallel = make_thread_parallel_for();
+
+#if defined(VMLIB_SIMD_AVX)
+	harness.section("Batch kernels (AVX), ns per element");
+#else
+	harness.section("Batch kernels (Float4 pairs), ns per element");
+#endif
+
+	// Fits the L1 cache and stays under the threading threshold
+	benchmarkCount(harness, 1000, parallel);
+	benchmarkCount(harness, size_t(1) << 20, parallel);
+}
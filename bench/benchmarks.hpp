@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Harness.hpp"
+
+// One function per area. Names are area/operation/variant, so --filter can
+// pick an area or an operation.
+
+void benchmarkMat44(Harness& harness);
+
+void benchmarkBatch(Harness& harness);
+
+void benchmarkModels(Harness& harness);
+
+void benchmarkGeometry(Harness& harness);
+
+void benchmarkTerrain(Harness& harness);
+
+void benchmarkParticles(Harness& harness);
+
+// Needs a window system, skipped when there is none. Builds configured with
+// --no-gl-bench leave it out.
+void benchmarkUniforms(Harness& harness);
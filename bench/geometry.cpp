@@ -0,0 +1,30 @@
+// GeometryGenerator builders at the sizes the scene uses and larger
+
+#include "benchmarks.hpp"
+
+#include <string>
+
+#include "GeometryGenerator.hpp"
+
+void benchmarkGeometry(Harness& harness) {
+	harness.section("GeometryGenerator, ns per vertex");
+
+	GeometryGenerator generator;
+
+	// Runs build() and reports per vertex of what it returns
+	auto runBuilder = [&](const std::string& name, auto build) {
+		size_t vertexCount = build().Vertices.size();
+
+		harness.run("geometry/" + name, vertexCount, [&]() {
+			auto meshData = build();
+			return meshData.Vertices.size();
+		});
+	};
+
+	runBuilder("box/3", [&]() { return generator.CreateBox(1.0f, 1.0f, 1.0f, 3); });
+	runBuilder("sphere/64x64", [&]() { return generator.CreateSphere(1.0f, 64, 64); });
+	runBuilder("geosphere/5", [&]() { return generator.CreateGeosphere(1.0f, 5); });
+	runBuilder("cylinder/64x16", [&]() { return generator.CreateCylinder(1.0f, 0.5f, 2.0f, 64, 16); });
+	runBuilder("grid/50x50", [&]() { return generator.CreateGrid(50.0f, 50.0f, 50, 50, 10.0f); });
+	runBuilder("grid/512x512", [&]() { return generator.CreateGrid(50.0f, 50.0f, 512, 512, 10.0f); });
+}
@@ -0,0 +1,21 @@
+// Micro benchmarks of the CPU side code. Run from the repository root, e.g.
+//   bin/bench-release-x64-gcc.exe --filter mat44 --json bench.json
+// See Harness.hpp for the options. Exits with the number of failed checks.
+
+#include "benchmarks.hpp"
+
+int main(int argc, char** argv) {
+	Harness harness(argc, argv);
+
+	benchmarkMat44(harness);
+	benchmarkBatch(harness);
+	benchmarkModels(harness);
+	benchmarkGeometry(harness);
+	benchmarkTerrain(harness);
+	benchmarkParticles(harness);
+#if !defined(BENCH_NO_GL)
+	benchmarkUniforms(harness);
+#endif
+
+	return harness.finish();
+}
@@ -0,0 +1,130 @@
+// Mat44f operators through the scalar path, the vector path and glm, on
+// the same random matrices
+
+#include "benchmarks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "../vmlib/mat44.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+	// Small enough to stay in the L1 and L2 caches, so the arithmetic is
+	// what gets measured
+	constexpr size_t MatrixCount = 256;
+
+	// Keeps results alive without a store per iteration in the timed loop
+	volatile float sink = 0.0f;
+
+	// Runs operation(i) over every matrix, one call of the harness
+	template <typename Operation>
+	auto overMatrices(Operation operation) {
+		return [operation]() {
+			for (size_t i = 0; i < MatrixCount; i++) {
+				operation(i);
+			}
+		};
+	}
+
+	glm::mat4 toGlm(const Mat44f& matrix) {
+		// glm is column-major
+		return glm::transpose(glm::mat4(
+			matrix.v[0], matrix.v[1], matrix.v[2], matrix.v[3],
+			matrix.v[4], matrix.v[5], matrix.v[6], matrix.v[7],
+			matrix.v[8], matrix.v[9], matrix.v[10], matrix.v[11],
+			matrix.v[12], matrix.v[13], matrix.v[14], matrix.v[15]));
+	}
+}
+
+void benchmarkMat44(Harness& harness) {
+	harness.section("Mat44f, ns per matrix");
+
+	std::mt19937 generator(20241224);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	std::vector<Mat44f> lefts(MatrixCount);
+	std::vector<Mat44f> rights(MatrixCount);
+	std::vector<Vec4f> vectors(MatrixCount);
+	std::vector<Mat44f> results(MatrixCount);
+	std::vector<Vec4f> vectorResults(MatrixCount);
+
+	std::vector<glm::mat4> glmLefts(MatrixCount);
+	std::vector<glm::mat4> glmRights(MatrixCount);
+	std::vector<glm::vec4> glmVectors(MatrixCount);
+	std::vector<glm::mat4> glmResults(MatrixCount);
+	std::vector<glm::vec4> glmVectorResults(MatrixCount);
+
+	for (size_t i = 0; i < MatrixCount; i++) {
+		for (auto& value : lefts[i].v) {
+			value = distribution(generator);
+		}
+		for (auto& value : rights[i].v) {
+			value = distribution(generator);
+		}
+
+		// Diagonally dominant, so every matrix is comfortably invertible
+		for (size_t j = 0; j < 4; j++) {
+			lefts[i](j, j) += 4.0f;
+		}
+
+		vectors[i] = { distribution(generator), distribution(generator), distribution(generator), distribution(generator) };
+
+		glmLefts[i] = toGlm(lefts[i]);
+		glmRights[i] = toGlm(rights[i]);
+		glmVectors[i] = glm::vec4(vectors[i].x, vectors[i].y, vectors[i].z, vectors[i].w);
+	}
+
+	harness.run("mat44/mul/scalar", MatrixCount, overMatrices([&](size_t i) { results[i] = multiply_scalar(lefts[i], rights[i]); }));
+	harness.run("mat44/mul/simd", MatrixCount, overMatrices([&](size_t i) { results[i] = multiply_simd(lefts[i], rights[i]); }), "mat44/mul/scalar");
+	harness.run("mat44/mul/glm", MatrixCount, overMatrices([&](size_t i) { glmResults[i] = glmLefts[i] * glmRights[i]; }), "mat44/mul/scalar");
+
+	harness.run("mat44/mul_vec/scalar", MatrixCount, overMatrices([&](size_t i) { vectorResults[i] = multiply_scalar(lefts[i], vectors[i]); }));
+	harness.run("mat44/mul_vec/simd", MatrixCount, overMatrices([&](size_t i) { vectorResults[i] = multiply_simd(lefts[i], vectors[i]); }), "mat44/mul_vec/scalar");
+	harness.run("mat44/mul_vec/glm", MatrixCount, overMatrices([&](size_t i) { glmVectorResults[i] = glmLefts[i] * glmVectors[i]; }), "mat44/mul_vec/scalar");
+
+	harness.run("mat44/transpose/scalar", MatrixCount, overMatrices([&](size_t i) { results[i] = transpose_scalar(lefts[i]); }));
+	harness.run("mat44/transpose/simd", MatrixCount, overMatrices([&](size_t i) { results[i] = transpose_simd(lefts[i]); }), "mat44/transpose/scalar");
+	harness.run("mat44/transpose/glm", MatrixCount, overMatrices([&](size_t i) { glmResults[i] = glm::transpose(glmLefts[i]); }), "mat44/transpose/scalar");
+
+	harness.run("mat44/inverse/scalar", MatrixCount, overMatrices([&](size_t i) { results[i] = invert_scalar(lefts[i]); }));
+	harness.run("mat44/inverse/simd", MatrixCount, overMatrices([&](size_t i) { results[i] = invert_simd(lefts[i]); }), "mat44/inverse/scalar");
+	harness.run("mat44/inverse/glm", MatrixCount, overMatrices([&](size_t i) { glmResults[i] = glm::inverse(glmLefts[i]); }), "mat44/inverse/scalar");
+
+	// Builders have no scalar twin, glm is the reference
+	harness.run("mat44/rotation_y/glm", MatrixCount, overMatrices([&](size_t i) { glmResults[i] = glm::rotate(glm::mat4(1.0f), vectors[i].x * 3.14159265f, glm::vec3(0.0f, 1.0f, 0.0f)); }));
+	harness.run("mat44/rotation_y/vmlib", MatrixCount, overMatrices([&](size_t i) { results[i] = make_rotation_y(vectors[i].x * 180.0f); }), "mat44/rotation_y/glm");
+
+	harness.run("mat44/perspective/glm", MatrixCount, overMatrices([&](size_t i) { glmResults[i] = glm::perspective(1.0f + vectors[i].x * 0.1f, 1.6f, 0.1f, 100.0f); }));
+	harness.run("mat44/perspective/vmlib", MatrixCount, overMatrices([&](size_t i) { results[i] = make_perspective_projection(1.0f + vectors[i].x * 0.1f, 1.6f, 0.1f, 100.0f); }), "mat44/perspective/glm");
+
+	// Largest difference of the vector path from the scalar one
+	float multiplyError = 0.0f;
+	float inverseError = 0.0f;
+	float total = 0.0f;
+
+	for (size_t i = 0; i < MatrixCount; i++) {
+		Mat44f scalarProduct = multiply_scalar(lefts[i], rights[i]);
+		Mat44f vectorProduct = multiply_simd(lefts[i], rights[i]);
+		Mat44f scalarInverse = invert_scalar(lefts[i]);
+		Mat44f vectorInverse = invert_simd(lefts[i]);
+
+		for (size_t j = 0; j < 16; j++) {
+			multiplyError = std::max(multiplyError, std::abs(scalarProduct.v[j] - vectorProduct.v[j]));
+			inverseError = std::max(inverseError, std::abs(scalarInverse.v[j] - vectorInverse.v[j]));
+		}
+
+		total += results[i].v[0] + vectorResults[i].x + glmResults[i][0][0] + glmVectorResults[i].x;
+	}
+
+	sink = total;
+
+	// The matrices are diagonally dominant, anything beyond rounding is a bug
+	harness.check("mat44/mul simd == scalar", multiplyError < 1e-4f, "largest difference " + std::to_string(multiplyError));
+	harness.check("mat44/inverse simd == scalar", inverseError < 1e-4f, "largest difference " + std::to_string(inverseError));
+}
@@ -0,0 +1,71 @@
+// OBJ loading, split into tinyobjloader's parse and the whole of
+// loadObjModel() (parse, vertex dedup, materials), and the tangent space of
+// the loaded meshes
+
+#include "benchmarks.hpp"
+
+#include <string>
+
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include "ModelLoader.hpp"
+
+namespace {
+	// Some of the larger models of the scene
+	const char* const ModelNames[] = { "House", "Present", "DecoratedChristmasTree", "Projectile" };
+
+	const std::string ModelDirectory = "./assets/models/";
+
+	// No GL here, every texture is layer 0 of array 0
+	TextureLayer loadNoTexture(const std::string&, const std::string&) {
+		return TextureLayer();
+	}
+}
+
+void benchmarkModels(Harness& harness) {
+	if (!harness.isSelected("models/") && !harness.isSelected("mesh/")) {
+		return;
+	}
+
+	harness.section("Models, ns per face corner (tangents: per triangle)");
+
+	for (const char* modelName : ModelNames) {
+		std::string fileName = ModelDirectory + modelName + ".obj";
+
+		auto model = loadObjModel(fileName, "", ModelDirectory, "./assets/textures/", loadNoTexture, TextureLayer());
+
+		harness.check(std::string("models/") + modelName + " loads", model != nullptr, fileName);
+
+		if (!model) {
+			continue;
+		}
+
+		size_t cornerCount = 0;
+		size_t vertexCount = 0;
+
+		for (const auto& mesh : model->getMeshes()) {
+			cornerCount += mesh->getIndexCount();
+			vertexCount += mesh->getVertexCount();
+		}
+
+		harness.run(std::string("models/parse/") + modelName, cornerCount, [&]() {
+			tinyobj::ObjReaderConfig readConfig;
+			readConfig.mtl_search_path = ModelDirectory;
+
+			tinyobj::ObjReader reader;
+			reader.ParseFromFile(fileName, readConfig);
+		});
+
+		harness.run(std::string("models/load/") + modelName, cornerCount, [&]() {
+			loadObjModel(fileName, "", ModelDirectory, "./assets/textures/", loadNoTexture, TextureLayer());
+		});
+
+		harness.run(std::string("mesh/tangents/") + modelName, cornerCount / 3, [&]() {
+			model->computeTangentSpace();
+		});
+
+		// Dedup is the point of the unordered_map in loadObjModel()
+		harness.check(std::string("models/") + modelName + " dedup", vertexCount < cornerCount,
+			std::to_string(vertexCount) + " vertices for " + std::to_string(cornerCount) + " corners");
+	}
+}
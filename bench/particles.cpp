@@ -0,0 +1,69 @@
+// ParticlePool::update() on a million flakes falling towards a terrain,
+// through the vector and the scalar path
+
+#include "benchmarks.hpp"
+
+#include <limits>
+#include <vector>
+
+#include "Heightfield.hpp"
+#include "ParticlePool.hpp"
+#include "Random.hpp"
+#include "TerrainNoise.hpp"
+
+void benchmarkParticles(Harness& harness) {
+	if (!harness.isSelected("particles/")) {
+		return;
+	}
+
+	harness.section("Particles, ns per particle");
+
+	constexpr size_t ParticleCount = 1000000;
+
+	// The scene's terrain, see loadModels()
+	constexpr int32_t TerrainResolution = 50;
+	constexpr float TerrainSize = 50.0f;
+
+	Heightfield ground;
+	ground.resize(TerrainResolution, TerrainResolution, glm::vec2(-TerrainSize * 0.5f), glm::vec2(TerrainSize / (TerrainResolution - 1)));
+
+	TerrainNoise noise;
+	noise.offset = 0.5f - 2.25f;
+	noise.amplitude = 0.5f;
+
+	for (int32_t row = 0; row < TerrainResolution; row++) {
+		for (int32_t column = 0; column < TerrainResolution; column++) {
+			glm::vec2 position = glm::vec2(-TerrainSize * 0.5f) + glm::vec2(column, row) * (TerrainSize / (TerrainResolution - 1));
+			ground.setHeight(column, row, noise.getHeight(position.x, position.y));
+		}
+	}
+
+	RandomStream random(20241224, 1);
+
+	std::vector<float> gravityEffects(ParticleCount);
+	random.fillUniform(gravityEffects.data(), ParticleCount, 0.1f, 0.9f);
+
+	for (auto bVectorized : { false, true }) {
+		ParticlePool pool(ParticleCount);
+		pool.ground = &ground;
+		pool.bVectorized = bVectorized;
+		ground.bVectorized = bVectorized;
+
+		// Nothing dies, every call updates the whole pool. Starting this high,
+		// no flake lands within the benchmark either.
+		pool.lifeTime = std::numeric_limits<float>::max();
+
+		for (size_t i = 0; i < ParticleCount; i++) {
+			glm::vec3 position(random.nextFloat(-25.0f, 25.0f), 10.0f, random.nextFloat(-25.0f, 25.0f));
+			pool.spawn(position, glm::vec3(0.0f), gravityEffects[i]);
+		}
+
+		harness.run(bVectorized ? "particles/update/vector" : "particles/update/scalar", ParticleCount, [&]() {
+			pool.update(1.0f / 60.0f);
+		}, bVectorized ? "particles/update/scalar" : "");
+
+		harness.check(bVectorized ? "particles/none lost vector" : "particles/none lost scalar", pool.size() == ParticleCount);
+	}
+
+	ground.bVectorized = true;
+}
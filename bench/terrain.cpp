@@ -0,0 +1,305 @@
+// TerrainNoise heights on the scene's 50x50 terrain grid and on finer ones,
+// per basis through the scalar path, the AVX2 path and split across threads.
+// The paths must agree bit for bit, and a fixed grid must hash to the value
+// recorded when the generator was written, on any machine.
+//
+// Then the TerrainQuadtree of the scene: node selection and tile streaming
+// per frame, and checks that the selection covers the world once, that
+// neighbouring nodes meet without cracks and that memory stays bounded.
+
+#include "benchmarks.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Terrain.hpp"
+#include "TerrainNoise.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+	// FNV-1a over the bits of the heights
+	uint32_t hashHeights(const std::vector<float>& heights) {
+		uint32_t hash = 2166136261u;
+
+		for (float height : heights) {
+			uint32_t bits;
+			std::memcpy(&bits, &height, sizeof(bits));
+
+			for (int32_t shift = 0; shift < 32; shift += 8) {
+				hash ^= (bits >> shift) & 0xFFu;
+				hash *= 16777619u;
+			}
+		}
+
+		return hash;
+	}
+
+	bool isBitIdentical(const std::vector<float>& a, const std::vector<float>& b) {
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	}
+
+	std::string toHex(uint32_t value) {
+		char digits[16];
+		std::snprintf(digits, sizeof(digits), "0x%08X", value);
+		return digits;
+	}
+
+	// Updates until every wanted tile is there
+	void settle(TerrainQuadtree& quadtree, ThreadPool& pool, const glm::vec3& eye) {
+		for (int32_t i = 0; i < 1000; i++) {
+			quadtree.update(pool, eye);
+
+			if (quadtree.getPendingTileCount() == 0) {
+				quadtree.update(pool, eye);
+				return;
+			}
+
+			quadtree.waitForTiles();
+		}
+	}
+
+	// Height of a drawn node at a world xz on its grid
+	float getNodeHeight(const TerrainQuadtree& quadtree, const TerrainDrawNode& node, const glm::vec2& position) {
+		float spacing = node.size / static_cast<float>(quadtree.gridResolution);
+		glm::ivec2 sample = glm::ivec2(glm::round((position - node.origin) / spacing)) + 1;
+
+		return quadtree.getHeights(node.layer)[static_cast<size_t>(sample.y) * quadtree.getTileSamples() + sample.x];
+	}
+
+	// Distance from the eye to the nearest and farthest point of a
+	// segment of the ground, over the terrain's height range
+	glm::vec2 getDistanceRange(const glm::vec3& eye, const glm::vec2& from, const glm::vec2& to, const glm::vec2& heightRange) {
+		glm::vec2 minimum = glm::min(from, to);
+		glm::vec2 maximum = glm::max(from, to);
+
+		glm::vec3 nearest = glm::clamp(eye, glm::vec3(minimum.x, heightRange.x, minimum.y), glm::vec3(maximum.x, heightRange.y, maximum.y));
+		float farthest = 0.0f;
+
+		for (const auto& end : { from, to }) {
+			for (float height : { heightRange.x, heightRange.y }) {
+				farthest = std::max(farthest, glm::distance(eye, glm::vec3(end.x, height, end.y)));
+			}
+		}
+
+		return glm::vec2(glm::distance(eye, nearest), farthest);
+	}
+
+	void benchmarkQuadtree(Harness& harness, ThreadPool& pool) {
+		harness.section("Terrain quadtree, ns per node or tile");
+
+		// The scene's, see loadModels()
+		TerrainQuadtree quadtree;
+		quadtree.noise.offset = 0.5f;
+		quadtree.noise.amplitude = 0.5f;
+		quadtree.baseHeight = -2.25f;
+		quadtree.create(pool);
+
+		const glm::vec3 eye = glm::vec3(10.0f, 3.0f, 12.0f);
+		settle(quadtree, pool, eye);
+
+		const auto& nodes = quadtree.getDrawNodes();
+
+		harness.run("terrain/quadtree/select", nodes.size(), [&]() {
+			quadtree.update(pool, eye);
+		});
+
+		// Every leaf cell of the world in exactly one node
+		int32_t cellsPerSide = static_cast<int32_t>(quadtree.worldSize / quadtree.leafSize);
+		std::vector<int32_t> cellNodes(static_cast<size_t>(cellsPerSide) * cellsPerSide, -1);
+		bool bCoveredOnce = true;
+
+		glm::vec2 worldOrigin = quadtree.center - quadtree.worldSize * 0.5f;
+
+		for (size_t i = 0; i < nodes.size(); i++) {
+			glm::ivec2 start = glm::ivec2((nodes[i].getAreaOrigin() - worldOrigin) / quadtree.leafSize);
+			int32_t span = static_cast<int32_t>(nodes[i].getAreaSize() / quadtree.leafSize);
+
+			for (int32_t z = start.y; z < start.y + span; z++) {
+				for (int32_t x = start.x; x < start.x + span; x++) {
+					auto& cell = cellNodes[static_cast<size_t>(z) * cellsPerSide + x];
+					bCoveredOnce = bCoveredOnce && cell < 0;
+					cell = static_cast<int32_t>(i);
+				}
+			}
+		}
+
+		bCoveredOnce = bCoveredOnce && std::find(cellNodes.begin(), cellNodes.end(), -1) == cellNodes.end();
+
+		harness.check("terrain/quadtree covers the world once", bCoveredOnce, std::to_string(nodes.size()) + " nodes");
+
+		// Where levels meet they differ by one, the finer side is fully
+		// morphed, the coarser one not at all, and both have the same heights
+		// on the coarser grid
+		bool bAdjacentLevels = true;
+		bool bMorphed = true;
+		bool bSameHeights = true;
+		int32_t boundaryCount = 0;
+
+		for (int32_t z = 0; z < cellsPerSide && bCoveredOnce; z++) {
+			for (int32_t x = 0; x < cellsPerSide; x++) {
+				for (int32_t direction = 0; direction < 2; direction++) {
+					int32_t neighbourX = x + (direction == 0 ? 1 : 0);
+					int32_t neighbourZ = z + (direction == 1 ? 1 : 0);
+
+					if (neighbourX >= cellsPerSide || neighbourZ >= cellsPerSide) {
+						continue;
+					}
+
+					const auto* fine = &nodes[cellNodes[static_cast<size_t>(z) * cellsPerSide + x]];
+					const auto* coarse = &nodes[cellNodes[static_cast<size_t>(neighbourZ) * cellsPerSide + neighbourX]];
+
+					if (fine->node.level == coarse->node.level) {
+						continue;
+					}
+
+					if (fine->node.level > coarse->node.level) {
+						std::swap(fine, coarse);
+					}
+
+					boundaryCount++;
+					bAdjacentLevels = bAdjacentLevels && coarse->node.level == fine->node.level + 1;
+
+					// The shared edge of the two leaf cells
+					glm::vec2 from = worldOrigin + glm::vec2(static_cast<float>(neighbourX), static_cast<float>(neighbourZ)) * quadtree.leafSize;
+					glm::vec2 to = from + (direction == 0 ? glm::vec2(0.0f, quadtree.leafSize) : glm::vec2(quadtree.leafSize, 0.0f));
+
+					glm::vec2 distances = getDistanceRange(eye, from, to, quadtree.getHeightRange());
+					bMorphed = bMorphed && distances.x >= fine->morphEnd && distances.y <= coarse->morphStart;
+
+					// The coarse samples on the edge, which may be wider apart
+					// than a leaf cell
+					float coarseSpacing = coarse->size / static_cast<float>(quadtree.gridResolution);
+
+					for (float offset = 0.0f; offset <= quadtree.leafSize; offset += 1.0f / 64.0f) {
+						glm::vec2 position = from + (to - from) / quadtree.leafSize * offset;
+						glm::vec2 coarseGrid = (position - coarse->origin) / coarseSpacing;
+
+						if (coarseGrid != glm::floor(coarseGrid)) {
+							continue;
+						}
+
+						bSameHeights = bSameHeights && getNodeHeight(quadtree, *fine, position) == getNodeHeight(quadtree, *coarse, position);
+					}
+				}
+			}
+		}
+
+		std::string boundaries = std::to_string(boundaryCount) + " leaf edges";
+
+		harness.check("terrain/quadtree neighbours one level apart", bAdjacentLevels, boundaries);
+		harness.check("terrain/quadtree morphed where levels meet", bMorphed, boundaries);
+		harness.check("terrain/quadtree same heights where levels meet", bSameHeights, boundaries);
+
+		// Flying across the world with a small cache, a full set of new tiles
+		// every frame
+		TerrainQuadtree streaming;
+		streaming.noise = quadtree.noise;
+		streaming.baseHeight = quadtree.baseHeight;
+		streaming.tileCapacity = 256;
+		streaming.create(pool);
+
+		float flightX = -streaming.worldSize * 0.5f;
+		size_t mostTiles = 0;
+
+		harness.run("terrain/quadtree/stream", static_cast<size_t>(streaming.tilesPerFrame), [&]() {
+			flightX += 37.0f;
+
+			if (flightX > streaming.worldSize * 0.5f) {
+				flightX -= streaming.worldSize;
+			}
+
+			// Waiting for the queued tiles, so a sample includes generating them
+			streaming.update(pool, glm::vec3(flightX, 3.0f, 0.0f));
+			streaming.waitForTiles();
+			streaming.releaseGenerated();
+			mostTiles = std::max(mostTiles, streaming.getResidentTileCount());
+		});
+
+		settle(streaming, pool, glm::vec3(flightX, 3.0f, 0.0f));
+
+		harness.check("terrain/quadtree tiles within capacity", mostTiles <= static_cast<size_t>(streaming.tileCapacity), std::to_string(mostTiles) + " at most");
+		harness.check("terrain/quadtree settles after streaming", streaming.getPendingTileCount() == 0, std::to_string(streaming.getDrawNodes().size()) + " nodes");
+	}
+}
+
+void benchmarkTerrain(Harness& harness) {
+	if (!harness.isSelected("terrain/")) {
+		return;
+	}
+
+	harness.section("Terrain noise, ns per height");
+
+	ThreadPool pool;
+
+	// The scene's terrain, see loadModels()
+	constexpr float TerrainSize = 50.0f;
+
+	// Heights of the 64x64 golden grid, seed 1, default settings
+	constexpr uint32_t GoldenValueHash = 0xF941BBEDu;
+	constexpr uint32_t GoldenSimplexHash = 0x99D39249u;
+
+	for (auto basis : { TerrainNoise::Basis::Value, TerrainNoise::Basis::Simplex }) {
+		std::string basisName = basis == TerrainNoise::Basis::Value ? "value" : "simplex";
+
+		TerrainNoise noise(1);
+		noise.basis = basis;
+
+		for (int32_t resolution : { 50, 256, 1024 }) {
+			std::string prefix = "terrain/" + basisName + "/" + std::to_string(resolution) + "x" + std::to_string(resolution);
+
+			glm::vec2 origin = glm::vec2(-TerrainSize * 0.5f);
+			glm::vec2 spacing = glm::vec2(TerrainSize / (resolution - 1));
+			size_t count = static_cast<size_t>(resolution) * resolution;
+
+			std::vector<float> scalarHeights(count);
+			std::vector<float> vectorHeights(count);
+			std::vector<float> threadedHeights(count);
+
+			noise.bVectorized = false;
+			harness.run(prefix + "/scalar", count, [&]() {
+				noise.generateRows(scalarHeights.data(), resolution, 0, resolution, origin, spacing);
+			});
+
+			noise.bVectorized = true;
+			harness.run(prefix + "/vector", count, [&]() {
+				noise.generateRows(vectorHeights.data(), resolution, 0, resolution, origin, spacing);
+			}, prefix + "/scalar");
+
+			harness.run(prefix + "/threaded", count, [&]() {
+				noise.generate(pool, threadedHeights.data(), resolution, resolution, origin, spacing);
+			}, prefix + "/scalar");
+
+			bool bInRange = true;
+
+			for (float height : scalarHeights) {
+				bInRange = bInRange && height >= -1.0f && height <= 1.0f;
+			}
+
+			// A second generator with the same seed, nothing carried over
+			std::vector<float> repeatedHeights(count);
+			TerrainNoise repeated(1);
+			repeated.basis = basis;
+			repeated.generateRows(repeatedHeights.data(), resolution, 0, resolution, origin, spacing);
+
+			harness.check(prefix + " in [-1, 1]", bInRange);
+			harness.check(prefix + " repeatable", isBitIdentical(repeatedHeights, scalarHeights));
+			harness.check(prefix + " vector == scalar", isBitIdentical(vectorHeights, scalarHeights));
+			harness.check(prefix + " threaded == scalar", isBitIdentical(threadedHeights, scalarHeights));
+		}
+
+		constexpr int32_t GoldenResolution = 64;
+		std::vector<float> goldenHeights(GoldenResolution * GoldenResolution);
+
+		noise.generateRows(goldenHeights.data(), GoldenResolution, 0, GoldenResolution, glm::vec2(-TerrainSize * 0.5f), glm::vec2(TerrainSize / (GoldenResolution - 1)));
+
+		uint32_t hash = hashHeights(goldenHeights);
+		uint32_t golden = basis == TerrainNoise::Basis::Value ? GoldenValueHash : GoldenSimplexHash;
+
+		harness.check("terrain/" + basisName + " golden grid", hash == golden, toHex(hash));
+	}
+
+	benchmarkQuadtree(harness, pool);
+}
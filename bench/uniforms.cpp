@@ -0,0 +1,108 @@
+// Shader::setUniform() against glUniform* with a location looked up once,
+// on the scene shader in a hidden window's context. What the driver does
+// with the values is deferred to the next draw, so this is the CPU cost of
+// the calls and the by-name lookups.
+
+#include "benchmarks.hpp"
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "Shader.hpp"
+
+namespace {
+	constexpr size_t CallCount = 64;
+}
+
+void benchmarkUniforms(Harness& harness) {
+	if (!harness.isSelected("uniforms/")) {
+		return;
+	}
+
+	harness.section("Uniforms, ns per call");
+
+	if (glfwInit() != GLFW_TRUE) {
+		std::printf("  No window system, uniforms skipped\n");
+		return;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	GLFWwindow* window = glfwCreateWindow(64, 64, "bench", nullptr, nullptr);
+
+	if (!window) {
+		std::printf("  No OpenGL 4.3 context, uniforms skipped\n");
+		glfwTerminate();
+		return;
+	}
+
+	glfwMakeContextCurrent(window);
+
+	if (gladLoadGLLoader((GLADloadproc)&glfwGetProcAddress)) {
+		std::printf("  %s\n", glGetString(GL_RENDERER));
+
+		Shader shader("scene");
+		bool bBuilt = shader.build("./assets/shaders/scene.vert", "./assets/shaders/scene.frag");
+
+		harness.check("uniforms/scene shader builds", bBuilt);
+
+		if (bBuilt) {
+			shader.use();
+
+			glm::mat4 matrix(1.0f);
+			glm::vec3 vector(1.0f, 2.0f, 3.0f);
+			int32_t matrixLocation = glGetUniformLocation(shader.get(), "worldMatrix");
+			int32_t vectorLocation = glGetUniformLocation(shader.get(), "eye");
+
+			// Each call changes the value, so no driver can skip it
+			harness.run("uniforms/mat4/location", CallCount, [&]() {
+				for (size_t i = 0; i < CallCount; i++) {
+					matrix[3][0] = static_cast<float>(i);
+					glUniformMatrix4fv(matrixLocation, 1, GL_FALSE, glm::value_ptr(matrix));
+				}
+			});
+			harness.run("uniforms/mat4/name", CallCount, [&]() {
+				for (size_t i = 0; i < CallCount; i++) {
+					matrix[3][0] = static_cast<float>(i);
+					shader.setUniform("worldMatrix", matrix);
+				}
+			}, "uniforms/mat4/location");
+
+			harness.run("uniforms/vec3/location", CallCount, [&]() {
+				for (size_t i = 0; i < CallCount; i++) {
+					vector.x = static_cast<float>(i);
+					glUniform3fv(vectorLocation, 1, glm::value_ptr(vector));
+				}
+			});
+			harness.run("uniforms/vec3/name", CallCount, [&]() {
+				for (size_t i = 0; i < CallCount; i++) {
+					vector.x = static_cast<float>(i);
+					shader.setUniform("eye", vector);
+				}
+			}, "uniforms/vec3/location");
+
+			// The material struct, set member by member as drawing does
+			harness.run("uniforms/material/name", CallCount, [&]() {
+				for (size_t i = 0; i < CallCount; i++) {
+					shader.setUniform("material.Ka", vector);
+					shader.setUniform("material.Kd", vector);
+					shader.setUniform("material.Ks", vector);
+					shader.setUniform("material.shininess", static_cast<float>(i));
+				}
+			});
+		}
+	}
+	else {
+		harness.check("uniforms/glad loads", false);
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+// View frustum as six planes (ax + by + cz + d >= 0 is inside), extracted from
+// a view-projection matrix (Gribb/Hartmann).
+class Frustum {
+public:
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection) {
+        glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        planes[0] = row3 + row0; // left
+        planes[1] = row3 - row0; // right
+        planes[2] = row3 + row1; // bottom
+        planes[3] = row3 - row1; // top
+        planes[4] = row3 + row2; // near
+        planes[5] = row3 - row2; // far
+
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    const glm::vec4& getPlane(int32_t index) const {
+        return planes[index];
+    }
+
+private:
+    glm::vec4 planes[6] = {};
+};
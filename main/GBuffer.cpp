@@ -0,0 +1,147 @@
+#include "GBuffer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include <glad.h>
+
+#include "Texture.hpp"
+
+namespace {
+    uint32_t createTarget(int32_t unit, int32_t width, int32_t height, GLenum internalFormat, GLenum format, GLenum type) {
+        uint32_t texture = 0;
+
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+
+        // Read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        return texture;
+    }
+}
+
+GBuffer::~GBuffer() {
+    release();
+    glDeleteBuffers(1, &materialBuffer);
+}
+
+void GBuffer::release() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &albedoTexture);
+    glDeleteTextures(1, &normalTexture);
+    glDeleteTextures(1, &depthTexture);
+
+    fbo = 0;
+    albedoTexture = 0;
+    normalTexture = 0;
+    depthTexture = 0;
+}
+
+void GBuffer::resize(int32_t inWidth, int32_t inHeight) {
+    if (fbo != 0 && inWidth == width && inHeight == height) {
+        return;
+    }
+
+    if (albedoUnit < 0) {
+        albedoUnit = Texture::allocateTextureUnit();
+        normalUnit = Texture::allocateTextureUnit();
+        depthUnit = Texture::allocateTextureUnit();
+    }
+
+    release();
+
+    width = inWidth;
+    height = inHeight;
+
+    albedoTexture = createTarget(albedoUnit, width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    normalTexture = createTarget(normalUnit, width, height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+    depthTexture = createTarget(depthUnit, width, height, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+    uint32_t drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "G-buffer is not complete." << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void GBuffer::clearMaterials() {
+    materials.clear();
+    materialIds.clear();
+}
+
+int32_t GBuffer::getMaterialId(const Material* material) {
+    auto result = materialIds.insert({ material, static_cast<int32_t>(materials.size()) });
+
+    if (!result.second) {
+        return result.first->second;
+    }
+
+    if (materials.size() >= MaxMaterials) {
+        std::cout << "Too many G-buffer materials, reusing the last one." << std::endl;
+        result.first->second = MaxMaterials - 1;
+        return result.first->second;
+    }
+
+    GBufferMaterial entry;
+
+    if (material) {
+        entry.ambient = glm::vec4(material->Ka, 0.0f);
+        entry.diffuse = glm::vec4(material->Kd, 0.0f);
+        entry.specular = glm::vec4(material->Ks, material->shininess);
+        entry.factors = glm::vec4(material->reflectionFactor, material->refractionFactor, material->eta, 0.0f);
+        entry.emission = glm::vec4(material->Ke, material->ior);
+    }
+    else {
+        entry.ambient = glm::vec4(0.0f);
+        entry.diffuse = glm::vec4(1.0f);
+        entry.specular = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        entry.factors = glm::vec4(0.0f);
+        entry.emission = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    materials.push_back(entry);
+
+    return result.first->second;
+}
+
+void GBuffer::uploadMaterials() {
+    if (materialBuffer == 0) {
+        glGenBuffers(1, &materialBuffer);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+
+    // Never empty, so the binding is always valid
+    size_t byteSize = sizeof(GBufferMaterial) * std::max<size_t>(materials.size(), 1);
+
+    glBufferData(GL_SHADER_STORAGE_BUFFER, byteSize, nullptr, GL_STREAM_DRAW);
+
+    if (!materials.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GBufferMaterial) * materials.size(), materials.data());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialBinding, materialBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
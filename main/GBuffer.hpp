@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Material.hpp"
+
+// Matches struct SurfaceMaterial in deferred.frag (std430)
+struct GBufferMaterial {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    // Shininess in w
+    glm::vec4 specular;
+    // Reflection factor, refraction factor, eta
+    glm::vec4 factors;
+    // Ke, ior in w
+    glm::vec4 emission;
+};
+
+// Render targets of the deferred path, 12 bytes per pixel:
+//   0: RGBA8 gamma encoded albedo, material id in alpha
+//   1: RG16 octahedral world space normal
+//   depth: DEPTH_COMPONENT32F, positions are rebuilt from it
+// Material ids index a per-frame table of the materials drawn into the
+// G-buffer, uploaded to a shader storage buffer for the lighting pass.
+class GBuffer {
+public:
+    static constexpr uint32_t MaterialBinding = 3;
+    // Ids are stored in 8 bits
+    static constexpr uint32_t MaxMaterials = 256;
+
+    GBuffer() {}
+
+    ~GBuffer();
+
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+
+    // Allocates the texture units once, then (re)creates the attachments
+    // whenever the size changes
+    void resize(int32_t inWidth, int32_t inHeight);
+
+    // Binds the framebuffer for the geometry pass
+    void bind();
+
+    void clearMaterials();
+
+    // Id of the material in this frame's table, adding it if needed
+    int32_t getMaterialId(const Material* material);
+
+    void uploadMaterials();
+
+    int32_t getAlbedoUnit() const {
+        return albedoUnit;
+    }
+
+    int32_t getNormalUnit() const {
+        return normalUnit;
+    }
+
+    int32_t getDepthUnit() const {
+        return depthUnit;
+    }
+
+    int32_t getWidth() const {
+        return width;
+    }
+
+    int32_t getHeight() const {
+        return height;
+    }
+
+private:
+    void release();
+
+    uint32_t fbo = 0;
+    uint32_t albedoTexture = 0;
+    uint32_t normalTexture = 0;
+    uint32_t depthTexture = 0;
+
+    int32_t albedoUnit = -1;
+    int32_t normalUnit = -1;
+    int32_t depthUnit = -1;
+
+    int32_t width = 0;
+    int32_t height = 0;
+
+    std::vector<GBufferMaterial> materials;
+    std::unordered_map<const Material*, int32_t> materialIds;
+    uint32_t materialBuffer = 0;
+};
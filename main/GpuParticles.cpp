@@ -0,0 +1,142 @@
+#include "GpuParticles.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include <glad.h>
+
+#include "Frustum.hpp"
+
+namespace {
+    // Matches struct Flake in particles.comp (std430)
+    struct GpuFlake {
+        // xyz position, w age in seconds
+        glm::vec4 positionAge;
+        // x rotation in degrees, y gravity effect
+        glm::vec4 state;
+    };
+
+    struct DrawElementsIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+}
+
+GpuParticles::~GpuParticles() {
+    release();
+}
+
+void GpuParticles::release() {
+    glDeleteBuffers(2, buffers);
+    glDeleteBuffers(1, &visibleBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+
+    buffers[0] = 0;
+    buffers[1] = 0;
+    visibleBuffer = 0;
+    commandBuffer = 0;
+}
+
+void GpuParticles::resize(uint32_t inCount) {
+    release();
+
+    count = inCount;
+    activeCount = inCount;
+
+    glGenBuffers(2, buffers);
+
+    for (auto buffer : buffers) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuFlake) * count, nullptr, GL_DYNAMIC_COPY);
+    }
+
+    glGenBuffers(1, &visibleBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t) * count, nullptr, GL_DYNAMIC_COPY);
+
+    // Only instanceCount changes from here on, written by the GPU
+    DrawElementsIndirectCommand command = { 6, 0, 0, 0, 0 };
+
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(command), &command, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    current = 0;
+    frame = 0;
+    bSpawnAll = true;
+}
+
+void GpuParticles::simulate(Shader& computeShader, float deltaTime, const glm::mat4& viewProjection, const glm::vec3& eye) {
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t simulatedCount = bSpawnAll ? count : activeCount;
+
+    computeShader.use();
+
+    computeShader.setUniform("count", static_cast<int32_t>(simulatedCount));
+    computeShader.setUniform("seed", static_cast<int32_t>(seed + frame++));
+    computeShader.setUniform("bSpawnAll", bSpawnAll);
+    computeShader.setUniform("deltaTime", deltaTime);
+    computeShader.setUniform("gravity", gravity);
+    computeShader.setUniform("lifeTime", lifeTime);
+    computeShader.setUniform("floorHeight", floorHeight);
+    computeShader.setUniform("spawnHeight", spawnHeight);
+    computeShader.setUniform("spawnExtent", spawnExtent);
+    computeShader.setUniform("eye", eye);
+
+    Frustum frustum(viewProjection);
+
+    for (int32_t i = 0; i < 6; i++) {
+        computeShader.setUniform("frustumPlanes[" + std::to_string(i) + "]", frustum.getPlane(i));
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SourceBinding, buffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DestinationBinding, buffers[1 - current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleBinding, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, commandBuffer);
+
+    // Zero instanceCount, the visible flakes are counted again
+    uint32_t zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glDispatchCompute((simulatedCount + GroupSize - 1) / GroupSize, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // Inactive flakes are never written, so both buffers need valid ones
+    // from the start
+    if (bSpawnAll) {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers[1 - current]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[current]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GpuFlake) * count);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    current = 1 - current;
+    bSpawnAll = false;
+}
+
+void GpuParticles::draw() {
+    if (count == 0) {
+        return;
+    }
+
+    // particle_gpu.vert reads the latest state through the source binding
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SourceBinding, buffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleBinding, visibleBuffer);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
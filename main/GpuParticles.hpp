@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+
+// Snowfall simulated and drawn entirely on the GPU. Flake state lives in two
+// shader storage buffers used ping-pong: particles.comp reads one, applies
+// the ParticlePool rules, respawns dead flakes in place and writes the
+// other. The same dispatch frustum culls, appending the visible flakes to an
+// index list and counting them in an indirect draw command, so after
+// resize() no particle data crosses from the CPU.
+class GpuParticles {
+public:
+    static constexpr uint32_t SourceBinding = 4;
+    static constexpr uint32_t DestinationBinding = 5;
+    static constexpr uint32_t VisibleBinding = 6;
+    static constexpr uint32_t CommandBinding = 7;
+    // Matches local_size_x in particles.comp
+    static constexpr uint32_t GroupSize = 256;
+
+    GpuParticles() {}
+
+    ~GpuParticles();
+
+    GpuParticles(const GpuParticles&) = delete;
+    GpuParticles& operator=(const GpuParticles&) = delete;
+
+    // (Re)allocates the buffers, the next simulate() spawns every flake
+    void resize(uint32_t inCount);
+
+    // Only the first getActiveCount() flakes are simulated and drawn, the
+    // distance thinning uniforms are ParticleLod's
+    void simulate(Shader& computeShader, float deltaTime, const glm::mat4& viewProjection, const glm::vec3& eye);
+
+    // Instanced draw of the visible flakes with the bound quad vertex array,
+    // 6 indices
+    void draw();
+
+    uint32_t getCount() const {
+        return count;
+    }
+
+    // The rest keep their last state until they are active again
+    void setActiveCount(uint32_t inActiveCount) {
+        activeCount = inActiveCount < count ? inActiveCount : count;
+    }
+
+    uint32_t getActiveCount() const {
+        return activeCount;
+    }
+
+public:
+    float gravity = -0.98f;
+    float lifeTime = 20.0f;
+    float floorHeight = -1.6f;
+    float spawnHeight = 10.0f;
+    // Flakes spawn in [-spawnExtent, spawnExtent] on x and z
+    float spawnExtent = 20.0f;
+    // Keys the respawn hash together with the frames since resize(), so a
+    // run repeats for the same seed
+    uint32_t seed = 0;
+
+private:
+    void release();
+
+    uint32_t count = 0;
+    uint32_t activeCount = 0;
+
+    uint32_t buffers[2] = {};
+    // Index of the buffer holding the latest state
+    uint32_t current = 0;
+    uint32_t visibleBuffer = 0;
+    uint32_t commandBuffer = 0;
+
+    bool bSpawnAll = true;
+    uint32_t frame = 0;
+};
@@ -0,0 +1,75 @@
+#include "GpuTimer.hpp"
+
+#include <glad.h>
+
+GpuTimer::~GpuTimer() {
+    if (queries[0][0] != 0) {
+        glDeleteQueries(QueryCount * 2, &queries[0][0]);
+    }
+}
+
+void GpuTimer::begin() {
+    if (queries[0][0] == 0) {
+        glGenQueries(QueryCount * 2, &queries[0][0]);
+    }
+
+    collect();
+
+    // Every query is still in flight, skip this frame rather than stall
+    if (bPending[current]) {
+        return;
+    }
+
+    glQueryCounter(queries[current][0], GL_TIMESTAMP);
+}
+
+void GpuTimer::end() {
+    if (queries[0][0] == 0 || bPending[current]) {
+        return;
+    }
+
+    glQueryCounter(queries[current][1], GL_TIMESTAMP);
+
+    bPending[current] = true;
+    current = (current + 1) % QueryCount;
+}
+
+void GpuTimer::collect() {
+    // Oldest first, so the moving average sees frames in order
+    for (int32_t i = 0; i < QueryCount; i++) {
+        int32_t index = (current + i) % QueryCount;
+
+        if (!bPending[index]) {
+            continue;
+        }
+
+        // The end timestamp finishes last
+        GLint bAvailable = GL_FALSE;
+        glGetQueryObjectiv(queries[index][1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+
+        if (!bAvailable) {
+            break;
+        }
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(queries[index][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[index][1], GL_QUERY_RESULT, &end);
+
+        GLuint64 nanoseconds = end > start ? end - start : 0;
+
+        bPending[index] = false;
+
+        milliseconds = static_cast<double>(nanoseconds) * 1e-6;
+        averageMilliseconds = (sampleCount == 0) ? milliseconds : averageMilliseconds * 0.95 + milliseconds * 0.05;
+        totalMilliseconds += milliseconds;
+        sampleCount++;
+    }
+}
+
+void GpuTimer::reset() {
+    milliseconds = 0.0;
+    averageMilliseconds = 0.0;
+    totalMilliseconds = 0.0;
+    sampleCount = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// GPU time of a span of GL commands, measured with a pair of GL_TIMESTAMP
+// queries so timers can nest. A small ring of query pairs is used so reading
+// a result never waits for the GPU; results show up a couple of frames late.
+class GpuTimer {
+public:
+    static constexpr int32_t QueryCount = 4;
+
+    GpuTimer() {}
+
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin();
+    void end();
+
+    // Latest finished measurement
+    double getMilliseconds() const {
+        return milliseconds;
+    }
+
+    // Exponential moving average, steadier for display
+    double getAverageMilliseconds() const {
+        return averageMilliseconds;
+    }
+
+    // Plain mean since the last reset(), for benchmarks
+    double getMeanMilliseconds() const {
+        return sampleCount > 0 ? totalMilliseconds / static_cast<double>(sampleCount) : 0.0;
+    }
+
+    // Number of finished measurements since the last reset()
+    int64_t getSampleCount() const {
+        return sampleCount;
+    }
+
+    void reset();
+
+private:
+    void collect();
+
+    // Start and end timestamp per slot
+    uint32_t queries[QueryCount][2] = {};
+    bool bPending[QueryCount] = {};
+    int32_t current = 0;
+
+    double milliseconds = 0.0;
+    double averageMilliseconds = 0.0;
+    double totalMilliseconds = 0.0;
+    int64_t sampleCount = 0;
+};
@@ -0,0 +1,91 @@
+#include "Heightfield.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void Heightfield::resize(int32_t inColumns, int32_t inRows, const glm::vec2& inMinimum, const glm::vec2& cellSize) {
+    columns = std::max(inColumns, 2);
+    rows = std::max(inRows, 2);
+    minimum = inMinimum;
+    inverseCellSize = 1.0f / cellSize;
+
+    heights.assign(static_cast<size_t>(columns) * rows, 0.0f);
+}
+
+float Heightfield::sample(float x, float z) const {
+    if (heights.empty()) {
+        return 0.0f;
+    }
+
+    // Grid coordinates, the last cell is used up to and including its edge
+    float gridX = std::clamp((x - minimum.x) * inverseCellSize.x, 0.0f, static_cast<float>(columns - 1));
+    float gridZ = std::clamp((z - minimum.y) * inverseCellSize.y, 0.0f, static_cast<float>(rows - 1));
+
+    int32_t column = std::min(static_cast<int32_t>(gridX), columns - 2);
+    int32_t row = std::min(static_cast<int32_t>(gridZ), rows - 2);
+
+    float tx = gridX - static_cast<float>(column);
+    float tz = gridZ - static_cast<float>(row);
+
+    const float* corner = &heights[static_cast<size_t>(row) * columns + column];
+
+    float nearHeight = corner[0] + (corner[1] - corner[0]) * tx;
+    float farHeight = corner[columns] + (corner[columns + 1] - corner[columns]) * tx;
+
+    return nearHeight + (farHeight - nearHeight) * tz;
+}
+
+void Heightfield::sample(const float* x, const float* z, float* outHeights, size_t count) const {
+    size_t first = 0;
+
+#if defined(__AVX2__)
+    if (bVectorized && !heights.empty()) {
+        const __m256 minimumX = _mm256_set1_ps(minimum.x);
+        const __m256 minimumZ = _mm256_set1_ps(minimum.y);
+        const __m256 scaleX = _mm256_set1_ps(inverseCellSize.x);
+        const __m256 scaleZ = _mm256_set1_ps(inverseCellSize.y);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 maximumX = _mm256_set1_ps(static_cast<float>(columns - 1));
+        const __m256 maximumZ = _mm256_set1_ps(static_cast<float>(rows - 1));
+        const __m256i lastColumn = _mm256_set1_epi32(columns - 2);
+        const __m256i lastRow = _mm256_set1_epi32(rows - 2);
+        const __m256i stride = _mm256_set1_epi32(columns);
+        const __m256i one = _mm256_set1_epi32(1);
+
+        for (; first + 8 <= count; first += 8) {
+            __m256 gridX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + first), minimumX), scaleX);
+            __m256 gridZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(z + first), minimumZ), scaleZ);
+            gridX = _mm256_min_ps(_mm256_max_ps(gridX, zero), maximumX);
+            gridZ = _mm256_min_ps(_mm256_max_ps(gridZ, zero), maximumZ);
+
+            // Non-negative after the clamp, so truncating is flooring
+            __m256i column = _mm256_min_epi32(_mm256_cvttps_epi32(gridX), lastColumn);
+            __m256i row = _mm256_min_epi32(_mm256_cvttps_epi32(gridZ), lastRow);
+
+            __m256 tx = _mm256_sub_ps(gridX, _mm256_cvtepi32_ps(column));
+            __m256 tz = _mm256_sub_ps(gridZ, _mm256_cvtepi32_ps(row));
+
+            __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(row, stride), column);
+            __m256i farIndex = _mm256_add_epi32(index, stride);
+
+            __m256 h00 = _mm256_i32gather_ps(heights.data(), index, 4);
+            __m256 h10 = _mm256_i32gather_ps(heights.data(), _mm256_add_epi32(index, one), 4);
+            __m256 h01 = _mm256_i32gather_ps(heights.data(), farIndex, 4);
+            __m256 h11 = _mm256_i32gather_ps(heights.data(), _mm256_add_epi32(farIndex, one), 4);
+
+            __m256 nearHeight = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), tx));
+            __m256 farHeight = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), tx));
+
+            _mm256_storeu_ps(outHeights + first, _mm256_add_ps(nearHeight, _mm256_mul_ps(_mm256_sub_ps(farHeight, nearHeight), tz)));
+        }
+    }
+#endif
+
+    // Tail of the vector loop, or everything without AVX2
+    for (size_t i = first; i < count; i++) {
+        outHeights[i] = sample(x[i], z[i]);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Heights on a regular x/z grid, such as the terrain built from
+// GeometryGenerator::CreateGrid. A query finds its cell by scaling the
+// position, so it costs the same anywhere, and interpolates the four
+// corners bilinearly. Positions outside the grid are clamped to its edge.
+class Heightfield {
+public:
+    Heightfield() {}
+
+    // columns x rows samples cellSize apart, the first one at minimum. At
+    // least 2 x 2; every height starts at 0.
+    void resize(int32_t inColumns, int32_t inRows, const glm::vec2& inMinimum, const glm::vec2& cellSize);
+
+    void setHeight(int32_t column, int32_t row, float height) {
+        heights[static_cast<size_t>(row) * columns + column] = height;
+    }
+
+    // World space x and z
+    float sample(float x, float z) const;
+
+    // count queries at once, 8 per iteration with AVX2 gathers
+    void sample(const float* x, const float* z, float* outHeights, size_t count) const;
+
+    bool empty() const {
+        return heights.empty();
+    }
+
+public:
+    // Scalar path only, for comparing against the vector one
+    bool bVectorized = true;
+
+private:
+    int32_t columns = 0;
+    int32_t rows = 0;
+    glm::vec2 minimum = glm::vec2(0.0f);
+    glm::vec2 inverseCellSize = glm::vec2(1.0f);
+
+    // Row by row, rows along z
+    std::vector<float> heights;
+};
@@ -0,0 +1,161 @@
+#include "LightClusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad.h>
+
+namespace {
+    // Uploads data to a shader storage buffer, orphaning the old storage.
+    // Buffers never get a zero size so that binding them is always valid.
+    template<typename T>
+    void uploadStorageBuffer(uint32_t& buffer, uint32_t binding, const std::vector<T>& data) {
+        if (buffer == 0) {
+            glGenBuffers(1, &buffer);
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+        size_t byteSize = std::max<size_t>(sizeof(T) * data.size(), sizeof(T));
+
+        glBufferData(GL_SHADER_STORAGE_BUFFER, byteSize, nullptr, GL_STREAM_DRAW);
+
+        if (!data.empty()) {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(T) * data.size(), data.data());
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+    }
+}
+
+LightClusters::~LightClusters() {
+    glDeleteBuffers(1, &lightBuffer);
+    glDeleteBuffers(1, &clusterBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+void LightClusters::build(ThreadPool& threadPool, const std::vector<PointLight>& inLights, const glm::mat4& viewMatrix,
+                          float fov, float aspect, float inNearPlane, float inFarPlane) {
+    lights = inLights;
+    nearPlane = inNearPlane;
+    farPlane = std::max(inFarPlane, inNearPlane + 0.01f);
+
+    float tanHalfHeight = std::tan(glm::radians(fov) * 0.5f);
+    tanHalfFov = glm::vec2(tanHalfHeight * aspect, tanHalfHeight);
+
+    viewSpaceLights.resize(lights.size());
+
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec3 position = glm::vec3(viewMatrix * glm::vec4(glm::vec3(lights[i].positionRadius), 1.0f));
+        viewSpaceLights[i] = glm::vec4(position, lights[i].positionRadius.w);
+    }
+
+    sliceIndices.resize(Slices);
+    sliceCounts.resize(Slices);
+
+    threadPool.parallelFor(Slices, 1, [this](size_t, size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; slice++) {
+            binSlice(static_cast<uint32_t>(slice));
+        }
+    });
+
+    // Concatenate the slices in cluster order
+    clusters.resize(ClusterCount);
+    indices.clear();
+
+    for (uint32_t slice = 0; slice < Slices; slice++) {
+        uint32_t offset = static_cast<uint32_t>(indices.size());
+
+        for (uint32_t tile = 0; tile < TilesX * TilesY; tile++) {
+            uint32_t count = sliceCounts[slice][tile];
+
+            clusters[slice * TilesX * TilesY + tile] = glm::uvec2(offset, count);
+            offset += count;
+        }
+
+        indices.insert(indices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+    }
+}
+
+void LightClusters::binSlice(uint32_t slice) {
+    float depthRatio = farPlane / nearPlane;
+    float sliceNear = nearPlane * std::pow(depthRatio, static_cast<float>(slice) / Slices);
+    float sliceFar = nearPlane * std::pow(depthRatio, static_cast<float>(slice + 1) / Slices);
+
+    auto& counts = sliceCounts[slice];
+    counts.assign(TilesX * TilesY, 0);
+
+    // (tile, light) pairs, in light order
+    thread_local std::vector<glm::uvec2> entries;
+    entries.clear();
+
+    for (size_t i = 0; i < viewSpaceLights.size(); i++) {
+        const auto& light = viewSpaceLights[i];
+        float depth = -light.z;
+        float radius = light.w;
+
+        if (depth + radius < sliceNear || depth - radius > sliceFar) {
+            continue;
+        }
+
+        // Screen bounds of the light's box within this slice. x / d is
+        // monotonic in both, so the extremes are at the corners.
+        float depths[2] = { std::max(sliceNear, depth - radius), std::min(sliceFar, depth + radius) };
+
+        glm::vec2 minimum = glm::vec2(1e30f);
+        glm::vec2 maximum = glm::vec2(-1e30f);
+
+        for (float d : depths) {
+            for (float sign : { -1.0f, 1.0f }) {
+                glm::vec2 corner = (glm::vec2(light) + sign * radius) / (d * tanHalfFov);
+                minimum = glm::min(minimum, corner);
+                maximum = glm::max(maximum, corner);
+            }
+        }
+
+        if (maximum.x < -1.0f || minimum.x > 1.0f || maximum.y < -1.0f || minimum.y > 1.0f) {
+            continue;
+        }
+
+        auto toTile = [](float ndc, uint32_t tiles) {
+            int32_t tile = static_cast<int32_t>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+            return static_cast<uint32_t>(std::clamp<int32_t>(tile, 0, static_cast<int32_t>(tiles) - 1));
+        };
+
+        uint32_t x0 = toTile(minimum.x, TilesX);
+        uint32_t x1 = toTile(maximum.x, TilesX);
+        uint32_t y0 = toTile(minimum.y, TilesY);
+        uint32_t y1 = toTile(maximum.y, TilesY);
+
+        for (uint32_t y = y0; y <= y1; y++) {
+            for (uint32_t x = x0; x <= x1; x++) {
+                uint32_t tile = y * TilesX + x;
+                entries.push_back(glm::uvec2(tile, static_cast<uint32_t>(i)));
+                counts[tile]++;
+            }
+        }
+    }
+
+    // Counting sort by tile
+    thread_local std::vector<uint32_t> offsets;
+    offsets.assign(TilesX * TilesY, 0);
+
+    for (uint32_t tile = 1; tile < TilesX * TilesY; tile++) {
+        offsets[tile] = offsets[tile - 1] + counts[tile - 1];
+    }
+
+    auto& sorted = sliceIndices[slice];
+    sorted.resize(entries.size());
+
+    for (const auto& entry : entries) {
+        sorted[offsets[entry.x]++] = entry.y;
+    }
+}
+
+void LightClusters::upload() {
+    uploadStorageBuffer(lightBuffer, LightBinding, lights);
+    uploadStorageBuffer(clusterBuffer, ClusterBinding, clusters);
+    uploadStorageBuffer(indexBuffer, IndexBinding, indices);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "ThreadPool.hpp"
+
+// Matches struct PointLight in scene.frag (std430)
+struct PointLight {
+    // World space position, radius of influence in w
+    glm::vec4 positionRadius;
+    // Color premultiplied by intensity
+    glm::vec4 color;
+};
+
+// Clustered forward lighting. The view frustum is split into a grid of
+// TilesX x TilesY screen tiles and Slices exponential depth slices. Every
+// frame the point lights are binned into the clusters they touch on the
+// thread pool, and the result is uploaded to three shader storage buffers:
+// the lights, an (offset, count) pair per cluster and the light index list.
+class LightClusters {
+public:
+    static constexpr uint32_t TilesX = 16;
+    static constexpr uint32_t TilesY = 9;
+    static constexpr uint32_t Slices = 24;
+    static constexpr uint32_t ClusterCount = TilesX * TilesY * Slices;
+
+    // Shader storage buffer binding points used by scene.frag
+    static constexpr uint32_t LightBinding = 0;
+    static constexpr uint32_t ClusterBinding = 1;
+    static constexpr uint32_t IndexBinding = 2;
+
+    LightClusters() {}
+
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // No GL calls, may run while the GL thread is idle
+    void build(ThreadPool& threadPool, const std::vector<PointLight>& inLights, const glm::mat4& viewMatrix,
+               float fov, float aspect, float inNearPlane, float inFarPlane);
+
+    // Uploads the last build() and binds the buffers, on the GL thread
+    void upload();
+
+    float getNearPlane() const {
+        return nearPlane;
+    }
+
+    float getFarPlane() const {
+        return farPlane;
+    }
+
+    // tan(fov / 2) horizontally and vertically
+    glm::vec2 getTanHalfFov() const {
+        return tanHalfFov;
+    }
+
+    size_t getLightCount() const {
+        return lights.size();
+    }
+
+    size_t getIndexCount() const {
+        return indices.size();
+    }
+
+private:
+    void binSlice(uint32_t slice);
+
+    std::vector<PointLight> lights;
+    std::vector<glm::vec4> viewSpaceLights;
+
+    // (offset, count) into indices per cluster
+    std::vector<glm::uvec2> clusters;
+    std::vector<uint32_t> indices;
+
+    // Per slice scratch, sorted by tile
+    std::vector<std::vector<uint32_t>> sliceIndices;
+    std::vector<std::vector<uint32_t>> sliceCounts;
+
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    glm::vec2 tanHalfFov = glm::vec2(1.0f);
+
+    uint32_t lightBuffer = 0;
+    uint32_t clusterBuffer = 0;
+    uint32_t indexBuffer = 0;
+};
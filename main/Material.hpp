@@ -15,4 +15,6 @@ struct Material {
     float ior;
     float eta;
     bool hasNormalMap = false;
+    // Back faces are lit with the flipped normal, see DOUBLE_SIDED in scene.frag
+    bool bDoubleSided = true;
 };
\ No newline at end of file
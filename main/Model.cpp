@@ -1,5 +1,8 @@
 #include "Model.hpp"
 
+#include <algorithm>
+#include <unordered_map>
+
 #define UNUSED(x) (void)(x)
 
 void Model::computeTangentSpace() {
@@ -76,7 +79,89 @@ void Mesh::computeTangentSpace() {
     }
 }
 
+std::vector<glm::vec3> Mesh::computeIslandCenters() const {
+    std::vector<uint32_t> parents(vertices.size());
+
+    for (uint32_t i = 0; i < parents.size(); i++) {
+        parents[i] = i;
+    }
+
+    auto find = [&parents](uint32_t i) {
+        while (parents[i] != i) {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+
+        return i;
+    };
+
+    auto merge = [&](uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+
+        if (a != b) {
+            parents[std::max(a, b)] = std::min(a, b);
+        }
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        merge(indices[i], indices[i + 1]);
+        merge(indices[i], indices[i + 2]);
+    }
+
+    std::unordered_map<glm::vec3, uint32_t> firstAtPosition;
+
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        auto result = firstAtPosition.insert({ vertices[i].position, i });
+
+        if (!result.second) {
+            merge(i, result.first->second);
+        }
+    }
+
+    // Center of each piece's bounding box
+    std::unordered_map<uint32_t, std::pair<glm::vec3, glm::vec3>> bounds;
+
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        const auto& position = vertices[i].position;
+        auto result = bounds.insert({ find(i), { position, position } });
+
+        if (!result.second) {
+            auto& box = result.first->second;
+            box.first = glm::min(box.first, position);
+            box.second = glm::max(box.second, position);
+        }
+    }
+
+    std::vector<glm::vec3> centers;
+
+    for (const auto& piece : bounds) {
+        centers.push_back((piece.second.first + piece.second.second) * 0.5f);
+    }
+
+    return centers;
+}
+
 void Mesh::prepareDraw() {
+    if (!vertices.empty()) {
+        glm::vec3 minimum = vertices[0].position;
+        glm::vec3 maximum = vertices[0].position;
+
+        for (const auto& vertex : vertices) {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radius = 0.0f;
+
+        for (const auto& vertex : vertices) {
+            radius = std::max(radius, glm::length(vertex.position - center));
+        }
+
+        boundingSphere = glm::vec4(center, radius);
+    }
+
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
@@ -113,6 +198,26 @@ void Mesh::prepareDraw() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, getIndexBufferByteSize(), getIndicesData(), GL_STATIC_DRAW);
 
+    // Depth-only stream: depth.vert only reads the position
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+
+    for (const auto& vertex : vertices) {
+        positions.push_back(vertex.position);
+    }
+
+    glGenVertexArrays(1, &depthVAO);
+    glBindVertexArray(depthVAO);
+
+    glGenBuffers(1, &positionVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)nullptr);
+    glEnableVertexAttribArray(0);	// Vertex Position
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+
     glGenVertexArrays(1, &VAONormal);
     glBindVertexArray(VAONormal);
 
@@ -12,7 +12,9 @@
 #include "glm/gtx/hash.hpp"
 
 #include "Texture.hpp"
+#include "TextureArray.hpp"
 #include "Material.hpp"
+#include "SceneNode.hpp"
 
 struct SimpleVertex {
     glm::vec3 position;
@@ -61,9 +63,16 @@ public:
     }
 
     ~Mesh() {
+        // Never drawn, e.g. loaded by the bench without a GL context
+        if (VAO == 0) {
+            return;
+        }
+
         glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &IBO);
         glDeleteBuffers(1, &VAO);
+        glDeleteBuffers(1, &positionVBO);
+        glDeleteVertexArrays(1, &depthVAO);
     }
 
     void addVertex(const Vertex& vertex) {
@@ -86,11 +95,11 @@ public:
         return static_cast<uint32_t>(vertices.size() / 3);
     }
 
-    void addTexture(const std::shared_ptr<Texture>& texture) {
+    void addTexture(const TextureLayer& texture) {
         textures.push_back(texture);
     }
 
-    void setTexture(int32_t index, const std::shared_ptr<Texture>& texture) {
+    void setTexture(int32_t index, const TextureLayer& texture) {
         if (!textures.empty()) {
 			if (index <= (static_cast<int32_t>(textures.size()) - 1)) {
 				textures[index] = texture;
@@ -98,18 +107,14 @@ public:
         }
     }
 
-    int32_t getTextureIndex(uint32_t index) const {
+    // Array index and layer of the index-th material texture, for the
+    // materialTextures[] sampler array in the shaders
+    glm::ivec2 getTextureLayer(uint32_t index) const {
         if (index >= static_cast<uint32_t>(textures.size())) {
-            return 0;
-        }
-
-        auto texture = textures[index];
-
-        if (texture) {
-            return texture->getTextureIndex();
+            return glm::ivec2(0);
         }
 
-        return 0;
+        return glm::ivec2(textures[index].array, textures[index].layer);
     }
 
     void setMaterial(const std::shared_ptr<Material>& inMaterial) {
@@ -162,6 +167,11 @@ public:
 
     void computeTangentSpace();
 
+    // Object space centers of the connected pieces of the mesh, e.g. the
+    // single balls of an ornament mesh. Vertices at the same position are
+    // treated as connected, so texture seams don't split a piece.
+    std::vector<glm::vec3> computeIslandCenters() const;
+
     void prepareDraw();
 
     void use() {
@@ -171,6 +181,20 @@ public:
     void useNormal() {
         glBindVertexArray(VAONormal);
     }
+
+    uint32_t getVertexArray() const {
+        return VAO;
+    }
+
+    // Positions only, for depth-only passes
+    uint32_t getDepthVertexArray() const {
+        return depthVAO;
+    }
+
+    // Object space center (xyz) and radius (w), valid after prepareDraw()
+    glm::vec4 getBoundingSphere() const {
+        return boundingSphere;
+    }
 private:
     std::string name;
 
@@ -184,15 +208,22 @@ private:
     uint32_t VBONormal = 0;
     uint32_t VAONormal = 0;
 
+    // Tightly packed positions sharing IBO, 12 bytes per vertex instead of 56
+    uint32_t positionVBO = 0;
+    uint32_t depthVAO = 0;
+
+    glm::vec4 boundingSphere = glm::vec4(0.0f);
+
     std::shared_ptr<Material> material;
-    std::vector<std::shared_ptr<Texture>> textures;
+    std::vector<TextureLayer> textures;
 };
 
-class Model {
+// The transform functions below work on the local transform, relative to the
+// parent node. Rendering uses getWorldTransform().
+class Model : public SceneNode {
 public:
     Model() {
         position = glm::vec3(0.0f);
-        transform = glm::mat4(1.0f);
     }
 
     ~Model() {
@@ -203,21 +234,24 @@ public:
     }
 
     void scale(const glm::vec3& factor) {
-        transform = glm::scale(transform, factor);
+        setLocalTransform(glm::scale(getLocalTransform(), factor));
     }
 
     void setScale(const glm::vec3& inScale) {
+        glm::mat4 transform = getLocalTransform();
         transform[0][0] = inScale.x;
         transform[1][1] = inScale.y;
         transform[2][2] = inScale.z;
+        setLocalTransform(transform);
     }
 
     glm::vec3 getScale() const {
+        const glm::mat4& transform = getLocalTransform();
         return glm::vec3(transform[0][0], transform[1][1], transform[2][2]);
     }
 
     void translate(const glm::vec3& offset) {
-        transform = glm::translate(transform, offset);
+        setLocalTransform(glm::translate(getLocalTransform(), offset));
     }
 
     void rotate(float angle, const glm::vec3& axis) {
@@ -228,14 +262,16 @@ public:
         forward.y = newForward.y;
         forward.z = newForward.z;
 
-        transform *= rotation;
+        setLocalTransform(getLocalTransform() * rotation);
     }
 
     void setPosition(const glm::vec3& inPosition) {
         position = inPosition;
+        glm::mat4 transform = getLocalTransform();
         transform[3][0] = position.x;
         transform[3][1] = position.y;
         transform[3][2] = position.z;
+        setLocalTransform(transform);
     }
 
     glm::vec3 getPosition() const {
@@ -247,14 +283,14 @@ public:
 	}
 
     void setTransform(const glm::mat4& inTransform) {
-        transform = inTransform;
-        position.x = transform[3][0];
-        position.y = transform[3][1];
-        position.z = transform[3][2];
+        setLocalTransform(inTransform);
+        position.x = inTransform[3][0];
+        position.y = inTransform[3][1];
+        position.z = inTransform[3][2];
     }
 
     glm::mat4 getTransform() const {
-        return transform;
+        return getLocalTransform();
     }
 
     void computeTangentSpace();
@@ -306,6 +342,8 @@ public:
 
     bool bJumping = false;
     bool bVisible = true;
+    // Moves at runtime; shadows are redrawn every frame instead of cached
+    bool bDynamic = false;
 private:
     glm::vec3 forward = glm::vec3(0.0f, 0.0f, 1.0f);
     glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);;
@@ -314,7 +352,6 @@ private:
     std::string name;
 
     glm::vec3 position;
-    glm::mat4 transform;
 
     std::vector <std::shared_ptr<Mesh>> meshes;
 
@@ -0,0 +1,120 @@
+#include "ModelLoader.hpp"
+
+#include <iostream>
+#include <unordered_map>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tinyobjloader/tiny_obj_loader.h"
+
+std::shared_ptr<Model> loadObjModel(const std::string& fileName, const std::string& inName, const std::string& materialPath, const std::string& texturePath,
+    const TextureLoader& loadTexture, const TextureLayer& defaultTexture) {
+    tinyobj::ObjReaderConfig readConfig;
+    readConfig.mtl_search_path = materialPath;
+
+    tinyobj::ObjReader reader;
+
+    if (!reader.ParseFromFile(fileName, readConfig)) {
+        if (!reader.Error().empty()) {
+            std::cerr << "TinyObjRead: " << reader.Error();
+        }
+        return nullptr;
+    }
+
+    if (!reader.Warning().empty()) {
+        std::cout << "TinyObjReader: " << reader.Warning();
+    }
+
+    auto slash = fileName.find_last_of('/');
+    auto dot = fileName.find_last_of('.');
+
+    auto model = std::make_shared<Model>();
+
+    if (!inName.empty()) {
+        model->setName(inName);
+    }
+    else {
+        model->setName(fileName.substr(slash + 1, dot - (slash + 1)));
+    }
+
+    auto& attrib = reader.GetAttrib();
+    auto& shapes = reader.GetShapes();
+    auto& objMaterials = reader.GetMaterials();
+
+    size_t materialIndex = 0;
+
+    for (const auto& shape : shapes) {
+        auto mesh = std::make_shared<Mesh>();
+        std::unordered_map<Vertex, uint32_t> uniqueVertices;
+        for (const auto& index : shape.mesh.indices) {
+            Vertex vertex = {};
+
+            vertex.position = {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2]
+            };
+
+            // Check if 'normal_index' is zero of positive. negative = no normal data
+            if (index.normal_index >= 0) {
+                tinyobj::real_t nx = attrib.normals[3 * size_t(index.normal_index) + 0];
+                tinyobj::real_t ny = attrib.normals[3 * size_t(index.normal_index) + 1];
+                tinyobj::real_t nz = attrib.normals[3 * size_t(index.normal_index) + 2];
+                vertex.normal = { nx, ny, nz };
+            }
+
+            if (index.texcoord_index >= 0) {
+                vertex.texCoord = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+
+            if (uniqueVertices.count(vertex) == 0) {
+                uniqueVertices[vertex] = static_cast<uint32_t>(mesh->getVertices().size());
+                mesh->addVertex(vertex);
+            }
+
+            mesh->addIndex(uniqueVertices[vertex]);
+        }
+
+        mesh->setName(shape.name);
+
+        const auto& material = objMaterials[materialIndex];
+
+        auto meshMaterial = std::make_shared<Material>();
+
+        meshMaterial->Ka = { material.ambient[0], material.ambient[1], material.ambient[2] };
+        meshMaterial->Kd = { material.diffuse[0], material.diffuse[1], material.diffuse[2] };
+        meshMaterial->Ke = { material.emission[0], material.emission[1], material.emission[2] };
+        meshMaterial->Ks = { material.specular[0], material.specular[1], material.specular[2] };
+
+        meshMaterial->shininess = material.shininess;
+        meshMaterial->ior = material.ior;
+        meshMaterial->eta = 1.0f / meshMaterial->ior;
+
+        if (!material.diffuse_texname.empty()) {
+            auto texture = loadTexture(material.name + "Diffuse", texturePath + material.diffuse_texname);
+
+            mesh->addTexture(texture);
+
+        }
+        else {
+            mesh->addTexture(defaultTexture);
+        }
+
+        if (!material.bump_texname.empty()) {
+            auto texture = loadTexture(material.name + "Normal", texturePath + material.bump_texname);
+
+            mesh->addTexture(texture);
+            meshMaterial->hasNormalMap = true;
+        }
+
+        mesh->setMaterial(std::move(meshMaterial));
+
+        materialIndex++;
+
+        model->addMesh(std::move(mesh));
+    }
+
+    return model;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Model.hpp"
+
+// Turns a material texture's name and file into a texture layer, e.g. by
+// adding it to the material texture arrays
+using TextureLoader = std::function<TextureLayer(const std::string& name, const std::string& path)>;
+
+// Reads an OBJ file into a model with one mesh per shape, merging the
+// corners that share position, normal and texture coordinates. Meshes
+// without a diffuse map get defaultTexture. Returns nullptr when the file
+// can't be parsed.
+std::shared_ptr<Model> loadObjModel(const std::string& fileName, const std::string& inName, const std::string& materialPath, const std::string& texturePath,
+    const TextureLoader& loadTexture, const TextureLayer& defaultTexture);
@@ -0,0 +1,49 @@
+#include "ParticleLod.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void ParticleLod::update(float milliseconds) {
+    averageMilliseconds += (milliseconds - averageMilliseconds) * 0.1f;
+
+    if (!bEnabled) {
+        return;
+    }
+
+    // Back off in proportion to the overrun, grow back slowly with some
+    // headroom so the density doesn't oscillate around the budget
+    if (averageMilliseconds > budgetMilliseconds) {
+        density *= std::max(0.9f, budgetMilliseconds / averageMilliseconds);
+    }
+    else if (averageMilliseconds < budgetMilliseconds * 0.8f) {
+        density *= 1.02f;
+    }
+
+    density = std::clamp(density, minDensity, 1.0f);
+}
+
+float ParticleLod::getKeepFraction(float distance) const {
+    if (!bEnabled) {
+        return 1.0f;
+    }
+
+    float t = std::clamp((distance - nearDistance) / std::max(farDistance - nearDistance, 0.001f), 0.0f, 1.0f);
+
+    return 1.0f + (1.0f / mergeFactor - 1.0f) * t;
+}
+
+float ParticleLod::getSizeScale(float keepFraction) const {
+    return 1.0f / std::sqrt(keepFraction);
+}
+
+float ParticleLod::getFlakeKey(float gravityEffect) {
+    float key = gravityEffect * 4099.0f;
+    return key - std::floor(key);
+}
+
+void ParticleLod::setUniforms(Shader& shader) const {
+    shader.setUniform("lodNear", nearDistance);
+    shader.setUniform("lodFar", farDistance);
+    // Nothing is thinned when merging one to one
+    shader.setUniform("lodMerge", bEnabled ? mergeFactor : 1.0f);
+}
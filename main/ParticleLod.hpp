@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Shader.hpp"
+
+// Level of detail of the snow, shared by ParticlePool and GpuParticles.
+// Past nearDistance flakes are thinned out, down to one in mergeFactor at
+// farDistance, and the ones left are drawn larger so the covered area stays
+// the same. Which flakes go is decided by a key hashed from their gravity
+// effect, which never changes, so thinning doesn't flicker. On top of that
+// a density in [minDensity, 1] is steered by the measured cost of the snow
+// to keep it inside budgetMilliseconds; it scales the spawn rate of the CPU
+// pool and the number of flakes the GPU simulates.
+class ParticleLod {
+public:
+    // Feeds the cost of the last frame's snow, CPU and GPU together
+    void update(float milliseconds);
+
+    // Fraction of the flakes kept at a distance from the eye
+    float getKeepFraction(float distance) const;
+
+    // Size of a kept flake, relative to a flake up close
+    float getSizeScale(float keepFraction) const;
+
+    // Stable key of a flake in [0, 1), kept when below getKeepFraction().
+    // Same as flakeKey() in particle_lod.glsl.
+    static float getFlakeKey(float gravityEffect);
+
+    // The lod* uniforms of particle_lod.glsl
+    void setUniforms(Shader& shader) const;
+
+    float getDensity() const {
+        return bEnabled ? density : 1.0f;
+    }
+
+    float getAverageMilliseconds() const {
+        return averageMilliseconds;
+    }
+
+public:
+    bool bEnabled = true;
+    float budgetMilliseconds = 0.5f;
+    float nearDistance = 10.0f;
+    float farDistance = 35.0f;
+    float mergeFactor = 4.0f;
+    float minDensity = 0.1f;
+
+private:
+    float density = 1.0f;
+    float averageMilliseconds = 0.0f;
+};
@@ -0,0 +1,145 @@
+#include "ParticlePool.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+ParticlePool::ParticlePool(size_t inCapacity)
+    : positionX(inCapacity), positionY(inCapacity), positionZ(inCapacity),
+      velocityX(inCapacity), velocityY(inCapacity), velocityZ(inCapacity),
+      gravityEffect(inCapacity), age(inCapacity), rotation(inCapacity), groundHeights(inCapacity) {
+    deadIndices.reserve(inCapacity);
+}
+
+bool ParticlePool::spawn(const glm::vec3& position, const glm::vec3& velocity, float inGravityEffect) {
+    if (count == capacity()) {
+        return false;
+    }
+
+    positionX[count] = position.x;
+    positionY[count] = position.y;
+    positionZ[count] = position.z;
+    velocityX[count] = velocity.x;
+    velocityY[count] = velocity.y;
+    velocityZ[count] = velocity.z;
+    gravityEffect[count] = inGravityEffect;
+    age[count] = 0.0f;
+    rotation[count] = 0.0f;
+
+    count++;
+
+    return true;
+}
+
+void ParticlePool::update(float deltaTime) {
+    deadIndices.clear();
+
+    size_t first = 0;
+
+#if defined(__AVX__)
+    if (bVectorized) {
+        const __m256 gravityStep = _mm256_set1_ps(gravity * deltaTime);
+        const __m256 timeStep = _mm256_set1_ps(deltaTime);
+        const __m256 rotationStep = _mm256_set1_ps(deltaTime * RotationSpeed);
+
+        for (; first + 8 <= count; first += 8) {
+            __m256 vy = _mm256_mul_ps(gravityStep, _mm256_loadu_ps(&gravityEffect[first]));
+            _mm256_storeu_ps(&velocityY[first], vy);
+
+            __m256 x = _mm256_add_ps(_mm256_loadu_ps(&positionX[first]), _mm256_loadu_ps(&velocityX[first]));
+            __m256 y = _mm256_add_ps(_mm256_loadu_ps(&positionY[first]), vy);
+            __m256 z = _mm256_add_ps(_mm256_loadu_ps(&positionZ[first]), _mm256_loadu_ps(&velocityZ[first]));
+            _mm256_storeu_ps(&positionX[first], x);
+            _mm256_storeu_ps(&positionY[first], y);
+            _mm256_storeu_ps(&positionZ[first], z);
+
+            _mm256_storeu_ps(&age[first], _mm256_add_ps(_mm256_loadu_ps(&age[first]), timeStep));
+            _mm256_storeu_ps(&rotation[first], _mm256_add_ps(_mm256_loadu_ps(&rotation[first]), rotationStep));
+        }
+    }
+#endif
+
+    // Tail of the vector loop, or everything without AVX
+    integrate(first, count, deltaTime);
+
+    land();
+
+    removeDead();
+}
+
+void ParticlePool::integrate(size_t first, size_t last, float deltaTime) {
+    // Same rounding as the vector path
+    const float gravityStep = gravity * deltaTime;
+
+    for (size_t i = first; i < last; i++) {
+        velocityY[i] = gravityStep * gravityEffect[i];
+
+        positionX[i] += velocityX[i];
+        positionY[i] += velocityY[i];
+        positionZ[i] += velocityZ[i];
+        age[i] += deltaTime;
+        rotation[i] += deltaTime * RotationSpeed;
+    }
+}
+
+void ParticlePool::land() {
+    if (ground && !ground->empty()) {
+        ground->sample(positionX.data(), positionZ.data(), groundHeights.data(), count);
+    }
+    else {
+        std::fill(groundHeights.begin(), groundHeights.begin() + count, floorHeight);
+    }
+
+    size_t first = 0;
+
+#if defined(__AVX__)
+    if (bVectorized) {
+        const __m256 lifeTimes = _mm256_set1_ps(lifeTime);
+
+        for (; first + 8 <= count; first += 8) {
+            __m256 floors = _mm256_loadu_ps(&groundHeights[first]);
+            __m256 y = _mm256_max_ps(_mm256_loadu_ps(&positionY[first]), floors);
+            _mm256_storeu_ps(&positionY[first], y);
+
+            // Dead once past its lifetime and resting on the ground
+            __m256 dead = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&age[first]), lifeTimes, _CMP_GE_OQ), _mm256_cmp_ps(y, floors, _CMP_LE_OQ));
+            int32_t mask = _mm256_movemask_ps(dead);
+
+            for (int32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    deadIndices.push_back(static_cast<uint32_t>(first + lane));
+                }
+            }
+        }
+    }
+#endif
+
+    for (size_t i = first; i < count; i++) {
+        positionY[i] = std::max(positionY[i], groundHeights[i]);
+
+        if (age[i] >= lifeTime && positionY[i] <= groundHeights[i]) {
+            deadIndices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+void ParticlePool::removeDead() {
+    // Highest first, every particle above the current index is alive by
+    // then, so the one swapped in never needs checking again
+    for (auto iterator = deadIndices.rbegin(); iterator != deadIndices.rend(); ++iterator) {
+        size_t index = *iterator;
+        size_t last = --count;
+
+        positionX[index] = positionX[last];
+        positionY[index] = positionY[last];
+        positionZ[index] = positionZ[last];
+        velocityX[index] = velocityX[last];
+        velocityY[index] = velocityY[last];
+        velocityZ[index] = velocityZ[last];
+        gravityEffect[index] = gravityEffect[last];
+        age[index] = age[last];
+        rotation[index] = rotation[last];
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Heightfield.hpp"
+
+// Falling snowflakes in structure-of-arrays form. Each field is its own
+// array, so update() streams through 8 particles per AVX instruction.
+// Storage is allocated once; a dead particle is swapped with the last live
+// one, so the live particles are always [0, size()) in no particular order.
+class ParticlePool {
+public:
+    explicit ParticlePool(size_t inCapacity);
+
+    // False when the pool is full
+    bool spawn(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.0f), float gravityEffect = 1.0f);
+
+    // Integrates every particle, stops the ones that reached the ground,
+    // then removes the ones that have outlived their lifetime on it
+    void update(float deltaTime);
+
+    void clear() {
+        count = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t capacity() const {
+        return positionX.size();
+    }
+
+    glm::vec3 getPosition(size_t index) const {
+        return { positionX[index], positionY[index], positionZ[index] };
+    }
+
+    // Degrees
+    float getRotation(size_t index) const {
+        return rotation[index];
+    }
+
+    float getGravityEffect(size_t index) const {
+        return gravityEffect[index];
+    }
+
+public:
+    float gravity = -0.98f;
+    float lifeTime = 20.0f;
+    float floorHeight = -1.6f;
+    // Ground to land on, a flat floor at floorHeight when null
+    const Heightfield* ground = nullptr;
+    // Scalar path only, for comparing against the vector one
+    bool bVectorized = true;
+
+private:
+    // Degrees per second
+    static constexpr float RotationSpeed = 5.0f;
+
+    void integrate(size_t first, size_t last, float deltaTime);
+    // Clamps to the ground and finds the dead particles
+    void land();
+    void removeDead();
+
+    size_t count = 0;
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    // Displacement per update, y is recomputed from gravity every time
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    std::vector<float> gravityEffect;
+    std::vector<float> age;
+    std::vector<float> rotation;
+
+    // Scratch, ground height under each particle
+    std::vector<float> groundHeights;
+
+    // Ascending indices found dead by the last update
+    std::vector<uint32_t> deadIndices;
+};
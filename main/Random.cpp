@@ -0,0 +1,142 @@
+#include "Random.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    uint64_t splitMix64(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+#if defined(__AVX2__)
+    // One xoshiro128+ step of 8 lanes held in registers, returns the outputs
+    __m256i stepLanes(__m256i& s0, __m256i& s1, __m256i& s2, __m256i& s3) {
+        __m256i result = _mm256_add_epi32(s0, s3);
+        __m256i t = _mm256_slli_epi32(s1, 9);
+
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+
+        return result;
+    }
+#else
+    uint32_t rotateLeft(uint32_t x, int32_t k) {
+        return (x << k) | (x >> (32 - k));
+    }
+#endif
+}
+
+void RandomStream::seed(uint64_t inSeed, uint64_t stream) {
+    // Streams start far apart in splitmix64's sequence
+    uint64_t x = inSeed ^ (stream * 0xD1B54A32D192ED03ull);
+
+    for (uint32_t lane = 0; lane < Lanes; lane++) {
+        uint64_t a = splitMix64(x);
+        uint64_t b = splitMix64(x);
+
+        state[0][lane] = static_cast<uint32_t>(a);
+        state[1][lane] = static_cast<uint32_t>(a >> 32);
+        state[2][lane] = static_cast<uint32_t>(b);
+        state[3][lane] = static_cast<uint32_t>(b >> 32);
+
+        // All zero is the one state xoshiro can't leave
+        if ((a | b) == 0) {
+            state[0][lane] = 1;
+        }
+    }
+
+    pendingIndex = Lanes;
+}
+
+void RandomStream::step(uint32_t* outputs) {
+#if defined(__AVX2__)
+    __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[0]));
+    __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[1]));
+    __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[2]));
+    __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[3]));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(outputs), stepLanes(s0, s1, s2, s3));
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[0]), s0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[1]), s1);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[2]), s2);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[3]), s3);
+#else
+    for (uint32_t lane = 0; lane < Lanes; lane++) {
+        uint32_t& s0 = state[0][lane];
+        uint32_t& s1 = state[1][lane];
+        uint32_t& s2 = state[2][lane];
+        uint32_t& s3 = state[3][lane];
+
+        outputs[lane] = s0 + s3;
+
+        uint32_t t = s1 << 9;
+
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotateLeft(s3, 11);
+    }
+#endif
+}
+
+uint32_t RandomStream::nextUint() {
+    if (pendingIndex == Lanes) {
+        step(pending);
+        pendingIndex = 0;
+    }
+
+    return pending[pendingIndex++];
+}
+
+float RandomStream::nextFloat(float minimum, float maximum) {
+    return minimum + nextFloat() * (maximum - minimum);
+}
+
+void RandomStream::fillUniform(float* values, size_t count, float minimum, float maximum) {
+    float range = maximum - minimum;
+    size_t i = 0;
+
+    // Leftovers of the last step first, so the sequence matches nextFloat()
+    for (; i < count && pendingIndex < Lanes; i++) {
+        values[i] = minimum + toUnitFloat(pending[pendingIndex++]) * range;
+    }
+
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+    const __m256 minimums = _mm256_set1_ps(minimum);
+    const __m256 ranges = _mm256_set1_ps(range);
+
+    // State stays in registers for the whole batch
+    __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[0]));
+    __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[1]));
+    __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[2]));
+    __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[3]));
+
+    for (; i + Lanes <= count; i += Lanes) {
+        __m256i bits = _mm256_srli_epi32(stepLanes(s0, s1, s2, s3), 8);
+        __m256 unit = _mm256_mul_ps(_mm256_cvtepi32_ps(bits), scale);
+
+        _mm256_storeu_ps(values + i, _mm256_add_ps(minimums, _mm256_mul_ps(unit, ranges)));
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[0]), s0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[1]), s1);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[2]), s2);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(state[3]), s3);
+#endif
+
+    for (; i < count; i++) {
+        values[i] = nextFloat(minimum, maximum);
+    }
+}
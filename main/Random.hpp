@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Eight interleaved xoshiro128+ generators, so one step yields 8 numbers and
+// fillUniform() runs 8 lanes per AVX2 instruction. The scalar and vector
+// paths produce the same sequence.
+//
+// A (seed, stream) pair fully determines the sequence; different streams of
+// one seed are independent, so each worker thread can own one and a run
+// repeats exactly for a given seed.
+class RandomStream {
+public:
+    static constexpr uint32_t Lanes = 8;
+
+    explicit RandomStream(uint64_t inSeed = 0, uint64_t stream = 0) {
+        seed(inSeed, stream);
+    }
+
+    void seed(uint64_t inSeed, uint64_t stream = 0);
+
+    uint32_t nextUint();
+
+    // [0, 1)
+    float nextFloat() {
+        return toUnitFloat(nextUint());
+    }
+
+    // [minimum, maximum). Out of line, so the one definition is built without
+    // FMA contraction like fillUniform() (see premake5.lua)
+    float nextFloat(float minimum, float maximum);
+
+    // count floats in [minimum, maximum), same values as that many
+    // nextFloat(minimum, maximum) calls
+    void fillUniform(float* values, size_t count, float minimum = 0.0f, float maximum = 1.0f);
+
+private:
+    // Top 24 bits, every float in [0, 1) that can be hit is equally likely
+    static float toUnitFloat(uint32_t value) {
+        return static_cast<float>(value >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Advances every lane and writes one output per lane
+    void step(uint32_t* outputs);
+
+    alignas(32) uint32_t state[4][Lanes];
+
+    // Outputs of the last step not handed out yet
+    uint32_t pending[Lanes];
+    uint32_t pendingIndex = Lanes;
+};
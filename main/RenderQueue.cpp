@@ -0,0 +1,106 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Items per chunk below which splitting costs more than it saves
+    constexpr size_t MinItemsPerChunk = 4;
+
+    float getMaxScale(const glm::mat4& worldMatrix) {
+        float x = glm::dot(glm::vec3(worldMatrix[0]), glm::vec3(worldMatrix[0]));
+        float y = glm::dot(glm::vec3(worldMatrix[1]), glm::vec3(worldMatrix[1]));
+        float z = glm::dot(glm::vec3(worldMatrix[2]), glm::vec3(worldMatrix[2]));
+
+        return std::sqrt(std::max(x, std::max(y, z)));
+    }
+}
+
+void RenderQueue::build(ThreadPool& threadPool, const TransformStage& transformStage, const std::vector<RenderItem>& items, const std::vector<RenderPassView>& passes) {
+    passCount = passes.size();
+
+    size_t chunkCount = std::max<size_t>(threadPool.getChunkCount(items.size(), MinItemsPerChunk), 1);
+
+    if (drawLists.size() < passCount) {
+        drawLists.resize(passCount);
+    }
+
+    std::vector<Frustum> frustums(passCount);
+
+    for (size_t pass = 0; pass < passCount; pass++) {
+        drawLists[pass].resize(chunkCount);
+
+        for (auto& drawList : drawLists[pass]) {
+            drawList.clear();
+        }
+
+        frustums[pass] = Frustum(passes[pass].projectionMatrix * passes[pass].viewMatrix);
+    }
+
+    threadPool.parallelFor(items.size(), MinItemsPerChunk, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& item = items[i];
+
+            if (!item.model || !item.model->bVisible) {
+                continue;
+            }
+
+            for (size_t pass = 0; pass < passCount; pass++) {
+                const auto& passView = passes[pass];
+
+                if (!passView.bEnabled) {
+                    continue;
+                }
+
+                if (passView.bDepthOnly) {
+                    if (!item.bCastShadow) {
+                        continue;
+                    }
+
+                    if ((passView.casters == ShadowCasters::Static && item.bDynamic) ||
+                        (passView.casters == ShadowCasters::Dynamic && !item.bDynamic)) {
+                        continue;
+                    }
+                }
+
+                const glm::mat4& worldMatrix = transformStage.get(pass, item.transform).worldMatrix;
+                float maxScale = getMaxScale(worldMatrix);
+
+                auto& drawList = drawLists[pass][chunk];
+
+                for (const auto& mesh : item.model->getMeshes()) {
+                    glm::vec4 boundingSphere = mesh->getBoundingSphere();
+                    glm::vec3 center = glm::vec3(worldMatrix * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+
+                    if (!frustums[pass].intersectsSphere(center, boundingSphere.w * maxScale)) {
+                        continue;
+                    }
+
+                    DrawCommand command;
+                    command.lightColor = item.lightColor;
+                    command.textureLayers[0] = mesh->getTextureLayer(0);
+                    command.textureLayers[1] = mesh->getTextureLayer(1);
+                    command.material = mesh->getMaterial().get();
+                    command.vertexArray = mesh->getVertexArray();
+                    command.depthVertexArray = mesh->getDepthVertexArray();
+                    command.indexCount = mesh->getIndexCount();
+                    command.transform = item.transform;
+                    command.pipeline = item.pipeline;
+                    command.bLight = item.bLight;
+
+                    drawList.push_back(command);
+                }
+            }
+        }
+    });
+}
+
+size_t RenderQueue::getCommandCount(size_t pass) const {
+    size_t count = 0;
+
+    for (const auto& drawList : drawLists[pass]) {
+        count += drawList.size();
+    }
+
+    return count;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Frustum.hpp"
+#include "Model.hpp"
+#include "ThreadPool.hpp"
+#include "TransformStage.hpp"
+
+enum class DrawPipeline : uint8_t {
+    Scene,
+    Decoration,
+};
+
+// One mesh draw, as plain data. Built on worker threads, replayed on the GL
+// thread, so nothing in here may touch GL.
+struct DrawCommand {
+    glm::vec4 lightColor;
+    glm::ivec2 textureLayers[2];
+    const Material* material = nullptr;
+    uint32_t vertexArray = 0;
+    uint32_t depthVertexArray = 0;
+    int32_t indexCount = 0;
+    // Instance in the frame's TransformStage
+    uint32_t transform = 0;
+    DrawPipeline pipeline = DrawPipeline::Scene;
+    bool bLight = false;
+};
+
+using DrawList = std::vector<DrawCommand>;
+
+// Which shadow casters a depth-only pass takes
+enum class ShadowCasters : uint8_t {
+    All,
+    Static,
+    Dynamic,
+};
+
+// A model to be drawn this frame and how.
+struct RenderItem {
+    const Model* model = nullptr;
+    // Instance in the frame's TransformStage
+    uint32_t transform = 0;
+    DrawPipeline pipeline = DrawPipeline::Scene;
+    bool bCastShadow = true;
+    // Moves at runtime, so it is not part of cached static shadows
+    bool bDynamic = false;
+    bool bLight = false;
+    glm::vec4 lightColor = glm::vec4(1.0f);
+};
+
+// Camera a pass is rendered from. Pass i uses view i of the TransformStage.
+struct RenderPassView {
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    glm::mat4 projectionMatrix = glm::mat4(1.0f);
+    // Shadow passes only take shadow casters
+    bool bDepthOnly = false;
+    ShadowCasters casters = ShadowCasters::All;
+    // Disabled passes get empty draw lists
+    bool bEnabled = true;
+};
+
+// Builds the draw lists of all passes of a frame in parallel. Every pool
+// chunk writes into its own list per pass, and the lists keep their capacity
+// from frame to frame.
+class RenderQueue {
+public:
+    // transformStage must already be computed for the same passes
+    void build(ThreadPool& threadPool, const TransformStage& transformStage, const std::vector<RenderItem>& items, const std::vector<RenderPassView>& passes);
+
+    // Draw lists of a pass, in item order
+    const std::vector<DrawList>& getDrawLists(size_t pass) const {
+        return drawLists[pass];
+    }
+
+    size_t getPassCount() const {
+        return passCount;
+    }
+
+    size_t getCommandCount(size_t pass) const;
+
+private:
+    // [pass][chunk]
+    std::vector<std::vector<DrawList>> drawLists;
+    size_t passCount = 0;
+};
@@ -0,0 +1,59 @@
+#include "SceneNode.hpp"
+
+#include <algorithm>
+
+SceneNode::~SceneNode() {
+    setParent(nullptr);
+
+    for (auto child : children) {
+        child->parent = nullptr;
+        child->markDirty();
+    }
+}
+
+void SceneNode::setParent(SceneNode* inParent) {
+    if (parent == inParent) {
+        return;
+    }
+
+    if (parent) {
+        auto& siblings = parent->children;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+    }
+
+    parent = inParent;
+
+    if (parent) {
+        parent->children.push_back(this);
+    }
+
+    markDirty();
+}
+
+const glm::mat4& SceneNode::getWorldTransform() const {
+    if (bDirty) {
+        if (parent) {
+            worldTransform = parent->getWorldTransform() * localTransform;
+        }
+        else {
+            worldTransform = localTransform;
+        }
+
+        worldVersion++;
+        bDirty = false;
+    }
+
+    return worldTransform;
+}
+
+void SceneNode::markDirty() {
+    if (bDirty) {
+        return;
+    }
+
+    bDirty = true;
+
+    for (auto child : children) {
+        child->markDirty();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Node of the transform hierarchy. The world transform is the parent's world
+// transform times the local one, and is only recomputed when it is read after
+// this node or one of its ancestors changed. Not thread safe: transforms are
+// updated and read on the main thread.
+class SceneNode {
+public:
+    SceneNode() {}
+
+    virtual ~SceneNode();
+
+    SceneNode(const SceneNode&) = delete;
+    SceneNode& operator=(const SceneNode&) = delete;
+
+    // Keeps the local transform, so the node moves into the parent's space
+    void setParent(SceneNode* inParent);
+
+    SceneNode* getParent() const {
+        return parent;
+    }
+
+    const std::vector<SceneNode*>& getChildren() const {
+        return children;
+    }
+
+    const glm::mat4& getLocalTransform() const {
+        return localTransform;
+    }
+
+    void setLocalTransform(const glm::mat4& inTransform) {
+        localTransform = inTransform;
+        markDirty();
+    }
+
+    const glm::mat4& getWorldTransform() const;
+
+    bool isDirty() const {
+        return bDirty;
+    }
+
+    // Changes whenever the world transform is recomputed, so a cache of
+    // anything placed by it can tell when it is stale
+    uint32_t getWorldVersion() const {
+        getWorldTransform();
+        return worldVersion;
+    }
+
+private:
+    void markDirty();
+
+    glm::mat4 localTransform = glm::mat4(1.0f);
+    mutable glm::mat4 worldTransform = glm::mat4(1.0f);
+
+    // A dirty node only ever has dirty descendants, so marking can stop at
+    // the first node that is already dirty
+    mutable bool bDirty = true;
+    mutable uint32_t worldVersion = 0;
+
+    SceneNode* parent = nullptr;
+    std::vector<SceneNode*> children;
+};
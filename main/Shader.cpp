@@ -1,36 +1,300 @@
 #include "Shader.hpp"
 
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <vector>
 
 #include "glm/glm.hpp"
 
+namespace {
+	void insertDefines(std::string& source, const std::string& defines) {
+		if (defines.empty()) {
+			return;
+		}
+
+		auto version = source.find("#version");
+		auto lineEnd = (version == std::string::npos) ? std::string::npos : source.find('\n', version);
+		auto position = (lineEnd == std::string::npos) ? 0 : lineEnd + 1;
+
+		source.insert(position, defines);
+	}
+
+	// FNV-1a
+	uint64_t hashString(const std::string& text, uint64_t hash = 14695981039346656037ull) {
+		for (unsigned char c : text) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	std::string getString(GLenum name) {
+		auto text = reinterpret_cast<const char*>(glGetString(name));
+		return text ? text : "";
+	}
+}
+
+std::string Shader::binaryCacheDirectory;
+bool Shader::bParallelCompile = false;
+
 void Shader::create() {
 	program = glCreateProgram();
 }
 
-bool Shader::compileShaderFromFile(const std::string& fileName, ShaderType type) {
-	std::ifstream file(fileName, std::ios_base::ate);
+bool Shader::build(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+	return submit(vertexPath, fragmentPath, defines) && finish();
+}
+
+bool Shader::submit(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+	std::string vertexSource;
+	std::string fragmentSource;
+
+	if (!loadSource(vertexPath, vertexSource) || !loadSource(fragmentPath, fragmentSource)) {
+		return false;
+	}
+
+	insertDefines(vertexSource, defines);
+	insertDefines(fragmentSource, defines);
+
+	create();
+
+	std::string cachePath;
+
+	if (!binaryCacheDirectory.empty()) {
+		int32_t formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+		if (formatCount > 0) {
+			// A binary is only valid for the driver that produced it
+			uint64_t hash = hashString(vertexSource);
+			hash = hashString(fragmentSource, hash);
+			hash = hashString(getString(GL_VENDOR), hash);
+			hash = hashString(getString(GL_RENDERER), hash);
+			hash = hashString(getString(GL_VERSION), hash);
+
+			char key[17];
+			std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+
+			cachePath = binaryCacheDirectory + "/" + name + "-" + key + ".bin";
+
+			if (loadBinary(cachePath)) {
+				return true;
+			}
+
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	// No status queries here, they would wait for the compiler
+	pendingStages.push_back(submitStage(vertexSource.c_str(), ShaderType::VERTEX));
+	pendingStages.push_back(submitStage(fragmentSource.c_str(), ShaderType::FRAGMENT));
+
+	glLinkProgram(program);
+
+	pendingCachePath = cachePath;
+	bPending = true;
+
+	return true;
+}
+
+bool Shader::isReady() const {
+	if (!bPending || !bParallelCompile) {
+		return true;
+	}
+
+	int32_t completed = 0;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+
+	return completed != 0;
+}
+
+bool Shader::finish() {
+	if (!bPending) {
+		return linked;
+	}
+
+	bPending = false;
+
+	bool bCompiled = true;
+
+	for (auto stage : pendingStages) {
+		bCompiled = checkStage(stage) && bCompiled;
+		// Only flagged while attached, freed with the program
+		glDeleteShader(stage);
+	}
+
+	pendingStages.clear();
+
+	if (!bCompiled || !checkLink()) {
+		return false;
+	}
+
+	if (!pendingCachePath.empty()) {
+		saveBinary(pendingCachePath);
+	}
+
+	return true;
+}
+
+void Shader::enableParallelCompile(GLADloadproc load) {
+	int32_t extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+
+	for (int32_t i = 0; i < extensionCount; i++) {
+		std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+
+		// The ARB version has the same entry point and tokens
+		if (extension == "GL_KHR_parallel_shader_compile" || extension == "GL_ARB_parallel_shader_compile") {
+			auto suffix = extension.substr(3, 3);
+			auto maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load(("glMaxShaderCompilerThreads" + suffix).c_str()));
+
+			if (maxShaderCompilerThreads) {
+				// As many threads as the driver likes
+				maxShaderCompilerThreads(0xFFFFFFFF);
+				bParallelCompile = true;
+				return;
+			}
+		}
+	}
+}
+
+bool Shader::loadBinary(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
 
 	if (!file.is_open()) {
-		std::cout << "Open shader file " + fileName << " failed." << std::endl;
 		return false;
 	}
 
-	auto length = file.tellg();
+	GLenum format = 0;
+
+	if (!file.read(reinterpret_cast<char*>(&format), sizeof(format))) {
+		return false;
+	}
+
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (binary.empty()) {
+		return false;
+	}
+
+	glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	int32_t status = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	if (status == 0) {
+		// Truncated file or a driver that no longer accepts it, start over
+		// from the sources with a fresh program
+		std::cout << "Shader binary " << path << " rejected, recompiling." << std::endl;
+		glDeleteProgram(program);
+		create();
+		return false;
+	}
+
+	linked = true;
+
+	return true;
+}
+
+void Shader::saveBinary(const std::string& path) {
+	int32_t length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0) {
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
 
-	file.seekg(0);
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << "Write shader binary " << path << " failed." << std::endl;
+		return;
+	}
+
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(binary.data(), binary.size());
+}
 
+void Shader::setBinaryCacheDirectory(const std::string& directory) {
+	binaryCacheDirectory = directory;
+
+	if (directory.empty()) {
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	if (error) {
+		std::cout << "Create shader cache " << directory << " failed, caching disabled." << std::endl;
+		binaryCacheDirectory.clear();
+	}
+}
+
+bool Shader::compileShaderFromFile(const std::string& fileName, ShaderType type, const std::string& defines) {
 	std::string shaderSource;
-	shaderSource.resize(length);
 
-	file.read(&shaderSource[0], length);
+	if (!loadSource(fileName, shaderSource)) {
+		return false;
+	}
 
-	file.close();
+	insertDefines(shaderSource, defines);
 
 	return compileShaderFromString(shaderSource.c_str(), type);
 }
 
+bool Shader::loadSource(const std::string& fileName, std::string& source, int32_t depth) {
+	if (depth > 8) {
+		std::cout << "Shader includes nested too deep in " + fileName << std::endl;
+		return false;
+	}
+
+	std::ifstream file(fileName);
+
+	if (!file.is_open()) {
+		std::cout << "Open shader file " + fileName << " failed." << std::endl;
+		return false;
+	}
+
+	auto directory = fileName.substr(0, fileName.find_last_of("/\\") + 1);
+
+	std::string line;
+
+	while (std::getline(file, line)) {
+		auto start = line.find_first_not_of(" \t");
+
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+			auto first = line.find('"', start);
+			auto last = line.find('"', first + 1);
+
+			if (first == std::string::npos || last == std::string::npos) {
+				std::cout << "Malformed include in shader file " + fileName << ": " << line << std::endl;
+				return false;
+			}
+
+			if (!loadSource(directory + line.substr(first + 1, last - first - 1), source, depth + 1)) {
+				return false;
+			}
+
+			continue;
+		}
+
+		source += line;
+		source += '\n';
+	}
+
+	return true;
+}
+
 bool Shader::compileShaderFromString(const char* source, ShaderType type) {
 	auto shader = glCreateShader(static_cast<int32_t>(type));
 
@@ -38,6 +302,28 @@ bool Shader::compileShaderFromString(const char* source, ShaderType type) {
 
 	glCompileShader(shader);
 
+	if (!checkStage(shader)) {
+		return false;
+	}
+
+	glAttachShader(program, shader);
+
+	return true;
+}
+
+uint32_t Shader::submitStage(const char* source, ShaderType type) {
+	auto shader = glCreateShader(static_cast<int32_t>(type));
+
+	glShaderSource(shader, 1, &source, nullptr);
+
+	glCompileShader(shader);
+
+	glAttachShader(program, shader);
+
+	return shader;
+}
+
+bool Shader::checkStage(uint32_t shader) {
 	int32_t result;
 
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
@@ -58,14 +344,16 @@ bool Shader::compileShaderFromString(const char* source, ShaderType type) {
 		return false;
 	}
 
-	glAttachShader(program, shader);
-
 	return true;
 }
 
 bool Shader::link() {
 	glLinkProgram(program);
 
+	return checkLink();
+}
+
+bool Shader::checkLink() {
 	auto status = 0;
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 
@@ -114,6 +402,14 @@ void Shader::setUniform(const std::string& uniformName, float x, float y, float
 	glUniform3f(getUniformLocation(uniformName), x, y, z);
 }
 
+void Shader::setUniform(const std::string& uniformName, const glm::ivec2& v) {
+	glUniform2iv(getUniformLocation(uniformName), 1, &v[0]);
+}
+
+void Shader::setUniform(const std::string& uniformName, const glm::vec2& v) {
+	glUniform2fv(getUniformLocation(uniformName), 1, &v[0]);
+}
+
 void Shader::setUniform(const std::string& uniformName, const glm::vec3& v) {
 	glUniform3fv(getUniformLocation(uniformName), 1, &v[0]);
 }
@@ -224,3 +520,31 @@ bool Shader::fileExists(const std::string& fileName) {
 
 	return file.is_open();
 }
+
+void ShaderBatch::add(const std::shared_ptr<Shader>& shader) {
+	shaders.push_back(shader);
+}
+
+bool ShaderBatch::isReady() const {
+	for (const auto& shader : shaders) {
+		if (!shader->isReady()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ShaderBatch::finish() {
+	bool bSucceeded = true;
+
+	// In submission order, the later programs keep compiling on the
+	// driver's threads while an earlier one is waited for
+	for (const auto& shader : shaders) {
+		bSucceeded = shader->finish() && bSucceeded;
+	}
+
+	shaders.clear();
+
+	return bSucceeded;
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <glad.h>
 
@@ -13,10 +15,16 @@
 
 #include "glm/glm.hpp"
 
+// GL_KHR_parallel_shader_compile, not in the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 enum class ShaderType : int32_t {
 	VERTEX = GL_VERTEX_SHADER,
 	FRAGMENT = GL_FRAGMENT_SHADER,
 	GEOMETRY = GL_GEOMETRY_SHADER,
+	COMPUTE = GL_COMPUTE_SHADER,
 };
 
 class Shader
@@ -28,7 +36,21 @@ public:
 
 	void create();
 
-	bool compileShaderFromFile(const std::string& fileName, ShaderType type);
+	// Loads, compiles and links a vertex/fragment program. With a binary
+	// cache directory set, the linked program is saved there and later runs
+	// load it instead while the sources, renderer and driver stay the same.
+	bool build(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+
+	// build() in two halves. submit() queues both stages and the link
+	// without reading any status back, so the driver can work on many
+	// programs while the caller does something else; finish() reports
+	// errors and saves the binary. isReady() never blocks.
+	bool submit(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+	bool isReady() const;
+	bool finish();
+
+	// defines are inserted right after the #version line
+	bool compileShaderFromFile(const std::string& fileName, ShaderType type, const std::string& defines = "");
 	bool compileShaderFromString(const char* source, ShaderType type);
 
 	bool link();
@@ -42,6 +64,8 @@ public:
 	void bindAttribLocation(uint32_t location, const std::string& name);
 	void bindFragDataLocation(uint32_t location, const std::string& name);
 	void setUniform(const std::string& name, float x, float y, float z);
+	void setUniform(const std::string& name, const glm::ivec2& v);
+	void setUniform(const std::string& name, const glm::vec2& v);
 	void setUniform(const std::string& name, const glm::vec3& v);
 	void setUniform(const std::string& name, const glm::vec4& v);
 	void setUniform(const std::string& name, const glm::mat3& v);
@@ -56,8 +80,32 @@ public:
 	void printActiveAttributes();
 	void printActiveUniforms();
 
+	// Reads a shader file and splices in #include "file" lines, relative to
+	// the including file, so stages can share lighting code
+	static bool loadSource(const std::string& fileName, std::string& source, int32_t depth = 0);
+
+	// Created if missing, empty disables the cache
+	static void setBinaryCacheDirectory(const std::string& directory);
+
+	// Lets the driver compile on its own threads when it supports
+	// GL_KHR_parallel_shader_compile, call once after loading GL
+	static void enableParallelCompile(GLADloadproc load);
+
+	static bool isParallelCompileEnabled() {
+		return bParallelCompile;
+	}
+
 private:
 
+	using MaxShaderCompilerThreadsProc = void (APIENTRYP)(GLuint count);
+
+	uint32_t submitStage(const char* source, ShaderType type);
+	bool checkStage(uint32_t shader);
+	bool checkLink();
+
+	bool loadBinary(const std::string& path);
+	void saveBinary(const std::string& path);
+
 	int32_t getUniformLocation(const std::string& name);
 	bool fileExists(const std::string& fileName);
 
@@ -67,5 +115,28 @@ private:
 	bool linked = false;
 	//std::string log = "";
 	std::string name;
+
+	// Set between submit() and finish()
+	std::vector<uint32_t> pendingStages;
+	std::string pendingCachePath;
+	bool bPending = false;
+
+	static std::string binaryCacheDirectory;
+	static bool bParallelCompile;
+};
+
+// Programs submitted together and finished together, see Shader::submit()
+class ShaderBatch
+{
+public:
+	void add(const std::shared_ptr<Shader>& shader);
+
+	bool isReady() const;
+
+	// Waits for every program, false if any of them failed
+	bool finish();
+
+private:
+	std::vector<std::shared_ptr<Shader>> shaders;
 };
 
@@ -0,0 +1,103 @@
+#include "ShaderVariants.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    void collectFeatures(const std::string& fileName, std::vector<std::string>& features) {
+        std::string source;
+
+        if (!Shader::loadSource(fileName, source)) {
+            return;
+        }
+
+        std::istringstream stream(source);
+        std::string line;
+
+        while (std::getline(stream, line)) {
+            std::istringstream words(line);
+            std::string directive, pragma, feature;
+
+            words >> directive >> pragma >> feature;
+
+            if (directive == "#pragma" && pragma == "feature" && !feature.empty()) {
+                if (std::find(features.begin(), features.end(), feature) == features.end()) {
+                    features.push_back(feature);
+                }
+            }
+        }
+    }
+}
+
+ShaderVariants::ShaderVariants(const std::string& inName, const std::string& inVertexPath, const std::string& inFragmentPath)
+    : name(inName), vertexPath(inVertexPath), fragmentPath(inFragmentPath) {
+    collectFeatures(vertexPath, features);
+    collectFeatures(fragmentPath, features);
+
+    if (features.size() > MaxFeatures) {
+        std::cout << "Shader " << name << " declares more than " << MaxFeatures << " features, ignoring the rest." << std::endl;
+        features.resize(MaxFeatures);
+    }
+
+    for (size_t i = 0; i < features.size(); i++) {
+        featureMask |= 1u << i;
+    }
+}
+
+uint32_t ShaderVariants::getFeatureBit(const std::string& feature) const {
+    auto found = std::find(features.begin(), features.end(), feature);
+
+    if (found == features.end()) {
+        return 0;
+    }
+
+    return 1u << static_cast<uint32_t>(found - features.begin());
+}
+
+const std::shared_ptr<Shader>& ShaderVariants::get(uint32_t inFeatures, ShaderBatch* batch) {
+    uint32_t key = inFeatures & featureMask;
+
+    auto found = variants.find(key);
+
+    if (found != variants.end()) {
+        auto& variant = found->second;
+
+        if (!variant.bReady && !batch) {
+            variant.shader->finish();
+            variant.bReady = true;
+
+            if (onCreate) {
+                onCreate(*variant.shader);
+            }
+        }
+
+        return variant.shader;
+    }
+
+    std::string defines;
+
+    for (size_t i = 0; i < features.size(); i++) {
+        if (key & (1u << i)) {
+            defines += "#define " + features[i] + "\n";
+        }
+    }
+
+    Variant variant;
+    variant.shader = std::make_shared<Shader>(name);
+    variant.shader->submit(vertexPath, fragmentPath, defines);
+
+    if (batch) {
+        batch->add(variant.shader);
+    }
+    else {
+        variant.shader->finish();
+        variant.bReady = true;
+
+        if (onCreate) {
+            onCreate(*variant.shader);
+        }
+    }
+
+    return variants.emplace(key, std::move(variant)).first->second.shader;
+}
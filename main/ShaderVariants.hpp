@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.hpp"
+
+// Compile-time permutations of one vertex/fragment program. Sources declare
+// their optional features with
+//
+//     #pragma feature NORMAL_MAP
+//
+// (GLSL ignores unknown pragmas) and guard the code with #ifdef. A variant
+// is a bitmask of features; it is compiled with a #define per set bit the
+// first time it is asked for and cached from then on.
+class ShaderVariants {
+public:
+    static constexpr uint32_t MaxFeatures = 32;
+
+    ShaderVariants(const std::string& inName, const std::string& inVertexPath, const std::string& inFragmentPath);
+
+    // Bit of a declared feature, 0 if neither stage declares it
+    uint32_t getFeatureBit(const std::string& feature) const;
+
+    // Compiles the variant on first use, bits of undeclared features are
+    // ignored. With a batch the new variant is only submitted and added to
+    // it; it is finished, and onCreate called, by the first get() without.
+    const std::shared_ptr<Shader>& get(uint32_t features, ShaderBatch* batch = nullptr);
+
+    size_t getVariantCount() const {
+        return variants.size();
+    }
+
+    const std::vector<std::string>& getFeatures() const {
+        return features;
+    }
+
+public:
+    // Called once per new variant after it has linked, e.g. to bind sampler
+    // units
+    std::function<void(Shader&)> onCreate;
+
+private:
+    std::string name;
+    std::string vertexPath;
+    std::string fragmentPath;
+
+    std::vector<std::string> features;
+    uint32_t featureMask = 0;
+
+    struct Variant {
+        std::shared_ptr<Shader> shader;
+        // Finished and passed to onCreate
+        bool bReady = false;
+    };
+
+    std::unordered_map<uint32_t, Variant> variants;
+};
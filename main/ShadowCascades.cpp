@@ -0,0 +1,79 @@
+#include "ShadowCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+void ShadowCascades::update(const glm::vec3& lightDirection, const glm::mat4& cameraViewMatrix, float fov, float aspect, float nearPlane, float shadowDistance) {
+    auto direction = glm::normalize(lightDirection);
+    auto up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+    // Rotation only, so snapping in light space stays stable
+    auto lightViewMatrix = glm::lookAt(glm::vec3(0.0f), direction, up);
+    auto inverseCameraView = glm::inverse(cameraViewMatrix);
+
+    float tanHalfHeight = std::tan(glm::radians(fov) * 0.5f);
+    float tanHalfWidth = tanHalfHeight * aspect;
+
+    float farPlane = std::max(shadowDistance, nearPlane + 0.01f);
+    float splitNear = nearPlane;
+
+    for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+        float t = static_cast<float>(i + 1) / ShadowCascadeCount;
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+        float splitFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+
+        // Corners of the slice in view space
+        glm::vec3 corners[8];
+
+        for (int32_t j = 0; j < 8; j++) {
+            float distance = (j < 4) ? splitNear : splitFar;
+            float x = ((j & 1) ? 1.0f : -1.0f) * tanHalfWidth * distance;
+            float y = ((j & 2) ? 1.0f : -1.0f) * tanHalfHeight * distance;
+
+            corners[j] = glm::vec3(x, y, -distance);
+        }
+
+        glm::vec3 center = glm::vec3(0.0f);
+
+        for (const auto& corner : corners) {
+            center += corner;
+        }
+
+        center /= 8.0f;
+
+        float radius = 0.0f;
+
+        for (const auto& corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+
+        // Round up so that float noise doesn't change the texel size
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 lightCenter = glm::vec3(lightViewMatrix * inverseCameraView * glm::vec4(center, 1.0f));
+
+        // The center moves in steps of snapTexels texels, on all three light
+        // space axes, and the bounds grow by a step to still hold the slice
+        // between steps. The matrix then only changes once the camera has
+        // moved a step, and the static caster cache stays valid until then.
+        float snapTexels = std::floor(static_cast<float>(resolution) * snapFraction);
+        float step = 2.0f * radius * snapTexels / (static_cast<float>(resolution) - snapTexels);
+        float halfExtent = radius + step * 0.5f;
+
+        glm::vec3 snappedCenter = glm::floor(lightCenter / step) * step + step * 0.5f;
+
+        auto& cascade = cascades[i];
+
+        cascade.viewMatrix = lightViewMatrix;
+        cascade.projectionMatrix = glm::ortho(snappedCenter.x - halfExtent, snappedCenter.x + halfExtent,
+                                              snappedCenter.y - halfExtent, snappedCenter.y + halfExtent,
+                                              -(snappedCenter.z + halfExtent) - casterDistance, -(snappedCenter.z - halfExtent));
+        cascade.lightSpaceMatrix = cascade.projectionMatrix * cascade.viewMatrix;
+        cascade.splitDistance = splitFar;
+
+        splitNear = splitFar;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+constexpr int32_t ShadowCascadeCount = 4;
+
+struct ShadowCascade {
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    glm::mat4 projectionMatrix = glm::mat4(1.0f);
+    glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
+    // View space distance where this cascade ends
+    float splitDistance = 0.0f;
+};
+
+// Cascaded shadow maps for a directional light. Every cascade covers one
+// slice of the camera frustum with an orthographic projection around the
+// slice's bounding sphere. Sphere bounds don't change size when the camera
+// turns, and the center, depth range included, is snapped to steps of whole
+// shadow map texels so that edges don't shimmer and the matrices stay the
+// same for as long as the camera moves within a step.
+class ShadowCascades {
+public:
+    explicit ShadowCascades(int32_t inResolution = 1024) : resolution(inResolution) {}
+
+    void update(const glm::vec3& lightDirection, const glm::mat4& cameraViewMatrix, float fov, float aspect, float nearPlane, float shadowDistance);
+
+    const ShadowCascade& getCascade(int32_t index) const {
+        return cascades[index];
+    }
+
+    int32_t getResolution() const {
+        return resolution;
+    }
+
+public:
+    // Blend between uniform (0) and logarithmic (1) split distances
+    float splitLambda = 0.75f;
+    // Extra depth towards the light, so casters outside the slice still
+    // land in the map
+    float casterDistance = 50.0f;
+    // Size of a snapping step as a fraction of the map. Larger steps change
+    // the matrices less often, for a little less resolution.
+    float snapFraction = 0.125f;
+
+private:
+    ShadowCascade cascades[ShadowCascadeCount];
+    int32_t resolution = 1024;
+};
@@ -0,0 +1,114 @@
+#include "ShadowFilter.hpp"
+
+#include <iostream>
+
+#include <glad.h>
+
+#include "Texture.hpp"
+
+namespace {
+    uint32_t createMomentsArray(int32_t unit, int32_t resolution, int32_t layers) {
+        uint32_t texture = 0;
+
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, resolution, resolution, layers, 0, GL_RG, GL_FLOAT, nullptr);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        return texture;
+    }
+}
+
+ShadowFilter::~ShadowFilter() {
+    glDeleteSamplers(1, &compareSampler);
+    glDeleteTextures(1, &momentsTexture);
+    glDeleteTextures(1, &blurTexture);
+    glDeleteFramebuffers(1, &fbo);
+}
+
+void ShadowFilter::create(uint32_t depthTexture, int32_t inResolution, int32_t inLayers, int32_t inDownsample) {
+    layers = inLayers;
+    downsample = inDownsample;
+    momentsResolution = inResolution / downsample;
+
+    // Same texture on a second unit, compare state comes from the sampler
+    compareUnit = Texture::allocateTextureUnit();
+
+    glActiveTexture(GL_TEXTURE0 + compareUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+
+    glGenSamplers(1, &compareSampler);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glSamplerParameterfv(compareSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+    glBindSampler(compareUnit, compareSampler);
+
+    momentsUnit = Texture::allocateTextureUnit();
+    blurUnit = Texture::allocateTextureUnit();
+
+    momentsTexture = createMomentsArray(momentsUnit, momentsResolution, layers);
+    blurTexture = createMomentsArray(blurUnit, momentsResolution, layers);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentsTexture, 0, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Shadow moments frame buffer is not complete." << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowFilter::prefilter(Shader& shader, int32_t depthUnit, ShadowFilterMode mode) {
+    if (!isPrefiltered(mode)) {
+        return;
+    }
+
+    shader.use();
+    shader.setUniform("filterMode", static_cast<int32_t>(mode));
+    shader.setUniform("exponent", exponent);
+    shader.setUniform("downsample", downsample);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, momentsResolution, momentsResolution);
+
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    for (int32_t layer = 0; layer < layers; layer++) {
+        shader.setUniform("layer", layer);
+
+        // Depth to moments, downsampled and blurred horizontally
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, blurTexture, 0, layer);
+        shader.setUniform("source", depthUnit);
+        shader.setUniform("bFromDepth", true);
+        shader.setUniform("direction", glm::ivec2(1, 0));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // Vertical blur into the final moments
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentsTexture, 0, layer);
+        shader.setUniform("source", blurUnit);
+        shader.setUniform("bFromDepth", false);
+        shader.setUniform("direction", glm::ivec2(0, 1));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Shader.hpp"
+
+// lighting.glsl takes the mode as a variant feature, see getPassFeatures() in
+// main.cpp. Variance's value matches ShadowFilterVariance in
+// shadowmoments.frag, which gets the mode as its filterMode uniform.
+enum class ShadowFilterMode : int32_t {
+    // 3x3 manual depth compares
+    PCF,
+    // 2x2 bilinear hardware compares through a sampler2DArrayShadow
+    Hardware,
+    // Prefiltered (d, d^2) moments, Chebyshev bound
+    Variance,
+    // Prefiltered exp(c * d)
+    Exponential,
+    Count
+};
+
+// Shadow map filtering. The hardware mode samples the cascade depth array
+// through a comparison sampler object on its own texture unit, so the plain
+// sampler used by PCF keeps working. The prefiltered modes downsample the
+// cascades into a moments array once per frame and blur it separably, so the
+// lighting shader needs a single bilinear fetch.
+class ShadowFilter {
+public:
+    ShadowFilter() {}
+
+    ~ShadowFilter();
+
+    ShadowFilter(const ShadowFilter&) = delete;
+    ShadowFilter& operator=(const ShadowFilter&) = delete;
+
+    // depthTexture is the cascade depth array, downsample divides its size
+    // for the moments
+    void create(uint32_t depthTexture, int32_t inResolution, int32_t inLayers, int32_t inDownsample = 2);
+
+    // Rebuilds the moments from the depth array for the prefiltered modes,
+    // nothing to do for the others. Draws fullscreen triangles from
+    // gl_VertexID with the caller's empty vertex array bound, and leaves the
+    // default framebuffer bound.
+    void prefilter(Shader& shader, int32_t depthUnit, ShadowFilterMode mode);
+
+    int32_t getCompareUnit() const {
+        return compareUnit;
+    }
+
+    int32_t getMomentsUnit() const {
+        return momentsUnit;
+    }
+
+    static bool isPrefiltered(ShadowFilterMode mode) {
+        return mode == ShadowFilterMode::Variance || mode == ShadowFilterMode::Exponential;
+    }
+
+public:
+    // ESM sharpness, exp(exponent) must stay well inside float range
+    float exponent = 60.0f;
+    // VSM light bleeding reduction, fraction of the tail cut off
+    float lightBleedingReduction = 0.2f;
+
+private:
+    uint32_t compareSampler = 0;
+    int32_t compareUnit = -1;
+
+    // Blur ping-pongs between the two, the result ends up in momentsTexture
+    uint32_t momentsTexture = 0;
+    uint32_t blurTexture = 0;
+    int32_t momentsUnit = -1;
+    int32_t blurUnit = -1;
+    uint32_t fbo = 0;
+
+    int32_t layers = 0;
+    int32_t momentsResolution = 0;
+    int32_t downsample = 2;
+};
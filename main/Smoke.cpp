@@ -0,0 +1,106 @@
+#include "Smoke.hpp"
+
+#include <algorithm>
+
+#include <glad.h>
+
+SmokeEmitter::SmokeEmitter(const glm::vec3& inSpawnPosition, size_t puffCount, float spacing, float inTopHeight)
+    : spawnPosition(inSpawnPosition), topHeight(inTopHeight), puffs(puffCount) {
+    // The first puff is the highest one
+    for (size_t i = 0; i < puffCount; i++) {
+        puffs[i].position = spawnPosition + glm::vec3(0.0f, spacing * (puffCount - 1 - i), 0.0f);
+    }
+
+    updateBounds();
+}
+
+void SmokeEmitter::update(float deltaTime) {
+    for (size_t i = 0; i < puffs.size(); i++) {
+        auto& puff = puffs[i];
+
+        // Three growth rates, so neighbouring puffs don't swell in lockstep
+        puff.position.y += riseSpeed * deltaTime;
+        puff.scale += deltaTime / static_cast<float>(i % 3 + 1);
+        puff.age += deltaTime;
+
+        if (puff.position.y >= topHeight) {
+            puff.position = spawnPosition;
+            puff.scale = 1.0f;
+            puff.age = 0.0f;
+        }
+    }
+
+    updateBounds();
+}
+
+void SmokeEmitter::updateBounds() {
+    boundsMinimum = spawnPosition;
+    boundsMaximum = spawnPosition;
+    maxScale = 1.0f;
+
+    for (const auto& puff : puffs) {
+        boundsMinimum = glm::min(boundsMinimum, puff.position);
+        boundsMaximum = glm::max(boundsMaximum, puff.position);
+        maxScale = std::max(maxScale, puff.scale);
+    }
+}
+
+SmokeSystem::~SmokeSystem() {
+    glDeleteBuffers(1, &instanceBuffer);
+}
+
+void SmokeSystem::addEmitter(const glm::vec3& spawnPosition, size_t puffCount, float spacing, float topHeight) {
+    emitters.emplace_back(spawnPosition, puffCount, spacing, topHeight);
+}
+
+void SmokeSystem::update(float deltaTime) {
+    for (auto& emitter : emitters) {
+        emitter.update(deltaTime);
+    }
+}
+
+void SmokeSystem::upload() {
+    instances.clear();
+    instanceOffsets.clear();
+
+    for (const auto& emitter : emitters) {
+        instanceOffsets.push_back(static_cast<int32_t>(instances.size()));
+
+        for (const auto& puff : emitter.getPuffs()) {
+            instances.push_back(glm::vec4(puff.position, puff.scale));
+        }
+    }
+
+    if (instanceBuffer == 0) {
+        glGenBuffers(1, &instanceBuffer);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+
+    // Never empty, so the binding is always valid
+    size_t byteSize = sizeof(glm::vec4) * std::max<size_t>(instances.size(), 1);
+
+    glBufferData(GL_SHADER_STORAGE_BUFFER, byteSize, nullptr, GL_STREAM_DRAW);
+
+    if (!instances.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::vec4) * instances.size(), instances.data());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, InstanceBinding, instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void SmokeSystem::draw(Shader& shader, const Frustum& frustum, int32_t indexCount, float puffRadius) const {
+    for (size_t i = 0; i < emitters.size(); i++) {
+        const auto& emitter = emitters[i];
+        glm::vec4 boundingSphere = emitter.getBoundingSphere(puffRadius);
+
+        if (emitter.getPuffs().empty() || !frustum.intersectsSphere(glm::vec3(boundingSphere), boundingSphere.w)) {
+            continue;
+        }
+
+        shader.setUniform("instanceOffset", instanceOffsets[i]);
+
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(emitter.getPuffs().size()));
+    }
+}
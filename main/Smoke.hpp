@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Frustum.hpp"
+#include "Shader.hpp"
+
+struct SmokePuff {
+    glm::vec3 position;
+    // Of the shared puff mesh
+    float scale = 1.0f;
+    // Seconds since it left the chimney
+    float age = 0.0f;
+};
+
+// Puffs rising from one chimney. A fixed pool of puffs, stacked at spawn
+// time, each one going back to the chimney once it reaches topHeight.
+class SmokeEmitter {
+public:
+    SmokeEmitter(const glm::vec3& inSpawnPosition, size_t puffCount, float spacing, float inTopHeight);
+
+    void update(float deltaTime);
+
+    const std::vector<SmokePuff>& getPuffs() const {
+        return puffs;
+    }
+
+    // World space, for a puff mesh of the given radius
+    glm::vec4 getBoundingSphere(float puffRadius) const {
+        glm::vec3 center = (boundsMinimum + boundsMaximum) * 0.5f;
+        return glm::vec4(center, glm::length(boundsMaximum - center) + maxScale * puffRadius);
+    }
+
+public:
+    float riseSpeed = 1.0f;
+
+private:
+    void updateBounds();
+
+    glm::vec3 spawnPosition;
+    float topHeight;
+
+    std::vector<SmokePuff> puffs;
+
+    // Of the puff centers, kept by update() so culling is O(1) per emitter
+    glm::vec3 boundsMinimum;
+    glm::vec3 boundsMaximum;
+    float maxScale = 1.0f;
+};
+
+// All chimneys of the scene. Puff states are updated on the CPU and
+// uploaded once per frame as one vec4 (position, scale) per puff; every
+// pass then draws each emitter with one instanced draw of a shared puff
+// mesh, see the INSTANCED feature of scene.vert and depth.vert.
+class SmokeSystem {
+public:
+    // Shader storage binding of the instance array
+    static constexpr uint32_t InstanceBinding = 8;
+
+    SmokeSystem() {}
+
+    ~SmokeSystem();
+
+    SmokeSystem(const SmokeSystem&) = delete;
+    SmokeSystem& operator=(const SmokeSystem&) = delete;
+
+    void addEmitter(const glm::vec3& spawnPosition, size_t puffCount, float spacing = 0.5f, float topHeight = 7.0f);
+
+    void update(float deltaTime);
+
+    // Fills and binds the instance buffer, on the GL thread
+    void upload();
+
+    // One glDrawElementsInstanced per emitter inside the frustum. The caller
+    // binds the puff vertex array and an INSTANCED program.
+    void draw(Shader& shader, const Frustum& frustum, int32_t indexCount, float puffRadius) const;
+
+    size_t getEmitterCount() const {
+        return emitters.size();
+    }
+
+private:
+    std::vector<SmokeEmitter> emitters;
+
+    std::vector<glm::vec4> instances;
+    // First instance of each emitter
+    std::vector<int32_t> instanceOffsets;
+    uint32_t instanceBuffer = 0;
+};
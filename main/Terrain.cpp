@@ -0,0 +1,519 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glad.h>
+
+#include "Frustum.hpp"
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+TerrainQuadtree::~TerrainQuadtree() {
+    waitForTiles();
+}
+
+void TerrainQuadtree::create(ThreadPool& pool) {
+    // The queued tiles write into the tiles about to be replaced
+    waitForTiles();
+    finishedLayers.clear();
+
+    levelCount = 1;
+
+    while (getNodeSize(levelCount - 1) < worldSize) {
+        levelCount++;
+    }
+
+    // Rounded up to a whole quadtree
+    worldSize = getNodeSize(levelCount - 1);
+
+    float extent = std::abs(noise.amplitude);
+    minHeight = baseHeight + noise.offset - extent;
+    maxHeight = baseHeight + noise.offset + extent;
+
+    tiles.assign(tileCapacity, Tile());
+    layers.clear();
+    freeLayers.clear();
+    generatedLayers.clear();
+    drawNodes.clear();
+    requests.clear();
+    frame = 0;
+
+    // Handed out from layer 0 up
+    for (int32_t layer = tileCapacity - 1; layer >= 0; layer--) {
+        freeLayers.push_back(layer);
+    }
+
+    std::vector<TerrainNode> residentNodes;
+
+    for (int32_t level = levelCount - 1; level >= std::max(0, levelCount - residentLevels); level--) {
+        int32_t count = 1 << (levelCount - 1 - level);
+
+        for (int32_t z = 0; z < count; z++) {
+            for (int32_t x = 0; x < count; x++) {
+                residentNodes.push_back({ level, x, z });
+            }
+        }
+    }
+
+    if (residentNodes.size() >= tiles.size()) {
+        std::cout << "Terrain tile capacity " << tileCapacity << " doesn't hold the " << residentNodes.size() << " resident tiles." << std::endl;
+        residentNodes.resize(1);
+    }
+
+    std::vector<int32_t> newLayers = allocateTiles(residentNodes, true);
+
+    pool.parallelFor(newLayers.size(), 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            generateTile(tiles[newLayers[i]]);
+        }
+    });
+
+    for (auto layer : newLayers) {
+        addGenerated(layer);
+    }
+}
+
+void TerrainQuadtree::update(ThreadPool& pool, const glm::vec3& eye) {
+    frame++;
+
+    std::vector<int32_t> finished;
+    size_t queuedCount = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(generationMutex);
+        finished.swap(finishedLayers);
+        queuedCount = queuedTileCount;
+    }
+
+    for (auto layer : finished) {
+        addGenerated(layer);
+    }
+
+    drawNodes.clear();
+    requests.clear();
+
+    TerrainNode root = { levelCount - 1, 0, 0 };
+
+    // Beyond the range of the whole tree the root is drawn anyway
+    if (!selectNode(root, eye)) {
+        addDrawNode(root);
+    }
+
+    // Only left when not even the root has a tile
+    drawNodes.erase(std::remove_if(drawNodes.begin(), drawNodes.end(), [](const TerrainDrawNode& node) { return node.layer < 0; }), drawNodes.end());
+
+    // Coarse tiles first, they stand in for the most area while the finer
+    // ones are missing, then the nearest
+    auto distance = [this, &eye](const TerrainNode& node) {
+        glm::vec2 nodeCenter = getOrigin(node) + getNodeSize(node.level) * 0.5f;
+        return glm::distance(glm::vec2(eye.x, eye.z), nodeCenter);
+    };
+
+    std::sort(requests.begin(), requests.end(), [&distance](const TerrainNode& a, const TerrainNode& b) {
+        if (a.level != b.level) {
+            return a.level > b.level;
+        }
+
+        float distanceA = distance(a);
+        float distanceB = distance(b);
+
+        // By key at equal distances, so the quadrants of a node asking for
+        // its tile end up next to each other
+        return distanceA != distanceB ? distanceA < distanceB : a.getKey() < b.getKey();
+    });
+
+    requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+    size_t slots = static_cast<size_t>(std::max(tilesPerFrame, 0));
+    size_t count = std::min(requests.size(), slots - std::min(slots, queuedCount));
+
+    std::vector<int32_t> newLayers = allocateTiles(std::vector<TerrainNode>(requests.begin(), requests.begin() + count), false);
+
+    if (newLayers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(generationMutex);
+        queuedTileCount += newLayers.size();
+    }
+
+    // Tiles aren't moved or recycled while not ready, so the job can hold
+    // on to its own
+    for (auto layer : newLayers) {
+        pool.submit([this, layer]() {
+            generateTile(tiles[layer]);
+
+            std::lock_guard<std::mutex> lock(generationMutex);
+            finishedLayers.push_back(layer);
+            queuedTileCount--;
+            generationDone.notify_all();
+        });
+    }
+}
+
+void TerrainQuadtree::waitForTiles() {
+    std::unique_lock<std::mutex> lock(generationMutex);
+    generationDone.wait(lock, [this]() { return queuedTileCount == 0; });
+}
+
+size_t TerrainQuadtree::getPendingTileCount() const {
+    std::lock_guard<std::mutex> lock(generationMutex);
+    return requests.size() + queuedTileCount;
+}
+
+void TerrainQuadtree::releaseGenerated() {
+    for (auto layer : generatedLayers) {
+        tiles[layer].heights.clear();
+        tiles[layer].heights.shrink_to_fit();
+    }
+
+    generatedLayers.clear();
+}
+
+glm::vec2 TerrainQuadtree::getOrigin(const TerrainNode& node) const {
+    float size = getNodeSize(node.level);
+    return center - worldSize * 0.5f + glm::vec2(static_cast<float>(node.x), static_cast<float>(node.z)) * size;
+}
+
+bool TerrainQuadtree::intersectsRange(const TerrainNode& node, const glm::vec3& eye, float range) const {
+    glm::vec2 origin = getOrigin(node);
+    float size = getNodeSize(node.level);
+
+    glm::vec3 minimum = glm::vec3(origin.x, minHeight, origin.y);
+    glm::vec3 maximum = glm::vec3(origin.x + size, maxHeight, origin.y + size);
+    glm::vec3 offset = eye - glm::clamp(eye, minimum, maximum);
+
+    return glm::dot(offset, offset) <= range * range;
+}
+
+bool TerrainQuadtree::selectNode(const TerrainNode& node, const glm::vec3& eye) {
+    if (!intersectsRange(node, eye, getRange(node.level))) {
+        return false;
+    }
+
+    if (node.level == 0 || !intersectsRange(node, eye, getRange(node.level - 1))) {
+        addDrawNode(node);
+        return true;
+    }
+
+    size_t first = drawNodes.size();
+
+    for (int32_t i = 0; i < 4; i++) {
+        TerrainNode child = { node.level - 1, node.x * 2 + (i & 1), node.z * 2 + (i >> 1) };
+
+        // Out of the finer range this node draws the child's quarter, and
+        // morphs it along with its other quarters
+        if (!selectNode(child, eye)) {
+            addDrawNode(node, i);
+        }
+    }
+
+    bool bMissing = std::any_of(drawNodes.begin() + first, drawNodes.end(), [](const TerrainDrawNode& drawNode) { return drawNode.layer < 0; });
+
+    if (bMissing && hasTile(node)) {
+        drawNodes.resize(first);
+        addDrawNode(node);
+    }
+
+    return true;
+}
+
+bool TerrainQuadtree::addDrawNode(const TerrainNode& node, int32_t quadrant) {
+    TerrainDrawNode drawNode;
+    drawNode.node = node;
+    drawNode.quadrant = quadrant;
+    drawNode.origin = getOrigin(node);
+    drawNode.size = getNodeSize(node.level);
+
+    float previousRange = node.level > 0 ? getRange(node.level - 1) : 0.0f;
+    drawNode.morphEnd = getRange(node.level);
+    drawNode.morphStart = previousRange + (drawNode.morphEnd - previousRange) * morphStartRatio;
+
+    auto found = layers.find(node.getKey());
+
+    if (found != layers.end() && tiles[found->second].bReady) {
+        drawNode.layer = found->second;
+        tiles[found->second].lastUsedFrame = frame;
+    }
+    else {
+        drawNode.layer = -1;
+
+        if (found == layers.end()) {
+            requests.push_back(node);
+        }
+    }
+
+    drawNodes.push_back(drawNode);
+
+    return drawNode.layer >= 0;
+}
+
+bool TerrainQuadtree::hasTile(const TerrainNode& node) const {
+    auto found = layers.find(node.getKey());
+    return found != layers.end() && tiles[found->second].bReady;
+}
+
+int32_t TerrainQuadtree::allocateLayer() {
+    if (!freeLayers.empty()) {
+        int32_t layer = freeLayers.back();
+        freeLayers.pop_back();
+        return layer;
+    }
+
+    // The least recently used tile that isn't drawn this frame, nor being
+    // generated
+    int32_t oldest = -1;
+
+    for (int32_t layer = 0; layer < static_cast<int32_t>(tiles.size()); layer++) {
+        const auto& tile = tiles[layer];
+
+        if (tile.bResident || !tile.bReady || tile.lastUsedFrame >= frame) {
+            continue;
+        }
+
+        if (oldest < 0 || tile.lastUsedFrame < tiles[oldest].lastUsedFrame) {
+            oldest = layer;
+        }
+    }
+
+    if (oldest >= 0) {
+        layers.erase(tiles[oldest].node.getKey());
+    }
+
+    return oldest;
+}
+
+std::vector<int32_t> TerrainQuadtree::allocateTiles(const std::vector<TerrainNode>& nodes, bool bResident) {
+    std::vector<int32_t> newLayers;
+
+    for (const auto& node : nodes) {
+        int32_t layer = allocateLayer();
+
+        // Everything is in use this frame, the rest waits
+        if (layer < 0) {
+            break;
+        }
+
+        auto& tile = tiles[layer];
+        tile.node = node;
+        tile.lastUsedFrame = frame;
+        tile.bResident = bResident;
+        tile.bReady = false;
+
+        layers[node.getKey()] = layer;
+        newLayers.push_back(layer);
+    }
+
+    return newLayers;
+}
+
+void TerrainQuadtree::generateTile(Tile& tile) const {
+    int32_t samples = getTileSamples();
+
+    // Powers of two throughout, so the samples a node shares with its
+    // neighbours and its parent are at the same coordinates to the bit and
+    // get the same heights
+    float spacing = getNodeSize(tile.node.level) / static_cast<float>(gridResolution);
+    glm::vec2 origin = getOrigin(tile.node) - spacing;
+
+    tile.heights.resize(static_cast<size_t>(samples) * samples);
+    noise.generateRows(tile.heights.data(), samples, 0, samples, origin, glm::vec2(spacing));
+
+    for (auto& height : tile.heights) {
+        height += baseHeight;
+    }
+}
+
+void TerrainQuadtree::addGenerated(int32_t layer) {
+    auto& tile = tiles[layer];
+    tile.bReady = true;
+
+    // Not recycled before the upload that follows this update
+    tile.lastUsedFrame = frame;
+
+    generatedLayers.push_back(layer);
+}
+
+TerrainSystem::~TerrainSystem() {
+    // Never created, e.g. in the bench without a GL context
+    if (vertexArray == 0) {
+        return;
+    }
+
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteTextures(1, &heightTexture);
+}
+
+void TerrainSystem::create(ThreadPool& pool) {
+    quadtree.create(pool);
+
+    // Grid coordinates, the vertex shader scales them to the node
+    int32_t resolution = quadtree.gridResolution;
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    for (int32_t z = 0; z <= resolution; z++) {
+        for (int32_t x = 0; x <= resolution; x++) {
+            vertices.push_back(glm::vec3(static_cast<float>(x), 0.0f, static_cast<float>(z)));
+        }
+    }
+
+    // Counter-clockwise seen from above, a quadrant after the other so the
+    // first one alone draws a quarter node
+    int32_t half = resolution / 2;
+
+    for (int32_t quadrant = 0; quadrant < 4; quadrant++) {
+        int32_t startX = (quadrant & 1) * half;
+        int32_t startZ = (quadrant >> 1) * half;
+
+        for (int32_t z = startZ; z < startZ + half; z++) {
+            for (int32_t x = startX; x < startX + half; x++) {
+                uint32_t corner = static_cast<uint32_t>(z * (resolution + 1) + x);
+                uint32_t below = corner + static_cast<uint32_t>(resolution + 1);
+
+                indices.insert(indices.end(), { corner, below, corner + 1, corner + 1, below, below + 1 });
+            }
+        }
+    }
+
+    indexCount = static_cast<int32_t>(indices.size());
+
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+
+    glBindVertexArray(0);
+
+    int32_t samples = quadtree.getTileSamples();
+
+    heightUnit = Texture::allocateTextureUnit();
+
+    glGenTextures(1, &heightTexture);
+    glActiveTexture(GL_TEXTURE0 + heightUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, samples, samples, quadtree.tileCapacity, 0, GL_RED, GL_FLOAT, nullptr);
+
+    // Read with texelFetch only
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenBuffers(1, &instanceBuffer);
+}
+
+void TerrainSystem::update(ThreadPool& pool, const glm::vec3& inEye, const std::vector<glm::mat4>& viewProjections) {
+    eye = inEye;
+
+    quadtree.update(pool, eye);
+
+    const auto& nodes = quadtree.getDrawNodes();
+    glm::vec2 heightRange = quadtree.getHeightRange();
+    float halfHeight = (heightRange.y - heightRange.x) * 0.5f;
+
+    instances.clear();
+    passRanges.assign(viewProjections.size(), glm::ivec4(0));
+    passViewProjections = viewProjections;
+
+    for (size_t pass = 0; pass < viewProjections.size(); pass++) {
+        Frustum frustum(viewProjections[pass]);
+
+        // Whole nodes, then quarters
+        for (int32_t range = 0; range < 2; range++) {
+            int32_t first = static_cast<int32_t>(instances.size());
+
+            for (const auto& node : nodes) {
+                if ((node.quadrant >= 0) != (range == 1)) {
+                    continue;
+                }
+
+                float halfSize = node.getAreaSize() * 0.5f;
+                glm::vec2 areaCenter = node.getAreaOrigin() + halfSize;
+                glm::vec3 center = glm::vec3(areaCenter.x, heightRange.x + halfHeight, areaCenter.y);
+
+                if (!frustum.intersectsSphere(center, glm::length(glm::vec3(halfSize, halfHeight, halfSize)))) {
+                    continue;
+                }
+
+                TileInstance instance;
+                instance.originSizeLayer = glm::vec4(node.origin, node.size, static_cast<float>(node.layer));
+                instance.morph = glm::vec4(node.morphStart, node.morphEnd, static_cast<float>(node.quadrant), 0.0f);
+                instances.push_back(instance);
+            }
+
+            passRanges[pass][range * 2] = first;
+            passRanges[pass][range * 2 + 1] = static_cast<int32_t>(instances.size()) - first;
+        }
+    }
+}
+
+void TerrainSystem::upload() {
+    int32_t samples = quadtree.getTileSamples();
+
+    glActiveTexture(GL_TEXTURE0 + heightUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+
+    for (auto layer : quadtree.getGeneratedLayers()) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, samples, samples, 1, GL_RED, GL_FLOAT, quadtree.getHeights(layer).data());
+    }
+
+    quadtree.releaseGenerated();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+
+    // Never empty, so the binding is always valid
+    size_t byteSize = sizeof(TileInstance) * std::max<size_t>(instances.size(), 1);
+
+    glBufferData(GL_SHADER_STORAGE_BUFFER, byteSize, nullptr, GL_STREAM_DRAW);
+
+    if (!instances.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(TileInstance) * instances.size(), instances.data());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TileBinding, instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TerrainSystem::draw(Shader& shader, size_t pass) const {
+    if (getDrawnNodeCount(pass) == 0) {
+        return;
+    }
+
+    shader.setUniform("terrainHeights", heightUnit);
+    shader.setUniform("terrainGridSize", static_cast<float>(quadtree.gridResolution));
+    shader.setUniform("terrainEye", eye);
+    shader.setUniform("terrainTexcoordScale", texcoordScale);
+    shader.setUniform("viewProjection", passViewProjections[pass]);
+
+    glBindVertexArray(vertexArray);
+
+    const auto& range = passRanges[pass];
+
+    if (range.y > 0) {
+        shader.setUniform("terrainTileOffset", range.x);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, range.y);
+    }
+
+    // The first quadrant's indices, moved by the shader
+    if (range.w > 0) {
+        shader.setUniform("terrainTileOffset", range.z);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount / 4, GL_UNSIGNED_INT, nullptr, range.w);
+    }
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+#include "TerrainNoise.hpp"
+
+class ThreadPool;
+
+// A square of the terrain quadtree. Level 0 nodes are the smallest, each
+// level up doubles the size; x and z count nodes of the level from the
+// minimum corner of the world.
+struct TerrainNode {
+    int32_t level = 0;
+    int32_t x = 0;
+    int32_t z = 0;
+
+    bool operator==(const TerrainNode& other) const {
+        return level == other.level && x == other.x && z == other.z;
+    }
+
+    uint64_t getKey() const {
+        return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 24) | static_cast<uint32_t>(z);
+    }
+};
+
+// A node picked for drawing this frame, whole or one quarter of it
+struct TerrainDrawNode {
+    TerrainNode node;
+    // World xz of the node's minimum corner
+    glm::vec2 origin;
+    float size;
+    // Distances from the eye over which the grid morphs into the next
+    // coarser one
+    float morphStart;
+    float morphEnd;
+    // Of the height tile, in the height array
+    int32_t layer;
+    // -1 for the whole node, else the quarter drawn, x + 2 z
+    int32_t quadrant;
+
+    // World xz of the minimum corner of what is drawn
+    glm::vec2 getAreaOrigin() const {
+        if (quadrant < 0) {
+            return origin;
+        }
+
+        return origin + glm::vec2(static_cast<float>(quadrant & 1), static_cast<float>(quadrant >> 1)) * size * 0.5f;
+    }
+
+    float getAreaSize() const {
+        return quadrant < 0 ? size : size * 0.5f;
+    }
+};
+
+// Continuous distance LOD over a quadtree of terrain tiles (CDLOD, Strugar
+// 2009), without any GL. Every node is drawn with the same grid of
+// gridResolution quads a side, so a level covers four times the area of the
+// one below at the same vertex count. Level l takes the nodes within
+// lodDistance * 2^l of the eye; over the last part of that range its odd
+// vertices slide onto the even ones, so where it meets level l + 1 both
+// grids are the same and no cracks open. A quarter of a node out of the
+// range of its level is drawn by the node itself, as in the paper, since
+// the finer grid fully morphed there would still not follow the node's own
+// morph towards level l + 2.
+//
+// Each node has a height tile of (gridResolution + 3)^2 samples, one sample
+// of border around the grid for the normals, generated from the noise on
+// the thread pool in the background. Tiles are kept in a fixed number of
+// layers and the least recently used one is recycled, so memory depends on
+// the view and not on the world size. The coarsest levels stay resident, a
+// node whose tile isn't generated yet is drawn by its nearest ancestor that
+// has one.
+class TerrainQuadtree {
+public:
+    TerrainQuadtree() {}
+
+    // Waits for the tiles still being generated, they write into this
+    ~TerrainQuadtree();
+
+    TerrainQuadtree(const TerrainQuadtree&) = delete;
+    TerrainQuadtree& operator=(const TerrainQuadtree&) = delete;
+
+    // Generates the resident levels, before returning
+    void create(ThreadPool& pool);
+
+    // Takes in the tiles finished since the last update, selects the nodes
+    // to draw from the eye, then queues missing tiles on the pool, up to
+    // tilesPerFrame being generated at a time. Doesn't wait for them: a new
+    // tile is drawn from the first update after it is done.
+    void update(ThreadPool& pool, const glm::vec3& eye);
+
+    // Blocks until the queued tiles are done, the next update takes them in
+    void waitForTiles();
+
+    const std::vector<TerrainDrawNode>& getDrawNodes() const {
+        return drawNodes;
+    }
+
+    // Layers generated since the last call of releaseGenerated(), whose
+    // heights are still held
+    const std::vector<int32_t>& getGeneratedLayers() const {
+        return generatedLayers;
+    }
+
+    const std::vector<float>& getHeights(int32_t layer) const {
+        return tiles[layer].heights;
+    }
+
+    // Frees the heights of the generated layers, once they are uploaded
+    void releaseGenerated();
+
+    int32_t getLevelCount() const {
+        return levelCount;
+    }
+
+    float getNodeSize(int32_t level) const {
+        return leafSize * static_cast<float>(1 << level);
+    }
+
+    // World y bounds of every tile
+    glm::vec2 getHeightRange() const {
+        return glm::vec2(minHeight, maxHeight);
+    }
+
+    // Height samples of a tile a side
+    int32_t getTileSamples() const {
+        return gridResolution + 3;
+    }
+
+    size_t getResidentTileCount() const {
+        return layers.size();
+    }
+
+    // Missing tiles wanted by the last update, queued or not yet
+    size_t getPendingTileCount() const;
+
+public:
+    TerrainNoise noise;
+    // World y of noise height 0
+    float baseHeight = 0.0f;
+
+    // World xz center; worldSize is leafSize times a power of two
+    glm::vec2 center = glm::vec2(0.0f);
+    float worldSize = 1024.0f;
+    float leafSize = 8.0f;
+    // Quads a side of every node, a power of two
+    int32_t gridResolution = 32;
+
+    // Range of level 0. Crack free needs it well above the diagonal of a
+    // level 0 node, see the class comment.
+    float lodDistance = 24.0f;
+    // Fraction of a level's range before morphing starts
+    float morphStartRatio = 0.7f;
+
+    // Height tiles kept, 1024 of 35^2 floats are 5 MB of texture
+    int32_t tileCapacity = 1024;
+    // Most tiles queued on the pool at a time
+    int32_t tilesPerFrame = 16;
+    // Levels whose tiles never leave, counted from the top
+    int32_t residentLevels = 3;
+
+private:
+    struct Tile {
+        TerrainNode node;
+        // Written by a pool thread until bReady
+        std::vector<float> heights;
+        uint64_t lastUsedFrame = 0;
+        bool bResident = false;
+        bool bReady = false;
+    };
+
+    float getRange(int32_t level) const {
+        return lodDistance * static_cast<float>(1 << level);
+    }
+
+    glm::vec2 getOrigin(const TerrainNode& node) const;
+
+    bool intersectsRange(const TerrainNode& node, const glm::vec3& eye, float range) const;
+
+    // False when the node is out of its level's range and its parent takes
+    // the area instead
+    bool selectNode(const TerrainNode& node, const glm::vec3& eye);
+
+    // Appends the node or one quadrant of it, or requests its tile unless
+    // it is already being generated. Returns whether it has one.
+    bool addDrawNode(const TerrainNode& node, int32_t quadrant = -1);
+
+    bool hasTile(const TerrainNode& node) const;
+
+    int32_t allocateLayer();
+
+    // Assigns layers to the nodes' tiles, as many as are free or unused
+    // this frame
+    std::vector<int32_t> allocateTiles(const std::vector<TerrainNode>& nodes, bool bResident);
+
+    // Fills the heights of an allocated tile, on any thread
+    void generateTile(Tile& tile) const;
+
+    // On the calling thread, once the tile's heights are complete
+    void addGenerated(int32_t layer);
+
+    int32_t levelCount = 0;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+
+    std::vector<Tile> tiles;
+    std::unordered_map<uint64_t, int32_t> layers;
+    std::vector<int32_t> freeLayers;
+    std::vector<int32_t> generatedLayers;
+
+    std::vector<TerrainDrawNode> drawNodes;
+    std::vector<TerrainNode> requests;
+
+    // Handed over from the pool threads
+    mutable std::mutex generationMutex;
+    std::condition_variable generationDone;
+    std::vector<int32_t> finishedLayers;
+    size_t queuedTileCount = 0;
+
+    uint64_t frame = 0;
+};
+
+// Draws a TerrainQuadtree. All nodes share one grid mesh, its indices ordered
+// by quadrant so the first quarter of them draws a quarter node; the heights
+// live in a 2D array texture with one layer per tile, and the drawn nodes of
+// each pass are culled against its frustum and written to a storage buffer,
+// so a pass is two instanced draws, whole nodes and quarters. The vertex
+// shaders read the tile of each instance and displace and morph the grid,
+// see the TERRAIN feature of scene.vert and depth.vert and terrain.glsl.
+class TerrainSystem {
+public:
+    // Shader storage binding of the tile array
+    static constexpr uint32_t TileBinding = 9;
+
+    TerrainSystem() {}
+
+    ~TerrainSystem();
+
+    TerrainSystem(const TerrainSystem&) = delete;
+    TerrainSystem& operator=(const TerrainSystem&) = delete;
+
+    // Builds the grid mesh and height array and generates the resident
+    // levels, on the GL thread
+    void create(ThreadPool& pool);
+
+    // Selects and streams the nodes for the eye and culls them for each
+    // pass
+    void update(ThreadPool& pool, const glm::vec3& inEye, const std::vector<glm::mat4>& viewProjections);
+
+    // Uploads the new tiles and the culled nodes, on the GL thread
+    void upload();
+
+    // Instanced draws of the pass' nodes, with a TERRAIN program bound
+    void draw(Shader& shader, size_t pass) const;
+
+    // Quarters count as nodes
+    size_t getDrawnNodeCount(size_t pass) const {
+        return pass < passRanges.size() ? static_cast<size_t>(passRanges[pass].y + passRanges[pass].w) : 0;
+    }
+
+    size_t getTriangleCount(size_t pass) const {
+        if (pass >= passRanges.size()) {
+            return 0;
+        }
+
+        return static_cast<size_t>(passRanges[pass].y * indexCount + passRanges[pass].w * (indexCount / 4)) / 3;
+    }
+
+public:
+    TerrainQuadtree quadtree;
+    // Texture repeats per world unit
+    float texcoordScale = 0.2f;
+
+private:
+    struct TileInstance {
+        // xz of the minimum corner, size, layer
+        glm::vec4 originSizeLayer;
+        // Morph start and end distance, quadrant or -1
+        glm::vec4 morph;
+    };
+
+    glm::vec3 eye = glm::vec3(0.0f);
+
+    std::vector<TileInstance> instances;
+    // First instance and count of each pass' whole nodes, then of its
+    // quarters
+    std::vector<glm::ivec4> passRanges;
+    std::vector<glm::mat4> passViewProjections;
+
+    uint32_t vertexArray = 0;
+    uint32_t vertexBuffer = 0;
+    uint32_t indexBuffer = 0;
+    int32_t indexCount = 0;
+
+    uint32_t heightTexture = 0;
+    int32_t heightUnit = -1;
+
+    uint32_t instanceBuffer = 0;
+};
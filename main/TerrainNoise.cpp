@@ -0,0 +1,301 @@
+#include "TerrainNoise.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "ThreadPool.hpp"
+
+namespace {
+    // Skew and unskew factors of the 2D simplex grid, (sqrt(3) - 1) / 2 and
+    // (3 - sqrt(3)) / 6
+    constexpr float F2 = 0.366025403f;
+    constexpr float G2 = 0.211324865f;
+    constexpr float G2Twice = 2.0f * G2;
+
+    // Scales the simplex sum to about [-1, 1]
+    constexpr float SimplexScale = 40.0f;
+
+    // Octaves are decorrelated by a different seed each
+    constexpr uint32_t OctaveSeedStep = 0x9E3779B9u;
+
+    // Rows per chunk when splitting across threads
+    constexpr size_t MinRowsPerChunk = 8;
+
+    uint32_t hashLattice(int32_t x, int32_t z, uint32_t seed) {
+        uint32_t h = seed + static_cast<uint32_t>(x) * 0x8DA6B343u + static_cast<uint32_t>(z) * 0xD8163841u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        h ^= h >> 15;
+        return h;
+    }
+
+    // Top 24 bits to [-1, 1)
+    float toSignedUnit(uint32_t h) {
+        return static_cast<float>(h >> 8) * (1.0f / 8388608.0f) - 1.0f;
+    }
+
+    // 6t^5 - 15t^4 + 10t^3
+    float fade(float t) {
+        float polynomial = t * 6.0f;
+        polynomial = polynomial - 15.0f;
+        polynomial = polynomial * t;
+        polynomial = polynomial + 10.0f;
+        return t * t * t * polynomial;
+    }
+
+    // Dot product with one of eight gradients, (+-1, +-2) and (+-2, +-1)
+    float gradient(uint32_t h, float x, float z) {
+        float u = (h & 4) == 0 ? x : z;
+        float v = (h & 4) == 0 ? z : x;
+        u = (h & 1) != 0 ? -u : u;
+        v = (h & 2) != 0 ? -v : v;
+        return u + v * 2.0f;
+    }
+
+    float simplexCorner(uint32_t h, float x, float z) {
+        float t = 0.5f - x * x;
+        t = t - z * z;
+        t = t < 0.0f ? 0.0f : t;
+        t = t * t;
+        return t * t * gradient(h, x, z);
+    }
+
+#if defined(__AVX2__)
+    __m256i hashLattice8(__m256i x, __m256i z, __m256i seed) {
+        __m256i h = _mm256_add_epi32(seed, _mm256_add_epi32(
+            _mm256_mullo_epi32(x, _mm256_set1_epi32(static_cast<int32_t>(0x8DA6B343u))),
+            _mm256_mullo_epi32(z, _mm256_set1_epi32(static_cast<int32_t>(0xD8163841u)))));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x2C1B3C6D));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x297A2D39));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        return h;
+    }
+
+    __m256 toSignedUnit8(__m256i h) {
+        __m256 unit = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), _mm256_set1_ps(1.0f / 8388608.0f));
+        return _mm256_sub_ps(unit, _mm256_set1_ps(1.0f));
+    }
+
+    __m256 fade8(__m256 t) {
+        __m256 polynomial = _mm256_mul_ps(t, _mm256_set1_ps(6.0f));
+        polynomial = _mm256_sub_ps(polynomial, _mm256_set1_ps(15.0f));
+        polynomial = _mm256_mul_ps(polynomial, t);
+        polynomial = _mm256_add_ps(polynomial, _mm256_set1_ps(10.0f));
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), polynomial);
+    }
+
+    __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+        return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+    }
+
+    // Lanes where (h & bit) != 0, as a float mask
+    __m256 testBit8(__m256i h, int32_t bit) {
+        __m256i set = _mm256_and_si256(h, _mm256_set1_epi32(bit));
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(set, _mm256_set1_epi32(bit)));
+    }
+
+    __m256 gradient8(__m256i h, __m256 x, __m256 z) {
+        __m256 swap = testBit8(h, 4);
+        __m256 u = _mm256_blendv_ps(x, z, swap);
+        __m256 v = _mm256_blendv_ps(z, x, swap);
+
+        // Negation is a sign flip, as in the scalar path
+        __m256 sign = _mm256_set1_ps(-0.0f);
+        u = _mm256_xor_ps(u, _mm256_and_ps(testBit8(h, 1), sign));
+        v = _mm256_xor_ps(v, _mm256_and_ps(testBit8(h, 2), sign));
+
+        return _mm256_add_ps(u, _mm256_mul_ps(v, _mm256_set1_ps(2.0f)));
+    }
+
+    __m256 simplexCorner8(__m256i h, __m256 x, __m256 z) {
+        __m256 t = _mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x));
+        t = _mm256_sub_ps(t, _mm256_mul_ps(z, z));
+        t = _mm256_max_ps(t, _mm256_setzero_ps());
+        t = _mm256_mul_ps(t, t);
+        return _mm256_mul_ps(_mm256_mul_ps(t, t), gradient8(h, x, z));
+    }
+
+    __m256 valueNoise8(__m256 x, __m256 z, __m256i seed) {
+        __m256 xFloor = _mm256_floor_ps(x);
+        __m256 zFloor = _mm256_floor_ps(z);
+        __m256i ix = _mm256_cvttps_epi32(xFloor);
+        __m256i iz = _mm256_cvttps_epi32(zFloor);
+        __m256i one = _mm256_set1_epi32(1);
+
+        __m256 u = fade8(_mm256_sub_ps(x, xFloor));
+        __m256 v = fade8(_mm256_sub_ps(z, zFloor));
+
+        __m256 v00 = toSignedUnit8(hashLattice8(ix, iz, seed));
+        __m256 v10 = toSignedUnit8(hashLattice8(_mm256_add_epi32(ix, one), iz, seed));
+        __m256 v01 = toSignedUnit8(hashLattice8(ix, _mm256_add_epi32(iz, one), seed));
+        __m256 v11 = toSignedUnit8(hashLattice8(_mm256_add_epi32(ix, one), _mm256_add_epi32(iz, one), seed));
+
+        return lerp8(lerp8(v00, v10, u), lerp8(v01, v11, u), v);
+    }
+
+    __m256 simplexNoise8(__m256 x, __m256 z, __m256i seed) {
+        __m256 s = _mm256_mul_ps(_mm256_add_ps(x, z), _mm256_set1_ps(F2));
+        __m256 i = _mm256_floor_ps(_mm256_add_ps(x, s));
+        __m256 j = _mm256_floor_ps(_mm256_add_ps(z, s));
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(i, j), _mm256_set1_ps(G2));
+
+        __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(i, t));
+        __m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(j, t));
+
+        // Lower or upper triangle of the skewed cell
+        __m256 lower = _mm256_cmp_ps(x0, z0, _CMP_GT_OQ);
+        __m256 i1 = _mm256_and_ps(lower, _mm256_set1_ps(1.0f));
+        __m256 j1 = _mm256_andnot_ps(lower, _mm256_set1_ps(1.0f));
+
+        __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), _mm256_set1_ps(G2));
+        __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, j1), _mm256_set1_ps(G2));
+        __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_set1_ps(1.0f)), _mm256_set1_ps(G2Twice));
+        __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_set1_ps(1.0f)), _mm256_set1_ps(G2Twice));
+
+        __m256i ii = _mm256_cvttps_epi32(i);
+        __m256i jj = _mm256_cvttps_epi32(j);
+        __m256i one = _mm256_set1_epi32(1);
+
+        __m256 n0 = simplexCorner8(hashLattice8(ii, jj, seed), x0, z0);
+        __m256 n1 = simplexCorner8(hashLattice8(_mm256_add_epi32(ii, _mm256_cvttps_epi32(i1)), _mm256_add_epi32(jj, _mm256_cvttps_epi32(j1)), seed), x1, z1);
+        __m256 n2 = simplexCorner8(hashLattice8(_mm256_add_epi32(ii, one), _mm256_add_epi32(jj, one), seed), x2, z2);
+
+        return _mm256_mul_ps(_mm256_set1_ps(SimplexScale), _mm256_add_ps(_mm256_add_ps(n0, n1), n2));
+    }
+#endif
+}
+
+float TerrainNoise::getValueNoise(float x, float z, uint32_t octaveSeed) const {
+    float xFloor = std::floor(x);
+    float zFloor = std::floor(z);
+    int32_t ix = static_cast<int32_t>(xFloor);
+    int32_t iz = static_cast<int32_t>(zFloor);
+
+    float u = fade(x - xFloor);
+    float v = fade(z - zFloor);
+
+    float v00 = toSignedUnit(hashLattice(ix, iz, octaveSeed));
+    float v10 = toSignedUnit(hashLattice(ix + 1, iz, octaveSeed));
+    float v01 = toSignedUnit(hashLattice(ix, iz + 1, octaveSeed));
+    float v11 = toSignedUnit(hashLattice(ix + 1, iz + 1, octaveSeed));
+
+    float bottom = v00 + (v10 - v00) * u;
+    float top = v01 + (v11 - v01) * u;
+
+    return bottom + (top - bottom) * v;
+}
+
+float TerrainNoise::getSimplexNoise(float x, float z, uint32_t octaveSeed) const {
+    float s = (x + z) * F2;
+    float i = std::floor(x + s);
+    float j = std::floor(z + s);
+    float t = (i + j) * G2;
+
+    float x0 = x - (i - t);
+    float z0 = z - (j - t);
+
+    // Lower or upper triangle of the skewed cell
+    float i1 = x0 > z0 ? 1.0f : 0.0f;
+    float j1 = x0 > z0 ? 0.0f : 1.0f;
+
+    float x1 = (x0 - i1) + G2;
+    float z1 = (z0 - j1) + G2;
+    float x2 = (x0 - 1.0f) + G2Twice;
+    float z2 = (z0 - 1.0f) + G2Twice;
+
+    int32_t ii = static_cast<int32_t>(i);
+    int32_t jj = static_cast<int32_t>(j);
+
+    float n0 = simplexCorner(hashLattice(ii, jj, octaveSeed), x0, z0);
+    float n1 = simplexCorner(hashLattice(ii + static_cast<int32_t>(i1), jj + static_cast<int32_t>(j1), octaveSeed), x1, z1);
+    float n2 = simplexCorner(hashLattice(ii + 1, jj + 1, octaveSeed), x2, z2);
+
+    return SimplexScale * ((n0 + n1) + n2);
+}
+
+float TerrainNoise::getFbm(float x, float z) const {
+    float sum = 0.0f;
+    float octaveAmplitude = 1.0f;
+    float octaveFrequency = frequency;
+    float amplitudeSum = 0.0f;
+
+    for (int32_t octave = 0; octave < octaves; octave++) {
+        uint32_t octaveSeed = seed + static_cast<uint32_t>(octave) * OctaveSeedStep;
+        float noise = basis == Basis::Value
+            ? getValueNoise(x * octaveFrequency, z * octaveFrequency, octaveSeed)
+            : getSimplexNoise(x * octaveFrequency, z * octaveFrequency, octaveSeed);
+
+        sum = sum + octaveAmplitude * noise;
+        amplitudeSum = amplitudeSum + octaveAmplitude;
+        octaveAmplitude = octaveAmplitude * gain;
+        octaveFrequency = octaveFrequency * lacunarity;
+    }
+
+    return amplitudeSum > 0.0f ? sum * (1.0f / amplitudeSum) : 0.0f;
+}
+
+void TerrainNoise::generate(ThreadPool& pool, float* heights, int32_t columns, int32_t rows, const glm::vec2& origin, const glm::vec2& spacing) const {
+    pool.parallelFor(static_cast<size_t>(std::max(rows, 0)), MinRowsPerChunk, [&](size_t, size_t begin, size_t end) {
+        generateRows(heights, columns, static_cast<int32_t>(begin), static_cast<int32_t>(end), origin, spacing);
+    });
+}
+
+void TerrainNoise::generateRows(float* heights, int32_t columns, int32_t firstRow, int32_t lastRow, const glm::vec2& origin, const glm::vec2& spacing) const {
+    for (int32_t row = firstRow; row < lastRow; row++) {
+        float* rowHeights = heights + static_cast<size_t>(row) * columns;
+        float z = origin.y + static_cast<float>(row) * spacing.y;
+        int32_t column = 0;
+
+#if defined(__AVX2__)
+        if (bVectorized) {
+            float amplitudeSum = 0.0f;
+            float octaveAmplitude = 1.0f;
+
+            for (int32_t octave = 0; octave < octaves; octave++) {
+                amplitudeSum = amplitudeSum + octaveAmplitude;
+                octaveAmplitude = octaveAmplitude * gain;
+            }
+
+            __m256 normalise = _mm256_set1_ps(amplitudeSum > 0.0f ? 1.0f / amplitudeSum : 0.0f);
+            __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+            for (; column + static_cast<int32_t>(Lanes) <= columns; column += Lanes) {
+                __m256 columnIndices = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(column)), lanes);
+                __m256 x = _mm256_add_ps(_mm256_set1_ps(origin.x), _mm256_mul_ps(columnIndices, _mm256_set1_ps(spacing.x)));
+
+                __m256 sum = _mm256_setzero_ps();
+                float amplitudeOfOctave = 1.0f;
+                float octaveFrequency = frequency;
+
+                for (int32_t octave = 0; octave < octaves; octave++) {
+                    __m256i octaveSeed = _mm256_set1_epi32(static_cast<int32_t>(seed + static_cast<uint32_t>(octave) * OctaveSeedStep));
+                    __m256 scaledX = _mm256_mul_ps(x, _mm256_set1_ps(octaveFrequency));
+                    __m256 scaledZ = _mm256_set1_ps(z * octaveFrequency);
+
+                    __m256 noise = basis == Basis::Value ? valueNoise8(scaledX, scaledZ, octaveSeed) : simplexNoise8(scaledX, scaledZ, octaveSeed);
+
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitudeOfOctave), noise));
+                    amplitudeOfOctave = amplitudeOfOctave * gain;
+                    octaveFrequency = octaveFrequency * lacunarity;
+                }
+
+                __m256 fbm = _mm256_mul_ps(sum, normalise);
+                _mm256_storeu_ps(rowHeights + column, _mm256_add_ps(_mm256_set1_ps(offset), _mm256_mul_ps(_mm256_set1_ps(amplitude), fbm)));
+            }
+        }
+#endif
+
+        for (; column < columns; column++) {
+            float x = origin.x + static_cast<float>(column) * spacing.x;
+            rowHeights[column] = getHeight(x, z);
+        }
+    }
+}
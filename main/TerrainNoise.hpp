@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+class ThreadPool;
+
+// Stateless terrain heights: fractal Brownian motion (octaves of noise at
+// rising frequency and falling amplitude) over integer-hash value noise or
+// 2D simplex noise.
+//
+// Every sample is a pure function of the settings and (x, z): lattice values
+// come from a 32 bit integer hash, the float math is adds, multiplies and
+// floor only, always in the same order. The scalar path, the 8-lane AVX2
+// path and any split across threads therefore give bit-identical heights,
+// on every platform with IEEE floats and no fused multiply-adds.
+class TerrainNoise {
+public:
+    enum class Basis {
+        // Hashed values at the lattice points, quintic interpolation
+        Value,
+        // Simplex noise with hashed gradients (Perlin 2001, after Gustavson)
+        Simplex
+    };
+
+    static constexpr uint32_t Lanes = 8;
+
+    explicit TerrainNoise(uint32_t inSeed = 0)
+    : seed(inSeed) {}
+
+    // One octave of the basis, in [-1, 1]
+    float getValueNoise(float x, float z, uint32_t octaveSeed) const;
+    float getSimplexNoise(float x, float z, uint32_t octaveSeed) const;
+
+    // Octaves summed and normalised to [-1, 1]
+    float getFbm(float x, float z) const;
+
+    // offset + amplitude * getFbm(x, z)
+    float getHeight(float x, float z) const {
+        return offset + amplitude * getFbm(x, z);
+    }
+
+    // heights[row * columns + column] = getHeight() at
+    // origin + (column, row) * spacing, rows split across the pool
+    void generate(ThreadPool& pool, float* heights, int32_t columns, int32_t rows, const glm::vec2& origin, const glm::vec2& spacing) const;
+
+    // The same for rows [firstRow, lastRow) only, on the calling thread
+    void generateRows(float* heights, int32_t columns, int32_t firstRow, int32_t lastRow, const glm::vec2& origin, const glm::vec2& spacing) const;
+
+    uint32_t seed;
+
+    Basis basis = Basis::Simplex;
+    int32_t octaves = 5;
+    // Of the first octave, in cycles per world unit
+    float frequency = 0.05f;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+
+    float amplitude = 1.0f;
+    float offset = 0.0f;
+
+    // Scalar path only when false, for comparisons
+    bool bVectorized = true;
+};
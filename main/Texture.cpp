@@ -7,10 +7,27 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "../support/error.hpp"
+
 #define UNUSED(x) (void)(x)
 
 uint32_t Texture::activeIndex = 0;
 
+int32_t Texture::allocateTextureUnit() {
+    static int32_t maxTextureUnits = 0;
+
+    if (maxTextureUnits == 0) {
+        glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
+    }
+
+    // Sharing a unit would silently sample the wrong texture
+    if (static_cast<int32_t>(activeIndex) >= maxTextureUnits) {
+        throw Error("Out of texture units (%d)", maxTextureUnits);
+    }
+
+    return static_cast<int32_t>(activeIndex++);
+}
+
 std::string Texture::suffixes[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
 
 GLenum targets[] = {
@@ -29,7 +46,8 @@ Texture::Texture(const std::string& inName, int32_t inWidth, int32_t inHeight, i
     height = inHeight;
 
     glGenTextures(1, &id);
-    glActiveTexture(GL_TEXTURE0 + activeIndex++);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, id);
 
     if (fillData) {
@@ -57,7 +75,8 @@ void Texture::createCubemap(int32_t inWidth, int32_t inHeight) {
     height = inHeight;
 
     glGenTextures(1, &id);
-    glActiveTexture(GL_TEXTURE0 + activeIndex++);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
 
     for (int32_t i = 0; i < 6; i++) {
@@ -76,7 +95,8 @@ void Texture::createDepthMap(int32_t inWidth, int32_t inHeight) {
 	height = inHeight;
 
     glGenTextures(1, &id);
-    glActiveTexture(GL_TEXTURE0 + activeIndex++);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, id);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, inWidth, inHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
@@ -90,6 +110,26 @@ void Texture::createDepthMap(int32_t inWidth, int32_t inHeight) {
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 }
 
+void Texture::createDepthMapArray(int32_t inWidth, int32_t inHeight, int32_t layers) {
+	width = inWidth;
+	height = inHeight;
+
+    glGenTextures(1, &id);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, inWidth, inHeight, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+}
+
 void Texture::load(const std::string& fileName, int32_t wrapMode) {
     //if (!std::filesystem::exists(fileName)) {
     //    std::cout << "File " + fileName << " doesn't exists.\n";
@@ -100,7 +140,8 @@ void Texture::load(const std::string& fileName, int32_t wrapMode) {
 
     uint8_t* data = stbi_load(fileName.c_str(), &width, &height, &bpp, 4);
 
-    glActiveTexture(GL_TEXTURE0 + activeIndex++);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
 
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
@@ -116,7 +157,8 @@ void Texture::load(const std::string& fileName, int32_t wrapMode) {
 }
 
 void Texture::loadCubemap(const std::string& baseName, int32_t wrapMode, bool hdr) {
-    glActiveTexture(GL_TEXTURE0 + activeIndex++);
+    unit = allocateTextureUnit();
+    glActiveTexture(GL_TEXTURE0 + unit);
 
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
@@ -20,13 +20,15 @@ public:
 
     ~Texture() {
         //glDeleteTextures(1, &id);
-        activeIndex--;
     }
 
     void createCubemap(int32_t inWidth, int32_t inHeight);
 
     void createDepthMap(int32_t inWidth, int32_t inHeight);
 
+    // GL_TEXTURE_2D_ARRAY depth texture, one layer per shadow cascade
+    void createDepthMapArray(int32_t inWidth, int32_t inHeight, int32_t layers);
+
     void load(const std::string& fileName, int32_t wrapMode = GL_REPEAT);
 
     void loadCubemap(const std::string& baseName, int32_t wrapMode = GL_CLAMP_TO_EDGE, bool hdr = false);
@@ -38,16 +40,16 @@ public:
     }
 
     int32_t getTextureIndex() const {
-        return id - 1;
+        return unit;
     }
 
     static uint32_t getActiveIndex() {
         return activeIndex;
     }
 
-    static void increaseActiveIndex() {
-        activeIndex++;
-    }
+    // Texture units are handed out once and stay bound for the lifetime of the
+    // program, material textures should go through TextureArrayPool instead.
+    static int32_t allocateTextureUnit();
 
     int32_t getWidth() const {
         return width;
@@ -62,6 +64,7 @@ public:
 private:
     static uint32_t activeIndex;
     uint32_t id = 0;
+    int32_t unit = 0;
     int32_t width = 0;
     int32_t height = 0;
 };
\ No newline at end of file
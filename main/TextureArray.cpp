@@ -0,0 +1,201 @@
+#include "TextureArray.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "stb_image.h"
+
+#include "Texture.hpp"
+
+namespace {
+    int32_t nextPowerOfTwo(int32_t value) {
+        int32_t result = 1;
+
+        while (result < value) {
+            result <<= 1;
+        }
+
+        return result;
+    }
+
+    // Bilinear RGBA8 resample, only used once per texture at load time
+    std::vector<uint8_t> resample(const uint8_t* source, int32_t sourceWidth, int32_t sourceHeight, int32_t width, int32_t height) {
+        std::vector<uint8_t> result(static_cast<size_t>(width) * height * 4);
+
+        float scaleX = static_cast<float>(sourceWidth) / width;
+        float scaleY = static_cast<float>(sourceHeight) / height;
+
+        for (int32_t y = 0; y < height; y++) {
+            float sy = std::max(0.0f, (y + 0.5f) * scaleY - 0.5f);
+            int32_t y0 = std::min(static_cast<int32_t>(sy), sourceHeight - 1);
+            int32_t y1 = std::min(y0 + 1, sourceHeight - 1);
+            float fy = sy - y0;
+
+            for (int32_t x = 0; x < width; x++) {
+                float sx = std::max(0.0f, (x + 0.5f) * scaleX - 0.5f);
+                int32_t x0 = std::min(static_cast<int32_t>(sx), sourceWidth - 1);
+                int32_t x1 = std::min(x0 + 1, sourceWidth - 1);
+                float fx = sx - x0;
+
+                for (int32_t c = 0; c < 4; c++) {
+                    float c00 = source[(y0 * sourceWidth + x0) * 4 + c];
+                    float c10 = source[(y0 * sourceWidth + x1) * 4 + c];
+                    float c01 = source[(y1 * sourceWidth + x0) * 4 + c];
+                    float c11 = source[(y1 * sourceWidth + x1) * 4 + c];
+
+                    float top = c00 + (c10 - c00) * fx;
+                    float bottom = c01 + (c11 - c01) * fx;
+
+                    result[(static_cast<size_t>(y) * width + x) * 4 + c] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+
+        return result;
+    }
+}
+
+int32_t TextureArray::addLayer(const uint8_t* data) {
+    size_t layerSize = static_cast<size_t>(width) * height * 4;
+
+    stagingPixels.insert(stagingPixels.end(), data, data + layerSize);
+
+    return layerCount++;
+}
+
+void TextureArray::build() {
+    if (layerCount == uploadedLayerCount) {
+        return;
+    }
+
+    if (unit < 0) {
+        unit = Texture::allocateTextureUnit();
+    }
+
+    uint32_t newId = 0;
+
+    glGenTextures(1, &newId);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, newId);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // Growing an array means reallocating it, keep the layers already on the GPU
+    if (id != 0) {
+        glCopyImageSubData(id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, newId, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, uploadedLayerCount);
+        glDeleteTextures(1, &id);
+    }
+
+    id = newId;
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, uploadedLayerCount, width, height, layerCount - uploadedLayerCount, GL_RGBA, GL_UNSIGNED_BYTE, stagingPixels.data());
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    uploadedLayerCount = layerCount;
+
+    stagingPixels.clear();
+    stagingPixels.shrink_to_fit();
+}
+
+TextureLayer TextureArrayPool::add(const std::string& name, const std::string& fileName) {
+    auto iterator = layers.find(name);
+
+    if (iterator != layers.end()) {
+        return iterator->second;
+    }
+
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t bpp = 0;
+
+    uint8_t* data = stbi_load(fileName.c_str(), &width, &height, &bpp, 4);
+
+    if (data == nullptr) {
+        std::cout << "Load texture " + fileName << " failed." << std::endl;
+        auto layer = addSolidColor("White", 255, 255, 255);
+        layers[name] = layer;
+        return layer;
+    }
+
+    auto layer = addPixels(name, data, width, height);
+
+    stbi_image_free(data);
+
+    return layer;
+}
+
+TextureLayer TextureArrayPool::addSolidColor(const std::string& name, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    auto iterator = layers.find(name);
+
+    if (iterator != layers.end()) {
+        return iterator->second;
+    }
+
+    uint8_t pixel[] = { r, g, b, a };
+
+    return addPixels(name, pixel, 1, 1);
+}
+
+TextureLayer TextureArrayPool::addPixels(const std::string& name, const uint8_t* data, int32_t inWidth, int32_t inHeight) {
+    int32_t width = std::min(nextPowerOfTwo(inWidth), MaxDimension);
+    int32_t height = std::min(nextPowerOfTwo(inHeight), MaxDimension);
+
+    TextureLayer layer;
+    layer.array = findArray(width, height);
+
+    auto& array = arrays[layer.array];
+
+    if (array->getWidth() == inWidth && array->getHeight() == inHeight) {
+        layer.layer = array->addLayer(data);
+    }
+    else {
+        auto pixels = resample(data, inWidth, inHeight, array->getWidth(), array->getHeight());
+        layer.layer = array->addLayer(pixels.data());
+    }
+
+    layers[name] = layer;
+
+    return layer;
+}
+
+int32_t TextureArrayPool::findArray(int32_t inWidth, int32_t inHeight) {
+    for (size_t i = 0; i < arrays.size(); i++) {
+        if (arrays[i]->getWidth() == inWidth && arrays[i]->getHeight() == inHeight) {
+            return static_cast<int32_t>(i);
+        }
+    }
+
+    if (static_cast<int32_t>(arrays.size()) < MaxArrays) {
+        arrays.push_back(std::make_unique<TextureArray>(inWidth, inHeight));
+        return static_cast<int32_t>(arrays.size() - 1);
+    }
+
+    // Out of arrays, fall back to the one closest in size
+    int32_t closest = 0;
+    int64_t closestDifference = INT64_MAX;
+
+    for (size_t i = 0; i < arrays.size(); i++) {
+        int64_t difference = std::llabs(static_cast<int64_t>(arrays[i]->getWidth()) * arrays[i]->getHeight() - static_cast<int64_t>(inWidth) * inHeight);
+
+        if (difference < closestDifference) {
+            closestDifference = difference;
+            closest = static_cast<int32_t>(i);
+        }
+    }
+
+    return closest;
+}
+
+void TextureArrayPool::build() {
+    for (auto& array : arrays) {
+        array->build();
+    }
+}
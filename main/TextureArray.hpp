@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad.h>
+
+// Where a material texture lives: which array of the pool and which layer of it.
+struct TextureLayer {
+    int32_t array = 0;
+    int32_t layer = 0;
+};
+
+// A GL_TEXTURE_2D_ARRAY of same-size RGBA8 images. The whole array occupies a
+// single texture unit, no matter how many layers it holds.
+class TextureArray {
+public:
+    TextureArray(int32_t inWidth, int32_t inHeight)
+    : width(inWidth), height(inHeight) {
+    }
+
+    ~TextureArray() {
+        if (id != 0) {
+            glDeleteTextures(1, &id);
+        }
+    }
+
+    // Owns the GL texture, so only one array may hold it
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    TextureArray(TextureArray&& other) noexcept
+    : id(other.id), unit(other.unit), width(other.width), height(other.height), layerCount(other.layerCount),
+      uploadedLayerCount(other.uploadedLayerCount), stagingPixels(std::move(other.stagingPixels)) {
+        other.id = 0;
+        other.unit = -1;
+        other.layerCount = 0;
+        other.uploadedLayerCount = 0;
+    }
+
+    TextureArray& operator=(TextureArray&& other) noexcept {
+        if (this != &other) {
+            if (id != 0) {
+                glDeleteTextures(1, &id);
+            }
+
+            id = other.id;
+            unit = other.unit;
+            width = other.width;
+            height = other.height;
+            layerCount = other.layerCount;
+            uploadedLayerCount = other.uploadedLayerCount;
+            stagingPixels = std::move(other.stagingPixels);
+
+            other.id = 0;
+            other.unit = -1;
+            other.layerCount = 0;
+            other.uploadedLayerCount = 0;
+        }
+
+        return *this;
+    }
+
+    // Copies width * height RGBA8 pixels into a staging buffer. The data is
+    // uploaded on the next build().
+    int32_t addLayer(const uint8_t* data);
+
+    void build();
+
+    uint32_t getTextureId() const {
+        return id;
+    }
+
+    int32_t getTextureIndex() const {
+        return unit;
+    }
+
+    int32_t getWidth() const {
+        return width;
+    }
+
+    int32_t getHeight() const {
+        return height;
+    }
+
+    int32_t getLayerCount() const {
+        return layerCount;
+    }
+
+private:
+    uint32_t id = 0;
+    int32_t unit = -1;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t layerCount = 0;
+    int32_t uploadedLayerCount = 0;
+    std::vector<uint8_t> stagingPixels;
+};
+
+// Groups material textures (diffuse and normal maps) into texture arrays keyed
+// by size. Images are resampled to power-of-two dimensions first, so the scene
+// only needs a handful of arrays, and thus texture units, for hundreds of
+// textures.
+class TextureArrayPool {
+public:
+    // Must match the size of materialTextures[] in the shaders
+    static constexpr int32_t MaxArrays = 8;
+    static constexpr int32_t MaxDimension = 2048;
+
+    TextureLayer add(const std::string& name, const std::string& fileName);
+
+    TextureLayer addSolidColor(const std::string& name, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255);
+
+    bool contains(const std::string& name) const {
+        return layers.count(name) > 0;
+    }
+
+    const TextureLayer& get(const std::string& name) const {
+        return layers.at(name);
+    }
+
+    // Uploads all pending layers. Call once loading is done (calling it again
+    // after adding more textures only uploads the new layers).
+    void build();
+
+    const std::vector<std::unique_ptr<TextureArray>>& getArrays() const {
+        return arrays;
+    }
+
+    size_t getTextureCount() const {
+        return layers.size();
+    }
+
+private:
+    TextureLayer addPixels(const std::string& name, const uint8_t* data, int32_t inWidth, int32_t inHeight);
+
+    int32_t findArray(int32_t inWidth, int32_t inHeight);
+
+    std::map<std::string, TextureLayer> layers;
+    std::vector<std::unique_ptr<TextureArray>> arrays;
+};
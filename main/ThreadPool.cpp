@@ -0,0 +1,148 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(uint32_t workerCount) {
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStopping = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::getChunkCount(size_t count, size_t minChunkSize) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    minChunkSize = std::max<size_t>(minChunkSize, 1);
+
+    size_t maxChunks = (count + minChunkSize - 1) / minChunkSize;
+
+    return std::min<size_t>(getThreadCount(), maxChunks);
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minChunkSize, const std::function<void(size_t, size_t, size_t)>& task) {
+    size_t chunkCount = getChunkCount(count, minChunkSize);
+
+    if (chunkCount == 0) {
+        return;
+    }
+
+    if (chunkCount == 1) {
+        task(0, 0, count);
+        return;
+    }
+
+    size_t unfinished = chunkCount;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            size_t begin = count * chunk / chunkCount;
+            size_t end = count * (chunk + 1) / chunkCount;
+
+            jobs.push_back({ [&task, chunk, begin, end]() { task(chunk, begin, end); }, &unfinished });
+        }
+    }
+
+    jobAvailable.notify_all();
+
+    waitForJobs(unfinished);
+}
+
+void ThreadPool::run(const std::vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    size_t unfinished = tasks.size();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto& task : tasks) {
+            jobs.push_back({ [&task]() { task(); }, &unfinished });
+        }
+    }
+
+    jobAvailable.notify_all();
+
+    waitForJobs(unfinished);
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Nobody else would ever run it
+    if (workers.empty()) {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({ std::move(task), nullptr });
+    }
+
+    jobAvailable.notify_one();
+}
+
+bool ThreadPool::runPendingJob(std::unique_lock<std::mutex>& lock, size_t* unfinished) {
+    auto next = jobs.begin();
+
+    if (unfinished) {
+        next = std::find_if(jobs.begin(), jobs.end(), [unfinished](const Job& job) { return job.unfinished == unfinished; });
+    }
+
+    if (next == jobs.end()) {
+        return false;
+    }
+
+    Job job = std::move(*next);
+    jobs.erase(next);
+
+    lock.unlock();
+    job.task();
+    lock.lock();
+
+    if (job.unfinished && --*job.unfinished == 0) {
+        jobsDone.notify_all();
+    }
+
+    return true;
+}
+
+void ThreadPool::waitForJobs(size_t& unfinished) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Help with this call's chunks instead of sleeping on them. Jobs queued by
+    // other calls are left to the workers, so a short call isn't stuck behind
+    // a long one.
+    while (unfinished > 0 && runPendingJob(lock, &unfinished)) {
+    }
+
+    jobsDone.wait(lock, [&unfinished]() { return unfinished == 0; });
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        jobAvailable.wait(lock, [this]() { return bStopping || !jobs.empty(); });
+
+        if (bStopping && jobs.empty()) {
+            return;
+        }
+
+        runPendingJob(lock);
+    }
+}
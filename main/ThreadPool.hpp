@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for per-frame CPU work. The calling thread
+// always helps out, so a pool with no workers simply runs everything inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Worker threads plus the calling thread
+    uint32_t getThreadCount() const {
+        return static_cast<uint32_t>(workers.size()) + 1;
+    }
+
+    // Number of chunks parallelFor() will split count items into
+    size_t getChunkCount(size_t count, size_t minChunkSize = 1) const;
+
+    // Splits [0, count) into contiguous chunks and calls task(chunkIndex, begin, end)
+    // for each of them. Chunks are numbered in order, so results written to
+    // per-chunk storage can be concatenated without sorting. Blocks until all
+    // chunks are done.
+    void parallelFor(size_t count, size_t minChunkSize, const std::function<void(size_t, size_t, size_t)>& task);
+
+    // Runs independent tasks concurrently and waits for all of them.
+    void run(const std::vector<std::function<void()>>& tasks);
+
+    // Queues a task and returns at once, the task has to report its own
+    // completion. Without workers it runs inline. Queued tasks are finished
+    // before the pool is destroyed.
+    void submit(std::function<void()> task);
+
+private:
+    // A queued task and the unfinished count of the call that queued it,
+    // none for submit()
+    struct Job {
+        std::function<void()> task;
+        size_t* unfinished = nullptr;
+    };
+
+    void workerLoop();
+
+    // Runs the next queued job, or the next one counted by unfinished if given
+    bool runPendingJob(std::unique_lock<std::mutex>& lock, size_t* unfinished = nullptr);
+
+    // Blocks until the jobs counted by unfinished are done, concurrent calls
+    // from other threads don't hold it up
+    void waitForJobs(size_t& unfinished);
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    bool bStopping = false;
+};
@@ -0,0 +1,167 @@
+#include "TransformStage.hpp"
+
+#include <algorithm>
+
+#include <xmmintrin.h>
+
+namespace {
+    // Groups of four instances per pool chunk
+    constexpr size_t MinGroupsPerChunk = 16;
+
+    struct Vec3x4 {
+        __m128 x;
+        __m128 y;
+        __m128 z;
+    };
+
+    Vec3x4 cross(const Vec3x4& a, const Vec3x4& b) {
+        return {
+            _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+            _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+            _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+        };
+    }
+
+    __m128 dot(const Vec3x4& a, const Vec3x4& b) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+    }
+
+    // columns[column * 4 + row] holds that element of four matrices; writes
+    // them back as four column-major glm::mat4 at the given member offset
+    void storeMatrices(__m128 columns[16], InstanceTransform* output, glm::mat4 InstanceTransform::* member, size_t count) {
+        for (int32_t column = 0; column < 4; column++) {
+            __m128 row0 = columns[column * 4 + 0];
+            __m128 row1 = columns[column * 4 + 1];
+            __m128 row2 = columns[column * 4 + 2];
+            __m128 row3 = columns[column * 4 + 3];
+
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+            __m128 transposed[4] = { row0, row1, row2, row3 };
+
+            for (size_t i = 0; i < count; i++) {
+                _mm_storeu_ps(&(output[i].*member)[column][0], transposed[i]);
+            }
+        }
+    }
+}
+
+void TransformStage::clear() {
+    for (auto& element : elements) {
+        element.clear();
+    }
+
+    viewScaleMasks.clear();
+    instanceCount = 0;
+}
+
+uint32_t TransformStage::addInstance(const glm::mat4& worldMatrix, bool bViewScale) {
+    for (int32_t column = 0; column < 4; column++) {
+        for (int32_t row = 0; row < 4; row++) {
+            elements[column * 4 + row].push_back(worldMatrix[column][row]);
+        }
+    }
+
+    viewScaleMasks.push_back(bViewScale ? 1.0f : 0.0f);
+
+    return static_cast<uint32_t>(instanceCount++);
+}
+
+void TransformStage::compute(ThreadPool& threadPool, const std::vector<TransformView>& views) {
+    viewCount = views.size();
+
+    // Pad to whole groups so the kernel never reads past the end
+    size_t paddedCount = (instanceCount + 3) & ~size_t(3);
+
+    for (auto& element : elements) {
+        element.resize(paddedCount, 0.0f);
+    }
+
+    viewScaleMasks.resize(paddedCount, 0.0f);
+
+    transforms.resize(viewCount * instanceCount);
+
+    size_t groupCount = paddedCount / 4;
+
+    threadPool.parallelFor(viewCount * groupCount, MinGroupsPerChunk, [&](size_t, size_t begin, size_t end) {
+        for (size_t task = begin; task < end; task++) {
+            size_t view = task / groupCount;
+            size_t group = task % groupCount;
+
+            computeGroup(views[view], &transforms[view * instanceCount], group * 4);
+        }
+    });
+
+    // Drop the padding again so addInstance() keeps appending in place
+    for (auto& element : elements) {
+        element.resize(instanceCount);
+    }
+
+    viewScaleMasks.resize(instanceCount);
+}
+
+void TransformStage::computeGroup(const TransformView& view, InstanceTransform* output, size_t first) {
+    __m128 world[16];
+
+    for (int32_t i = 0; i < 16; i++) {
+        world[i] = _mm_loadu_ps(&elements[i][first]);
+    }
+
+    // scale = 1 + mask * (modelScale - 1), per column
+    __m128 mask = _mm_loadu_ps(&viewScaleMasks[first]);
+    __m128 one = _mm_set1_ps(1.0f);
+
+    for (int32_t column = 0; column < 3; column++) {
+        __m128 scale = _mm_add_ps(one, _mm_mul_ps(mask, _mm_set1_ps(view.modelScale[column] - 1.0f)));
+
+        for (int32_t row = 0; row < 4; row++) {
+            world[column * 4 + row] = _mm_mul_ps(world[column * 4 + row], scale);
+        }
+    }
+
+    // mvp = viewProjection * world
+    __m128 mvp[16];
+
+    for (int32_t column = 0; column < 4; column++) {
+        for (int32_t row = 0; row < 4; row++) {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(view.viewProjection[0][row]), world[column * 4 + 0]);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(view.viewProjection[1][row]), world[column * 4 + 1]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(view.viewProjection[2][row]), world[column * 4 + 2]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(view.viewProjection[3][row]), world[column * 4 + 3]));
+
+            mvp[column * 4 + row] = sum;
+        }
+    }
+
+    // inverse(transpose(M)) of the 3x3 part with columns a, b, c is
+    // (b x c, c x a, a x b) / det
+    Vec3x4 a = { world[0], world[1], world[2] };
+    Vec3x4 b = { world[4], world[5], world[6] };
+    Vec3x4 c = { world[8], world[9], world[10] };
+
+    Vec3x4 bc = cross(b, c);
+    Vec3x4 ca = cross(c, a);
+    Vec3x4 ab = cross(a, b);
+
+    __m128 determinant = dot(a, bc);
+    // Degenerate matrices (padding, zero scale) keep a zero normal matrix
+    __m128 valid = _mm_cmpneq_ps(determinant, _mm_setzero_ps());
+    __m128 inverseDeterminant = _mm_and_ps(_mm_div_ps(one, determinant), valid);
+
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 normal[16] = {
+        _mm_mul_ps(bc.x, inverseDeterminant), _mm_mul_ps(bc.y, inverseDeterminant), _mm_mul_ps(bc.z, inverseDeterminant), zero,
+        _mm_mul_ps(ca.x, inverseDeterminant), _mm_mul_ps(ca.y, inverseDeterminant), _mm_mul_ps(ca.z, inverseDeterminant), zero,
+        _mm_mul_ps(ab.x, inverseDeterminant), _mm_mul_ps(ab.y, inverseDeterminant), _mm_mul_ps(ab.z, inverseDeterminant), zero,
+        zero, zero, zero, one
+    };
+
+    size_t count = std::min<size_t>(4, instanceCount - first);
+
+    output += first;
+
+    storeMatrices(world, output, &InstanceTransform::worldMatrix, count);
+    storeMatrices(normal, output, &InstanceTransform::normalMatrix, count);
+    storeMatrices(mvp, output, &InstanceTransform::mvpMatrix, count);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "ThreadPool.hpp"
+
+// Matrices of one instance as seen from one pass
+struct InstanceTransform {
+    glm::mat4 worldMatrix;
+    // Inverse-transpose of the upper 3x3 of worldMatrix
+    glm::mat4 normalMatrix;
+    glm::mat4 mvpMatrix;
+};
+
+// Transform view of a pass
+struct TransformView {
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    // Applied after the world matrix of instances added with bViewScale
+    glm::vec3 modelScale = glm::vec3(1.0f);
+};
+
+// Per-frame transform stage. Instance world matrices are collected once per
+// frame into structure-of-arrays storage, then world, normal and
+// model-view-projection matrices are computed for every view with SSE, four
+// instances at a time, on the thread pool. Passes index the results with
+// get(view, instance) instead of multiplying matrices per draw.
+class TransformStage {
+public:
+    void clear();
+
+    // Returns the instance index, valid until the next clear()
+    uint32_t addInstance(const glm::mat4& worldMatrix, bool bViewScale = false);
+
+    void compute(ThreadPool& threadPool, const std::vector<TransformView>& views);
+
+    const InstanceTransform& get(size_t view, uint32_t instance) const {
+        return transforms[view * instanceCount + instance];
+    }
+
+    size_t getInstanceCount() const {
+        return instanceCount;
+    }
+
+    size_t getViewCount() const {
+        return viewCount;
+    }
+
+private:
+    void computeGroup(const TransformView& view, InstanceTransform* output, size_t first);
+
+    // elements[column * 4 + row][instance], padded to whole groups of four
+    // while compute() runs
+    std::vector<float> elements[16];
+    std::vector<float> viewScaleMasks;
+
+    // [view * instanceCount + instance]
+    std::vector<InstanceTransform> transforms;
+
+    size_t instanceCount = 0;
+    size_t viewCount = 0;
+};
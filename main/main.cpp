@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <random>
+#include <limits>
 #include <filesystem>
 
 #include "../support/error.hpp"
@@ -25,9 +26,6 @@
 
 #include "lodepng.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tinyobjloader/tiny_obj_loader.h"
-
 #define GLM_FORCE_SILENT_WARNINGS
 #include "glm/glm.hpp"
 
@@ -37,8 +35,25 @@
 #include "Shader.hpp"
 #include "Model.hpp"
 #include "Camera.hpp"
+#include "GBuffer.hpp"
+#include "GpuParticles.hpp"
+#include "GpuTimer.hpp"
+#include "Heightfield.hpp"
 #include "glDebug.hpp"
-#include "Particle.hpp"
+#include "LightClusters.hpp"
+#include "ModelLoader.hpp"
+#include "ParticleLod.hpp"
+#include "ParticlePool.hpp"
+#include "Random.hpp"
+#include "RenderQueue.hpp"
+#include "ShadowCascades.hpp"
+#include "ShadowFilter.hpp"
+#include "Smoke.hpp"
+#include "ShaderVariants.hpp"
+#include "Terrain.hpp"
+#include "TerrainNoise.hpp"
+#include "ThreadPool.hpp"
+#include "TransformStage.hpp"
 
 #define UNUSED(x) (void)(x)
 
@@ -82,11 +97,32 @@ struct Fog {
 	glm::vec4 color;
 };
 
-std::vector<Particle> particles;
+// Every random stream derives from this, so runs repeat frame for frame
+constexpr uint64_t RandomSeed = 20241224;
+
+// Refilled by 500 whenever it drops below 1500, both scaled by the LOD density
+ParticlePool particles(2048);
+RandomStream spawnRandom(RandomSeed);
+// x, z and gravity effect of each flake being spawned
+std::vector<float> spawnValues;
+// Replaces the pool above when enabled, simulated and culled on the GPU
+bool bGpuParticles = true;
+int32_t gpuParticleCount = 1 << 20;
+GpuParticles gpuParticles;
+// Simulation and drawing of the GPU snow, drawing only of the CPU one
+GpuTimer gpuParticleTimer;
+// Distance thinning and frame budget of either path
+ParticleLod particleLod;
+// Of the CPU pool, in front of the first ones after culling and thinning
+size_t visibleParticleCount = 0;
+// CPU time of the CPU pool this frame, update and transforms
+double particleCpuMilliseconds = 0.0;
 
 uint32_t lightCubeVAO;
 uint32_t screenQuadVAO;
 uint32_t particleQuadVAO;
+// No attributes, the deferred lighting pass builds its triangle from gl_VertexID
+uint32_t fullscreenTriangleVAO;
 uint32_t textureId;
 
 std::shared_ptr<Shader> sceneShader;
@@ -98,8 +134,77 @@ std::shared_ptr<Shader> decorationShader;
 std::shared_ptr<Shader> particleShader;
 std::shared_ptr<Shader> depthShader;
 std::shared_ptr<Shader> screenQuadShader;
+std::shared_ptr<Shader> gbufferShader;
+std::shared_ptr<Shader> deferredShader;
+std::shared_ptr<Shader> shadowMomentsShader;
+std::shared_ptr<Shader> gpuParticleShader;
+std::shared_ptr<Shader> particleSimulationShader;
+
+// Compile-time permutations, see ShaderVariants. sceneShader, gbufferShader,
+// deferredShader and depthShader are their variants without any feature.
+std::shared_ptr<ShaderVariants> sceneVariants;
+std::shared_ptr<ShaderVariants> gbufferVariants;
+std::shared_ptr<ShaderVariants> deferredVariants;
+std::shared_ptr<ShaderVariants> depthVariants;
+// Startup programs, compiled while the models and textures load
+ShaderBatch startupShaders;
+
+// Deferred shading writes the scene pipeline into the G-buffer and lights it
+// in one fullscreen pass; ornaments and particles are still drawn forward
+bool bDeferredShading = false;
+GBuffer gBuffer;
+// GPU time of the camera view, from clearing to the last particle
+GpuTimer sceneTimer;
+
+// Forward path only: lays down the camera pass depth with the position-only
+// stream first, so the scene shader then runs once per pixel (GL_EQUAL, no
+// depth writes). Auto keeps whichever setting measured cheaper.
+enum class DepthPrepassMode : int32_t {
+	Off,
+	On,
+	Auto
+};
+
+int32_t depthPrepassMode = static_cast<int32_t>(DepthPrepassMode::Auto);
+bool bDepthPrepass = false;
+GpuTimer depthPrepassTimer;
+// Pre-pass plus scene pipeline shading of the forward camera pass
+GpuTimer shadingTimer;
+// Mean shadingTimer without (0) and with (1) the pre-pass, as last measured
+double depthPrepassCosts[2] = {};
 
 std::map<std::string, std::shared_ptr<Texture>> textures;
+TextureArrayPool materialTextures;
+
+// One static and one dynamic shadow pass per cascade
+enum RenderPass {
+	// Static casters, only built when a cascade of the cached static shadow map is redrawn
+	StaticShadowPass,
+	// Dynamic casters, drawn over a copy of the static shadow map every frame
+	ShadowPass = StaticShadowPass + ShadowCascadeCount,
+	CameraPass = ShadowPass + ShadowCascadeCount,
+	RenderPassCount
+};
+
+ThreadPool threadPool;
+RenderQueue renderQueue;
+TransformStage transformStage;
+std::vector<RenderItem> renderItems;
+std::vector<RenderPassView> renderPasses;
+std::vector<TransformView> transformViews;
+// Snowflake billboards follow the render items in the transform stage
+uint32_t firstParticleTransform = 0;
+
+// Every lit ornament ball is a point light
+LightClusters lightClusters;
+std::vector<PointLight> pointLights;
+// Object space ball centers of the red, golden and purple ornament meshes
+std::vector<glm::vec3> ornamentLightCenters[3];
+float ornamentLightRadius = 2.0f;
+float ornamentLightIntensity = 1.5f;
+// Point lights further away than this are not clustered
+float clusterDistance = 100.0f;
+
 std::map<std::string, std::shared_ptr<Material>> materials;
 
 std::vector<Light> lights(5);
@@ -183,7 +288,10 @@ glm::mat4 projectorView = glm::lookAt(projectorPosition, projectAt, projectorUp)
 glm::mat4 projectorProjection = glm::perspective(glm::radians(60.0f), aspect, nearPlane, farPlane);
 glm::mat4 projectorScaleTranslate = glm::mat4(1.0f);
 glm::mat4 projectorTransform = glm::mat4(1.0f);
-glm::mat4 lightSpaceMatrix;
+// Directional light the shadows are cast from
+glm::vec3 shadowLightDirection = glm::normalize(glm::vec3(10.0f, -8.0f, 10.0f));
+// The cascades cover the view frustum up to this distance
+float shadowDistance = 60.0f;
 
 uint32_t renderSceneFBO;
 
@@ -192,12 +300,13 @@ std::shared_ptr<Texture> skyboxDay;
 std::shared_ptr<Texture> skyboxDusk;
 std::shared_ptr<Texture> skyboxNight;
 std::shared_ptr<Texture> currentSkybox;
-std::shared_ptr<Texture> defaultAlbedo;
-std::shared_ptr<Texture> currentHouseTexture;
-std::shared_ptr<Texture> houseTexture;
-std::shared_ptr<Texture> houseLightTexture;
+TextureLayer defaultAlbedo;
+TextureLayer currentHouseTexture;
+TextureLayer houseTexture;
+TextureLayer houseLightTexture;
 std::shared_ptr<Texture> snowflakesTexture;
 std::shared_ptr<Texture> depthMapTexture;
+std::shared_ptr<Texture> staticDepthMapTexture;
 std::shared_ptr<Texture> markusTexture;
 
 uint32_t depthBuffer = 0;
@@ -208,7 +317,6 @@ std::shared_ptr<Model> renderWindow;
 std::shared_ptr<Model> reflectionFloor;
 std::shared_ptr<Model> teapot;
 std::shared_ptr<Model> lightSphere;
-std::shared_ptr<Model> terrain;
 std::shared_ptr<Model> leftHouse;
 std::shared_ptr<Model> rightHouse;
 
@@ -226,15 +334,12 @@ std::shared_ptr<Model> flagpole;
 std::shared_ptr<Model> flag;
 
 std::shared_ptr<Model> activeSnowman;
-std::shared_ptr<Model> activeSnowmanArm;
 
 int32_t activeSnowmanIndex = 0;
 
 std::vector<std::shared_ptr<Model>> snowmen;
 
 std::vector<std::shared_ptr<Model>> models;
-std::vector<std::shared_ptr<Model>> smokes1;
-std::vector<std::shared_ptr<Model>> smokes2;
 
 std::shared_ptr<Model> redBalls[6];
 std::shared_ptr<Model> goldenBalls[6];
@@ -243,19 +348,21 @@ std::shared_ptr<Model> purpleBalls[6];
 std::shared_ptr<Model> giftBoxBody;
 std::shared_ptr<Model> giftBoxCover;
 
-std::vector<std::vector<std::shared_ptr<Model>>> smokesGroup = { smokes1, smokes2 };
-
-//glm::vec3 smokeSpwanPositions[3] = { { leftHouse->getPosition().x, 5.25f, -0.75f},
-//                                     {0.75f, 4.75f, -0.75f},
-//                                     {0.75f, 4.0f, -0.75f} };
-
-glm::vec3 smokeSpawnPositions1[3];
-glm::vec3 smokeSpawnPositions2[3];
-
-float smokeInterval = 3.0f;
-float smokeTimers[3];
+// Chimney smoke, every pass draws each emitter as instances of smokePuff
+SmokeSystem smoke;
+std::shared_ptr<Model> smokePuff;
 
 GeometryGenerator geometryGenerator;
+
+// Heights of the terrain above terrainPosition.y, in [0, 1]
+TerrainNoise terrainNoise;
+// Quadtree tiles streamed around the camera, every pass draws them with one
+// instanced draw of a TERRAIN variant
+TerrainSystem terrain;
+std::shared_ptr<Material> terrainMaterial;
+TextureLayer terrainTexture;
+// World space heights of the terrain around the scene, for ground contact
+Heightfield terrainHeights;
 float edgeThreshold = 0.05f;
 glm::vec3 edgeColor = { 1.0f, 1.0f, 1.0f };
 
@@ -284,44 +391,35 @@ float snowmanYawRates[3];
 
 float lightTimer = 0.0f;
 
-constexpr int FLOAT_MIN = 0;
-constexpr int FLOAT_MAX = 1;
+// Per cascade, so the four layers take as much memory as one 2048x2048 map
+constexpr GLuint ShadowMapWidth = 1024;
+constexpr GLuint SHadowMapHeight = 1024;
 
-constexpr GLuint ShadowMapWidth = 2048;
-constexpr GLuint SHadowMapHeight = 2048;
+ShadowCascades shadowCascades(ShadowMapWidth);
+
+ShadowFilter shadowFilter;
+int32_t shadowFilterMode = static_cast<int32_t>(ShadowFilterMode::PCF);
+// Moments prefiltering, zero for the modes that don't prefilter
+GpuTimer shadowFilterTimer;
+// Mean scene GPU time of each mode, as last measured
+double shadowFilterSceneCosts[static_cast<int32_t>(ShadowFilterMode::Count)] = {};
 
 float shadowmapBias = 0.001f;
 
 unsigned int depthMapFBO;
+unsigned int staticDepthMapFBO;
+
+// A cascade of the static shadow map is redrawn when its light space matrix
+// or the set of visible static casters or their transforms change
+bool bStaticShadowDirty[ShadowCascadeCount] = { true, true, true, true };
+glm::mat4 staticShadowLightSpaceMatrices[ShadowCascadeCount] = {};
+uint64_t staticShadowCasterHash = 0;
 unsigned int depthMap;
 
 std::shared_ptr<Model> createSmoke(float radius, const glm::vec3& position);
-void drawParticle(const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix);
 
 void updateFPSCounter(GLFWwindow* window);
 
-float getNoise(float x, float z) {
-	std::srand(static_cast<uint32_t>(x * 49632) + static_cast<uint32_t>(z * 325186 + 1000000000));
-	return FLOAT_MIN + (float)(rand()) / ((float)(RAND_MAX / (FLOAT_MAX - FLOAT_MIN)));
-}
-
-float getSmoothNoise(float x, float z) {
-
-	float corners = (getNoise(x - 1.0f, z - 1.0f) +
-		getNoise(x + 1.0f, z - 1.0f) +
-		getNoise(x - 1.0f, z + 1.0f) +
-		getNoise(x + 1.0f, z + 1.0f)) / 16.0f;
-
-	float sides = (getNoise(x - 1.0f, z) +
-		getNoise(x + 1.0f, z) +
-		getNoise(x, z - 1.0f) +
-		getNoise(x, z + 1.0f)) / 8.0f;
-
-	float center = getNoise(x, z) / 4.0f;
-
-	return corners + sides + center;
-}
-
 const auto& getTexture(const std::string& name);
 
 void writeToPNG(const std::string& path, int32_t width, int32_t height, uint8_t* pixelBuffer);
@@ -357,6 +455,16 @@ void changeCameraControl() {
 	}
 }
 
+// Only called when the texture changes, rather than every frame
+void setHouseTexture(const TextureLayer& texture) {
+	currentHouseTexture = texture;
+
+	if (leftHouse && rightHouse) {
+		leftHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
+		rightHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
+	}
+}
+
 void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int mods) {
 
 	//ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
@@ -371,10 +479,10 @@ void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int
 
 	if (glfwGetKey(inWindow, GLFW_KEY_H) == GLFW_PRESS) {
 		if (bToggleHouseLight) {
-			currentHouseTexture = houseTexture;
+			setHouseTexture(houseTexture);
 		}
 		else {
-			currentHouseTexture = houseLightTexture;
+			setHouseTexture(houseLightTexture);
 		}
 
 		bToggleHouseLight = !bToggleHouseLight;
@@ -439,9 +547,9 @@ void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int
 			auto activeSnowmanPosition = activeSnowman->getPosition();
 			activeSnowmanPosition += velocityY * frameTime * jumpHeight;
 			activeSnowman->setPosition(activeSnowmanPosition);
-			activeSnowmanArm->setPosition(activeSnowmanPosition);
 
-			snowmanYawRates[activeSnowmanIndex] = 360.0f / ((activeSnowmanPosition.y - (-1.8f)) / (gravity.y * frameTime));
+			float groundHeight = terrainHeights.sample(activeSnowmanPosition.x, activeSnowmanPosition.z);
+			snowmanYawRates[activeSnowmanIndex] = 360.0f / ((activeSnowmanPosition.y - groundHeight) / (gravity.y * frameTime));
 
 			activeSnowman->bJumping = true;
 		}
@@ -449,7 +557,6 @@ void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int
 
 	if (glfwGetKey(inWindow, GLFW_KEY_1) == GLFW_PRESS) {
 		activeSnowman = leftSnowman;
-		activeSnowmanArm = leftSnowmanArm;
 		activeSnowmanIndex = 0;
 		bSnowmanControlCameras[selectedSnowmanIndex] = !bSnowmanControlCameras[selectedSnowmanIndex];
 		//changeCameraControl();
@@ -464,7 +571,6 @@ void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int
 
 	if (glfwGetKey(inWindow, GLFW_KEY_2) == GLFW_PRESS) {
 		activeSnowman = middleSnowman;
-		activeSnowmanArm = middleSnowmanArm;
 		activeSnowmanIndex = 1;
 		bSnowmanControlCameras[selectedSnowmanIndex] = !bSnowmanControlCameras[selectedSnowmanIndex];
 		//changeCameraControl();
@@ -489,7 +595,6 @@ void onKeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int
 
 	if (glfwGetKey(inWindow, GLFW_KEY_3) == GLFW_PRESS) {
 		activeSnowman = rightSnowman;
-		activeSnowmanArm = rightSnowmanArm;
 		activeSnowmanIndex = 2;
 		bSnowmanControlCameras[selectedSnowmanIndex] = !bSnowmanControlCameras[selectedSnowmanIndex];
 		//changeCameraControl();
@@ -728,7 +833,6 @@ void processInput(GLFWwindow* inWindow) {
 		if (glfwGetKey(inWindow, GLFW_KEY_LEFT) == GLFW_PRESS) {
 			if (activeSnowman) {
 				activeSnowman->rotate(frameTime * snowmanYawRate, glm::vec3(0.0f, 1.0f, 0.0f));
-				activeSnowmanArm->rotate(frameTime * snowmanYawRate, glm::vec3(0.0f, 1.0f, 0.0f));
 
 				auto newCameraPosition = glm::vec3(activeSnowman->getPosition().x, 0.25f, activeSnowman->getPosition().z);
 				mainCamera.setEye(newCameraPosition);
@@ -741,7 +845,6 @@ void processInput(GLFWwindow* inWindow) {
 		if (glfwGetKey(inWindow, GLFW_KEY_RIGHT) == GLFW_PRESS) {
 			if (activeSnowman) {
 				activeSnowman->rotate(-frameTime * snowmanYawRate, glm::vec3(0.0f, 1.0f, 0.0f));
-				activeSnowmanArm->rotate(-frameTime * snowmanYawRate, glm::vec3(0.0f, 1.0f, 0.0f));
 
 				auto newCameraPosition = glm::vec3(activeSnowman->getPosition().x, 0.25f, activeSnowman->getPosition().z);
 				mainCamera.setEye(newCameraPosition);
@@ -788,13 +891,14 @@ void generateFrameBufferObject(uint32_t& fbo, const std::shared_ptr<Texture>& re
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void generateDepthFrameBufferObject() {
+void generateDepthFrameBufferObject(uint32_t& fbo, const std::shared_ptr<Texture>& depthTexture) {
 
-	glGenFramebuffers(1, &depthMapFBO);
+	glGenFramebuffers(1, &fbo);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMapTexture->getTextureId(), 0);
+	// Layers are switched per cascade while rendering
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture->getTextureId(), 0, 0);
 
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
@@ -826,17 +930,31 @@ void generateDepthFrameBufferObject() {
 
 void prepareFrameBufferObject() {
 	//generateFrameBufferObject(renderSceneFBO, sceneTexture);
-	generateDepthFrameBufferObject();
+	generateDepthFrameBufferObject(depthMapFBO, depthMapTexture);
+	generateDepthFrameBufferObject(staticDepthMapFBO, staticDepthMapTexture);
+}
+
+auto createShader(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath) {
+
+	auto shader = std::make_shared<Shader>(name);
+
+	shader->submit(vertexPath, fragmentPath);
+	startupShaders.add(shader);
+
+	return shader;
 }
 
 auto createShader(const std::string& name, const std::string& basePath) {
+	return createShader(name, basePath + ".vert", basePath + ".frag");
+}
+
+// Compiled on the spot, outside the startup batch and the binary cache
+auto createComputeShader(const std::string& name, const std::string& path) {
 
 	auto shader = std::make_shared<Shader>(name);
 
 	shader->create();
-	shader->compileShaderFromFile(basePath + ".vert", ShaderType::VERTEX);
-	shader->compileShaderFromFile(basePath + ".frag", ShaderType::FRAGMENT);
-
+	shader->compileShaderFromFile(path, ShaderType::COMPUTE);
 	shader->link();
 
 	return shader;
@@ -844,16 +962,30 @@ auto createShader(const std::string& name, const std::string& basePath) {
 
 void prepareShaderResources() {
 
-	sceneShader = createShader("scene", "./assets/shaders/scene");
+	sceneVariants = std::make_shared<ShaderVariants>("scene", "./assets/shaders/scene.vert", "./assets/shaders/scene.frag");
+	sceneShader = sceneVariants->get(0, &startupShaders);
 	skyboxShader = createShader("skybox", "./assets/shaders/skybox");
 	textureShader = createShader("texture", "./assets/shaders/texture");
 	lightCubeShader = createShader("color", "./assets/shaders/color");
 	colorShader = createShader("color", "./assets/shaders/color");
 	decorationShader = createShader("decoration", "./assets/shaders/decoration");
 	particleShader = createShader("particle", "./assets/shaders/particle");
-	depthShader = createShader("depth", "./assets/shaders/depth");
+	depthVariants = std::make_shared<ShaderVariants>("depth", "./assets/shaders/depth.vert", "./assets/shaders/depth.frag");
+	depthShader = depthVariants->get(0, &startupShaders);
+	// The smoke draws into every shadow map
+	depthVariants->get(depthVariants->getFeatureBit("INSTANCED"), &startupShaders);
+	// And so does the terrain
+	depthVariants->get(depthVariants->getFeatureBit("TERRAIN"), &startupShaders);
 	//screenQuadShader = createShader("screenquad", "./resources/shaders/screenquad");
 	screenQuadShader = createShader("screenquad", "./assets/shaders/debugquaddepth");
+	// Same vertex stage as the forward scene shader
+	gbufferVariants = std::make_shared<ShaderVariants>("gbuffer", "./assets/shaders/scene.vert", "./assets/shaders/gbuffer.frag");
+	gbufferShader = gbufferVariants->get(0, &startupShaders);
+	deferredVariants = std::make_shared<ShaderVariants>("deferred", "./assets/shaders/fullscreen.vert", "./assets/shaders/deferred.frag");
+	deferredShader = deferredVariants->get(0, &startupShaders);
+	shadowMomentsShader = createShader("shadowmoments", "./assets/shaders/fullscreen.vert", "./assets/shaders/shadowmoments.frag");
+	gpuParticleShader = createShader("particle_gpu", "./assets/shaders/particle_gpu.vert", "./assets/shaders/particle.frag");
+	particleSimulationShader = createComputeShader("particles", "./assets/shaders/particles.comp");
 
 	lights[0].color = { 1.0f, 0.0f, 0.2f, 1.0f };
 	lights[0].position = { -1.0f, -1.0f, -1.0f, 0.0f };
@@ -926,6 +1058,9 @@ void createScreenQuad() {
 
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride), (void*)(sizeof(float) * 6));
+
+	// Core profile needs a vertex array bound to draw, even without attributes
+	glGenVertexArrays(1, &fullscreenTriangleVAO);
 }
 
 void createParticleQuad() {
@@ -972,15 +1107,14 @@ void createParticleQuad() {
 
 void spawnParticles(int32_t amount) {
 
-	std::random_device randomDevice;
-	std::mt19937 mt(randomDevice());
-	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	spawnValues.resize(static_cast<size_t>(amount) * 3);
+	spawnRandom.fillUniform(spawnValues.data(), spawnValues.size(), -1.0f, 1.0f);
 
 	for (auto i = 0; i < amount; i++) {
-		auto position = glm::vec3(distribution(mt) * 20.0f, 10.0f, distribution(mt) * 20.0f);
-		auto gravityEffect = (distribution(mt) + 1.0f) * 0.4f + 0.1f;
-		auto particle = Particle(position, glm::vec3(0.0f), -0.98f, gravityEffect);
-		particles.push_back(particle);
+		const float* values = &spawnValues[i * 3];
+		auto position = glm::vec3(values[0] * 20.0f, 10.0f, values[1] * 20.0f);
+		auto gravityEffect = (values[2] + 1.0f) * 0.4f + 0.1f;
+		particles.spawn(position, glm::vec3(0.0f), gravityEffect);
 	}
 }
 
@@ -1081,6 +1215,9 @@ void prepareGeometryData() {
 
 	createScreenQuad();
 	createParticleQuad();
+
+	gpuParticles.seed = static_cast<uint32_t>(RandomSeed);
+	gpuParticles.resize(gpuParticleCount);
 }
 
 void initImGui() {
@@ -1174,6 +1311,29 @@ auto addCubemapTexture(const std::string& name, const std::string& path, int32_t
 	return std::make_shared<Texture>();
 }
 
+auto addMaterialTexture(const std::string& name, const std::string& path) {
+	return materialTextures.add(name, path);
+}
+
+// Sampler uniforms are program state, so the texture array units only need to
+// be set once after the arrays have been built
+void bindMaterialTextureUnits(Shader& shader) {
+
+	const auto& arrays = materialTextures.getArrays();
+
+	if (arrays.empty()) {
+		return;
+	}
+
+	shader.use();
+
+	for (int32_t i = 0; i < TextureArrayPool::MaxArrays; i++) {
+		// Unused slots still need a unit holding a 2D array texture
+		auto& array = arrays[std::min<size_t>(i, arrays.size() - 1)];
+		shader.setUniform("materialTextures[" + std::to_string(i) + "]", array->getTextureIndex());
+	}
+}
+
 void addMaterial(const std::string& name, const std::shared_ptr<Material>& material) {
 	materials[name] = material;
 }
@@ -1183,120 +1343,135 @@ const auto& getMaterial(const std::string& name) {
 }
 
 std::shared_ptr<Model> loadModel(const std::string& fileName, const std::string& inName, const std::string& materialPath, const std::string& texturePath) {
+	return loadObjModel(fileName, inName, materialPath, texturePath, addMaterialTexture, defaultAlbedo);
+}
+
+// Forward against deferred GPU time of the camera view at common window
+// sizes. Each step resizes the window, waits a few frames and then averages
+// the scene timer; the results are printed to the console.
+const glm::ivec2 BenchmarkResolutions[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+constexpr int32_t BenchmarkStepCount = 6;
+constexpr int32_t BenchmarkWarmupFrames = 30;
+constexpr int32_t BenchmarkFrames = 120;
+
+struct ShadingBenchmark {
+	bool bRunning = false;
+	int32_t step = 0;
+	int32_t frame = 0;
+	glm::ivec2 restoreSize;
+	bool bRestoreDeferredShading = false;
+	glm::ivec2 sizes[BenchmarkStepCount];
+	double milliseconds[BenchmarkStepCount];
+};
 
-	tinyobj::ObjReaderConfig readConfig;
-	readConfig.mtl_search_path = materialPath;
+ShadingBenchmark shadingBenchmark;
 
-	tinyobj::ObjReader reader;
+void beginShadingBenchmarkStep() {
 
-	if (!reader.ParseFromFile(fileName, readConfig)) {
-		if (!reader.Error().empty()) {
-			std::cerr << "TinyObjRead: " << reader.Error();
-		}
-		return nullptr;
-	}
+	const auto& resolution = BenchmarkResolutions[shadingBenchmark.step / 2];
 
-	if (!reader.Warning().empty()) {
-		std::cout << "TinyObjReader: " << reader.Warning();
-	}
+	glfwSetWindowSize(window, resolution.x, resolution.y);
+	bDeferredShading = (shadingBenchmark.step % 2) == 1;
+	shadingBenchmark.frame = 0;
+}
 
-	auto slash = fileName.find_last_of('/');
-	auto dot = fileName.find_last_of('.');
+// CPU cost of ParticlePool::update() on a million particles landing on the
+// terrain, through the vector and the scalar path
+void benchmarkParticles() {
 
-	auto model = std::make_shared<Model>();
+	constexpr size_t ParticleCount = 1000000;
+	constexpr int32_t Iterations = 50;
 
-	if (!inName.empty()) {
-		model->setName(inName);
-	}
-	else {
-		model->setName(fileName.substr(slash + 1, dot - (slash + 1)));
+	ParticlePool pool(ParticleCount);
+	pool.ground = &terrainHeights;
+
+	// Nothing dies, every iteration updates the whole pool
+	pool.lifeTime = std::numeric_limits<float>::max();
+
+	std::vector<float> gravityEffects(ParticleCount);
+	RandomStream(RandomSeed, 1).fillUniform(gravityEffects.data(), ParticleCount, 0.1f, 0.9f);
+
+	for (size_t i = 0; i < ParticleCount; i++) {
+		pool.spawn(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f), gravityEffects[i]);
 	}
 
-	auto& attrib = reader.GetAttrib();
-	auto& shapes = reader.GetShapes();
-	auto& objMaterials = reader.GetMaterials();
+	std::printf("Particle update, %d iterations\n", Iterations);
 
-	size_t materialIndex = 0;
+	for (auto bVectorized : { true, false }) {
+		pool.bVectorized = bVectorized;
+		terrainHeights.bVectorized = bVectorized;
 
-	for (const auto& shape : shapes) {
-		auto mesh = std::make_shared<Mesh>();
-		std::unordered_map<Vertex, uint32_t> uniqueVertices;
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex = {};
+		double startSeconds = glfwGetTime();
 
-			vertex.position = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+		for (int32_t i = 0; i < Iterations; i++) {
+			pool.update(1.0f / 60.0f);
+		}
 
-			// Check if 'normal_index' is zero of positive. negative = no normal data
-			if (index.normal_index >= 0) {
-				tinyobj::real_t nx = attrib.normals[3 * size_t(index.normal_index) + 0];
-				tinyobj::real_t ny = attrib.normals[3 * size_t(index.normal_index) + 1];
-				tinyobj::real_t nz = attrib.normals[3 * size_t(index.normal_index) + 2];
-				vertex.normal = { nx, ny, nz };
-			}
+		double milliseconds = (glfwGetTime() - startSeconds) * 1000.0 / Iterations;
 
-			if (index.texcoord_index >= 0) {
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-			}
+		std::printf("  %-6s %.3f ms per million particles\n", bVectorized ? "vector" : "scalar", milliseconds * 1000000.0 / ParticleCount);
+	}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(mesh->getVertices().size());
-				mesh->addVertex(vertex);
-			}
+	terrainHeights.bVectorized = true;
+}
 
-			mesh->addIndex(uniqueVertices[vertex]);
-		}
+void startShadingBenchmark() {
 
-		mesh->setName(shape.name);
+	if (shadingBenchmark.bRunning) {
+		return;
+	}
 
-		const auto& material = objMaterials[materialIndex];
+	int32_t width = 0;
+	int32_t height = 0;
+	glfwGetWindowSize(window, &width, &height);
 
-		auto meshMaterial = std::make_shared<Material>();
+	shadingBenchmark.bRunning = true;
+	shadingBenchmark.step = 0;
+	shadingBenchmark.restoreSize = glm::ivec2(width, height);
+	shadingBenchmark.bRestoreDeferredShading = bDeferredShading;
 
-		meshMaterial->Ka = { material.ambient[0], material.ambient[1], material.ambient[2] };
-		meshMaterial->Kd = { material.diffuse[0], material.diffuse[1], material.diffuse[2] };
-		meshMaterial->Ke = { material.emission[0], material.emission[2], material.emission[2] };
-		meshMaterial->Ks = { material.specular[0], material.specular[1], material.specular[2] };
+	beginShadingBenchmarkStep();
+}
 
-		meshMaterial->shininess = material.shininess;
-		meshMaterial->ior = material.ior;
-		meshMaterial->eta = 1.0f / meshMaterial->ior;
+// Called once per frame after the scene is drawn
+void updateShadingBenchmark() {
 
-		if (!material.diffuse_texname.empty()) {
-			auto texture = addTexture(material.name + "Diffuse", texturePath + material.diffuse_texname, GL_CLAMP_TO_EDGE);
+	if (!shadingBenchmark.bRunning) {
+		return;
+	}
 
-			if (texture) {
-				mesh->addTexture(texture);
-			}
+	shadingBenchmark.frame++;
 
-		}
-		else {
-			mesh->addTexture(defaultAlbedo);
-		}
+	if (shadingBenchmark.frame == BenchmarkWarmupFrames) {
+		sceneTimer.reset();
+	}
+
+	if (shadingBenchmark.frame < BenchmarkWarmupFrames + BenchmarkFrames) {
+		return;
+	}
 
-		if (!material.bump_texname.empty()) {
-			auto texture = addTexture(material.name + "Normal", texturePath + material.bump_texname);
+	// The window manager may not give us the requested size, report what was rendered
+	shadingBenchmark.sizes[shadingBenchmark.step] = glm::ivec2(WindowWidth, WindowHeight);
+	shadingBenchmark.milliseconds[shadingBenchmark.step] = sceneTimer.getMeanMilliseconds();
 
-			if (texture) {
-				mesh->addTexture(texture);
-				meshMaterial->hasNormalMap = true;
-			}
-		}
+	shadingBenchmark.step++;
 
-		mesh->setMaterial(std::move(meshMaterial));
+	if (shadingBenchmark.step < BenchmarkStepCount) {
+		beginShadingBenchmarkStep();
+		return;
+	}
 
-		materialIndex++;
+	std::printf("Shading benchmark, mean GPU ms over %d frames\n", BenchmarkFrames);
+	std::printf("%-12s %10s %10s\n", "size", "forward", "deferred");
 
-		model->addMesh(std::move(mesh));
+	for (int32_t i = 0; i < BenchmarkStepCount; i += 2) {
+		const auto& size = shadingBenchmark.sizes[i + 1];
+		std::printf("%5dx%-6d %10.3f %10.3f\n", size.x, size.y, shadingBenchmark.milliseconds[i], shadingBenchmark.milliseconds[i + 1]);
 	}
 
-	return model;
+	glfwSetWindowSize(window, shadingBenchmark.restoreSize.x, shadingBenchmark.restoreSize.y);
+	bDeferredShading = shadingBenchmark.bRestoreDeferredShading;
+	shadingBenchmark.bRunning = false;
 }
 
 void buildImGuiWidgets() {
@@ -1329,6 +1504,10 @@ void buildImGuiWidgets() {
 
 		ImGui::ColorEdit3("Ambient", (float*)&commonMaterial->Ka); // Edit 1 float using a slider from 0.1f to 1.0f
 		ImGui::SliderFloat("Shininess", &commonMaterial->shininess, 32.0f, 128.0f);
+
+		// The terrain's material is a single-sided copy of Common
+		terrainMaterial->Ka = commonMaterial->Ka;
+		terrainMaterial->shininess = commonMaterial->shininess;
 		ImGui::Checkbox("Fog", &bFog);
 
 		if (bFog)
@@ -1354,6 +1533,86 @@ void buildImGuiWidgets() {
 		//ImGui::DragFloat3("Light0 Position", (float*)&lights[1].position, 0.1f, -10.0f, 10.f);
 		//ImGui::Checkbox("Projective Texture Mapping", &bShowProjector);
 		ImGui::Checkbox("Draw Normals", &bDrawNormals);
+		ImGui::Checkbox("GPU Snow", &bGpuParticles);
+
+		if (bGpuParticles) {
+			ImGui::SliderInt("Snowflakes", &gpuParticleCount, 1024, 1 << 22);
+
+			// Reallocating respawns every flake, so only once the drag ends
+			if (ImGui::IsItemDeactivatedAfterEdit()) {
+				gpuParticles.resize(gpuParticleCount);
+			}
+
+			ImGui::Text("Snow GPU time %.3f ms", gpuParticleTimer.getAverageMilliseconds());
+		}
+
+		ImGui::Checkbox("Snow LOD", &particleLod.bEnabled);
+
+		if (particleLod.bEnabled) {
+			ImGui::SliderFloat("Snow Budget (ms)", &particleLod.budgetMilliseconds, 0.05f, 4.0f);
+			ImGui::DragFloatRange2("Snow LOD Distance", &particleLod.nearDistance, &particleLod.farDistance, 0.5f, 0.0f, 200.0f);
+			ImGui::SliderFloat("Snow Merge Factor", &particleLod.mergeFactor, 1.0f, 16.0f);
+		}
+
+		if (bGpuParticles) {
+			ImGui::Text("Snow active %u of %u", gpuParticles.getActiveCount(), gpuParticles.getCount());
+		}
+		else {
+			ImGui::Text("Snow active %zu, drawn %zu", particles.size(), visibleParticleCount);
+		}
+
+		ImGui::Text("Snow density %.0f%%, %.3f of %.3f ms (%.0f%%)", particleLod.getDensity() * 100.0f, particleLod.getAverageMilliseconds(),
+					particleLod.budgetMilliseconds, particleLod.getAverageMilliseconds() / particleLod.budgetMilliseconds * 100.0f);
+
+		ImGui::Checkbox("Deferred Shading", &bDeferredShading);
+		ImGui::Text("Scene GPU time %.3f ms", sceneTimer.getAverageMilliseconds());
+
+		const char* depthPrepassModes[] = { "Off", "On", "Auto" };
+		ImGui::Combo("Depth Pre-pass", &depthPrepassMode, depthPrepassModes, IM_ARRAYSIZE(depthPrepassModes));
+		ImGui::Text("Forward shading %.3f ms without, %.3f ms with pre-pass (%s)", depthPrepassCosts[0], depthPrepassCosts[1], bDepthPrepass ? "on" : "off");
+		ImGui::Text("Pre-pass alone %.3f ms", depthPrepassTimer.getAverageMilliseconds());
+
+		const char* shadowFilterModes[] = { "PCF 3x3", "Hardware PCF", "Variance", "Exponential" };
+		const char* shadowFilterQualities[] = {
+			"9 fetches, hard 3x3 box",
+			"4 fetches, smooth 3x3 tent",
+			"1 fetch, soft, may light bleed",
+			"1 fetch, soft, darkens contacts"
+		};
+
+		ImGui::Combo("Shadow Filter", &shadowFilterMode, shadowFilterModes, IM_ARRAYSIZE(shadowFilterModes));
+		ImGui::Text("Quality: %s", shadowFilterQualities[shadowFilterMode]);
+		ImGui::Text("Prefilter %.3f ms", shadowFilterTimer.getAverageMilliseconds());
+
+		for (int32_t i = 0; i < IM_ARRAYSIZE(shadowFilterModes); i++) {
+			ImGui::Text("  %-14s scene %.3f ms", shadowFilterModes[i], shadowFilterSceneCosts[i]);
+		}
+
+		if (ShadowFilter::isPrefiltered(static_cast<ShadowFilterMode>(shadowFilterMode))) {
+			ImGui::SliderFloat("ESM Exponent", &shadowFilter.exponent, 10.0f, 80.0f);
+			ImGui::SliderFloat("VSM Bleeding Reduction", &shadowFilter.lightBleedingReduction, 0.0f, 0.9f);
+		}
+
+		ImGui::Text("Terrain: %zu nodes, %zu triangles drawn, %zu tiles resident, %zu pending", terrain.getDrawnNodeCount(CameraPass), terrain.getTriangleCount(CameraPass),
+					terrain.quadtree.getResidentTileCount(), terrain.quadtree.getPendingTileCount());
+		ImGui::SliderFloat("Terrain LOD Distance", &terrain.quadtree.lodDistance, 18.0f, 64.0f);
+
+		ImGui::Text("Shader variants: scene %zu, G-buffer %zu, deferred %zu", sceneVariants->getVariantCount(), gbufferVariants->getVariantCount(), deferredVariants->getVariantCount());
+
+		if (ImGui::Button("Benchmark Shading")) {
+			startShadingBenchmark();
+		}
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Benchmark Particles")) {
+			benchmarkParticles();
+		}
+
+		if (shadingBenchmark.bRunning) {
+			ImGui::SameLine();
+			ImGui::Text("step %d/%d", shadingBenchmark.step + 1, BenchmarkStepCount);
+		}
 
 		if (ImGui::Button("Button"))                            // Buttons return true when clicked (most widgets return true when edited/activated)
 			counter++;
@@ -1446,14 +1705,14 @@ void updateSnowman() {
 
 	for (int i = 0; i < 6; i += 2) {
 		auto snowmanPosition = snowmen[i]->getPosition();
+		float groundHeight = terrainHeights.sample(snowmanPosition.x, snowmanPosition.z);
 
-		if (snowmanPosition.y > -1.8f) {
+		if (snowmanPosition.y > groundHeight) {
 			snowmanPosition += gravity * frameTime;
+			// Lands on the ground instead of sinking into it
+			snowmanPosition.y = std::max(snowmanPosition.y, groundHeight);
 			snowmen[i]->setPosition(snowmanPosition);
-			snowmen[i + 1]->setPosition(snowmanPosition);
-
 			snowmen[i]->setTransform(glm::rotate(snowmen[i]->getTransform(), glm::radians(snowmanYawRates[i / 2]), glm::vec3(0.0f, 1.0f, 0.0f)));
-			snowmen[i + 1]->setTransform(glm::rotate(snowmen[i]->getTransform(), glm::radians(snowmanYawRates[i / 2]), glm::vec3(0.0f, 1.0f, 0.0f)));
 		}
 		else {
 			snowmen[i]->bJumping = false;
@@ -1461,27 +1720,23 @@ void updateSnowman() {
 	}
 
 	for (int i = 0; i < 6; i += 2) {
+		// The arm is a child of the body and follows it
 		auto snowman = snowmen[i];
-		auto snowmanArm = snowmen[i + 1];
 
 		auto transform = glm::rotate(snowman->getTransform(), glm::radians(snowmenRollRate[i / 2] * frameTime), glm::vec3(0.0f, 0.0f, 1.0f));
 
 		if (toggleSnowmanAnimation)
 		{
 			snowman->setTransform(transform);
-			snowmanArm->setTransform(transform);
 			snowman->roll += snowmenRollRate[i / 2] * frameTime;
-			snowmanArm->roll += snowmenRollRate[i / 2] * frameTime;
 
 			if (snowman->roll > 5.0f) {
 				snowman->roll = 5.0f;
-				snowmanArm->roll = 5.0f;
 				snowmenRollRate[i / 2] = -snowmenRollRate[i / 2];
 			}
 
 			if (snowman->roll < -5.0f) {
 				snowman->roll = -5.0f;
-				snowmanArm->roll = -5.0f;
 				snowmenRollRate[i / 2] = -snowmenRollRate[i / 2];
 			}
 		}
@@ -1493,7 +1748,6 @@ void updateSnowman() {
 		position += activeSnowmanVelocity;
 
 		activeSnowman->setPosition(position);
-		activeSnowmanArm->setPosition(position);
 	}
 }
 
@@ -1545,43 +1799,6 @@ void updateSkybox() {
 	}
 }
 
-void updateSmoke() {
-
-	for (auto j = 0; j < 2; j++) {
-		auto& smokes = smokesGroup[j];
-
-		for (int32_t i = 0; i < static_cast<int32_t>(smokes.size()); i++) {
-			auto positon = smokes[i]->getPosition();
-			positon.y += frameTime;
-			smokes[i]->setPosition(positon);
-
-			auto scale = smokes[i]->getScale();
-
-			scale += frameTime / (i + 1);
-			smokes[i]->setScale(scale);
-
-			smokeTimers[i] += frameTime;
-
-			if (smokes[i]->getPosition().y >= 7.0f)
-			{
-				//smokes.erase(smokes.begin());
-				//auto smoke = createSmoke(0.125f, smokeSpwanPositions[i]);
-				auto smokeSpawnPosition = glm::vec3(0.0);
-
-				if (j == 0) {
-					smokeSpawnPosition = smokeSpawnPositions1[2];
-				}
-				else {
-					smokeSpawnPosition = smokeSpawnPositions2[2];
-				}
-				smokes[i]->setScale(glm::vec3(1.0f));
-				smokes[i]->setPosition(smokeSpawnPosition);
-				smokeTimers[i] = 0.0f;
-			}
-		}
-	}
-}
-
 void updateChristmasTreeLight() {
 
 	lightTimer += frameTime;
@@ -1606,18 +1823,17 @@ void updateChristmasTreeLight() {
 
 void updateParticles() {
 
-	for (auto iterator = particles.begin(); iterator != particles.end();) {
-		if (!(*iterator).update(frameTime)) {
-			iterator = particles.erase(iterator);
-		}
-		else {
-			iterator++;
-		}
-	}
+	double startSeconds = glfwGetTime();
+
+	particles.update(frameTime);
+
+	float density = particleLod.getDensity();
 
-	if (particles.size() < 1500) {
-		spawnParticles(500);
+	if (particles.size() < static_cast<size_t>(1500.0f * density)) {
+		spawnParticles(static_cast<int32_t>(std::ceil(500.0f * density)));
 	}
+
+	particleCpuMilliseconds = (glfwGetTime() - startSeconds) * 1000.0;
 }
 
 void update() {
@@ -1650,20 +1866,16 @@ void update() {
 		timeStep += frameTime * 0.5f;
 		glm::vec3 vPoint = PointOnCurve(g_vStartPoint, g_vControlPoint1, g_vControlPoint2, g_vEndPoint, timeStep);
 		//movingSphere->setPosition(vPoint);
+		// Arm, flagpole and flag are children of the snowman
 		merryChristmasSnowman->setPosition(vPoint);
-		merryChristmasSnowmanArm->setPosition(vPoint);
-		flagpole->setPosition(vPoint);
-		flag->setPosition(vPoint);
 	}
 
 	if (!bPlayMerryChristmasAnimation && timeStep > 0.0f) {
 		timeStep -= frameTime * 0.5f;
 		glm::vec3 vPoint = PointOnCurve(g_vStartPoint, g_vControlPoint1, g_vControlPoint2, g_vEndPoint, timeStep);
 		//movingSphere->setPosition(vPoint);
+		// Arm, flagpole and flag are children of the snowman
 		merryChristmasSnowman->setPosition(vPoint);
-		merryChristmasSnowmanArm->setPosition(vPoint);
-		flagpole->setPosition(vPoint);
-		flag->setPosition(vPoint);
 	}
 
 	spherTimeStep += frameTime * 0.5f * sign;
@@ -1697,11 +1909,15 @@ void update() {
 
 	updateSkybox();
 
-	updateSmoke();
+	smoke.update(frameTime);
 
 	updateChristmasTreeLight();
 
-	updateParticles();
+	particleCpuMilliseconds = 0.0;
+
+	if (!bGpuParticles) {
+		updateParticles();
+	}
 
 	// Start the Dear ImGui frame
 	ImGui_ImplOpenGL3_NewFrame();
@@ -1718,9 +1934,65 @@ void renderImGui() {
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-void updateGlobalUniform() {
+void updateLightingUniform(const std::shared_ptr<Shader>& shader) {
 
-	sceneShader->use();
+	shader->use();
+
+	shader->setUniform("lights[0].color", lights[0].color);
+	shader->setUniform("lights[0].position", lights[0].position);
+	shader->setUniform("lights[0].intensity", lights[0].intensity);
+	shader->setUniform("lights[0].Kc", lights[0].Kc);
+	shader->setUniform("lights[0].Kl", lights[0].Kl);
+	shader->setUniform("lights[0].Kq", lights[0].Kq);
+	//shader->setUniform("lights[0].type", lights[0].type);
+
+	shader->setUniform("lights[1].color", lights[1].color);
+	shader->setUniform("lights[1].position", lights[1].position);
+	shader->setUniform("lights[1].intensity", lights[1].intensity);
+	shader->setUniform("lights[1].Kc", lights[1].Kc);
+	shader->setUniform("lights[1].Kl", lights[1].Kl);
+	shader->setUniform("lights[1].Kq", lights[1].Kq);
+	//shader->setUniform("lights[1].type", lights[1].type);
+
+	shader->setUniform("lights[2].color", lights[2].color);
+	shader->setUniform("lights[2].position", lights[2].position);
+	shader->setUniform("lights[2].intensity", lights[2].intensity);
+	shader->setUniform("lights[2].Kc", lights[2].Kc);
+	shader->setUniform("lights[2].Kl", lights[2].Kl);
+	shader->setUniform("lights[2].Kq", lights[2].Kq);
+	//shader->setUniform("lights[2].type", lights[2].type);
+
+	shader->setUniform("lights[3].color", lights[3].color);
+	shader->setUniform("lights[3].position", lights[3].position);
+	shader->setUniform("lights[3].intensity", lights[3].intensity);
+	//shader->setUniform("lights[3].type", lights[3].type);
+
+	shader->setUniform("lights[4].color", lights[4].color);
+	shader->setUniform("lights[4].position", lights[4].position);
+	shader->setUniform("lights[4].direction", lights[4].direction);
+	//shader->setUniform("lights[4].exponent", lights[4].exponent);
+	shader->setUniform("lights[4].cutoff", glm::cos(glm::radians(lights[4].cutoff)));
+	shader->setUniform("lights[4].outerCutoff", glm::cos(glm::radians(lights[4].outerCutoff)));
+	shader->setUniform("lights[4].intensity", lights[4].intensity);
+	//shader->setUniform("lights[4].type", lights[4].type);
+
+	//shader->setUniform("fog.minDistance", fog.minDistance);
+	//shader->setUniform("fog.maxDistance", fog.maxDistance);
+	shader->setUniform("fog.density", fog.density);
+	shader->setUniform("fog.color", fog.color);
+
+	shader->setUniform("skybox1", currentSkybox->getTextureIndex());
+
+	shader->setUniform("eye", mainCamera.getEye());
+
+	shader->setUniform("projectorTransform", projectorTransform);
+
+	//shader->setUniform("projection", getTexture("Projection")->getTextureIndex());
+
+	shader->setUniform("ambientIntensity", ambientIntensity);
+}
+
+void updateGlobalUniform() {
 
 	for (auto i = 0; i < 5; i++)
 	{
@@ -1734,60 +2006,7 @@ void updateGlobalUniform() {
 		}
 	}
 
-	sceneShader->setUniform("lights[0].color", lights[0].color);
-	sceneShader->setUniform("lights[0].position", lights[0].position);
-	sceneShader->setUniform("lights[0].intensity", lights[0].intensity);
-	sceneShader->setUniform("lights[0].Kc", lights[0].Kc);
-	sceneShader->setUniform("lights[0].Kl", lights[0].Kl);
-	sceneShader->setUniform("lights[0].Kq", lights[0].Kq);
-	//sceneShader->setUniform("lights[0].type", lights[0].type);
-
-	sceneShader->setUniform("lights[1].color", lights[1].color);
-	sceneShader->setUniform("lights[1].position", lights[1].position);
-	sceneShader->setUniform("lights[1].intensity", lights[1].intensity);
-	sceneShader->setUniform("lights[1].Kc", lights[1].Kc);
-	sceneShader->setUniform("lights[1].Kl", lights[1].Kl);
-	sceneShader->setUniform("lights[1].Kq", lights[1].Kq);
-	//sceneShader->setUniform("lights[1].type", lights[1].type);
-
-	sceneShader->setUniform("lights[2].color", lights[2].color);
-	sceneShader->setUniform("lights[2].position", lights[2].position);
-	sceneShader->setUniform("lights[2].intensity", lights[2].intensity);
-	sceneShader->setUniform("lights[2].Kc", lights[2].Kc);
-	sceneShader->setUniform("lights[2].Kl", lights[2].Kl);
-	sceneShader->setUniform("lights[2].Kq", lights[2].Kq);
-	//sceneShader->setUniform("lights[2].type", lights[2].type);
-
-	sceneShader->setUniform("lights[3].color", lights[3].color);
-	sceneShader->setUniform("lights[3].position", lights[3].position);
-	sceneShader->setUniform("lights[3].intensity", lights[3].intensity);
-	//sceneShader->setUniform("lights[3].type", lights[3].type);
-
-	sceneShader->setUniform("lights[4].color", lights[4].color);
-	sceneShader->setUniform("lights[4].position", lights[4].position);
-	sceneShader->setUniform("lights[4].direction", lights[4].direction);
-	//sceneShader->setUniform("lights[4].exponent", lights[4].exponent);
-	sceneShader->setUniform("lights[4].cutoff", glm::cos(glm::radians(lights[4].cutoff)));
-	sceneShader->setUniform("lights[4].outerCutoff", glm::cos(glm::radians(lights[4].outerCutoff)));
-	sceneShader->setUniform("lights[4].intensity", lights[4].intensity);
-	//sceneShader->setUniform("lights[4].type", lights[4].type);
-
-	//sceneShader->setUniform("fog.minDistance", fog.minDistance);
-	//sceneShader->setUniform("fog.maxDistance", fog.maxDistance);
-	sceneShader->setUniform("fog.density", fog.density);
-	sceneShader->setUniform("fog.color", fog.color);
-
-	sceneShader->setUniform("skybox1", currentSkybox->getTextureIndex());
-
-	sceneShader->setUniform("eye", mainCamera.getEye());
-
-	sceneShader->setUniform("projectorTransform", projectorTransform);
-
-	//sceneShader->setUniform("projection", getTexture("Projection")->getTextureIndex());
-
-	sceneShader->setUniform("showProjector", bShowProjector);
-
-	sceneShader->setUniform("ambientIntensity", ambientIntensity);
+	sceneShader->use();
 }
 
 void drawSkybox(const glm::mat4& inViewMatrix, const glm::mat4& inProjectionMatrix) {
@@ -1843,65 +2062,19 @@ void drawLights(const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMat
 	sceneShader->use();
 }
 
-void updateMaterialUniform(const std::shared_ptr<Material>& material) {
+void updateMaterialUniform(const std::shared_ptr<Shader>& shader, const Material* material) {
 
 	if (material) {
-		sceneShader->setUniform("material.Ka", material->Ka);
-		sceneShader->setUniform("material.Kd", material->Kd);
-		sceneShader->setUniform("material.Ks", material->Ks);
-		sceneShader->setUniform("material.Ke", material->Ke);
-		sceneShader->setUniform("material.shininess", material->shininess);
-		sceneShader->setUniform("material.reflectionFactor", material->reflectionFactor);
-		sceneShader->setUniform("material.refractionFactor", material->refractionFactor);
-		//sceneShader->setUniform("material.ior", material->ior);
-		//sceneShader->setUniform("material.eta", material->eta);
-		sceneShader->setUniform("material.hasNormalMap", material->hasNormalMap);
-	}
-}
-
-void drawModel(const std::shared_ptr<Model>& model, const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
-
-	for (auto& mesh : model->getMeshes()) {
-		mesh->use();
-
-		auto material = mesh->getMaterial();
-
-		updateMaterialUniform(material);
-
-		sceneShader->setUniform("textures[0]", mesh->getTextureIndex(0));
-		sceneShader->setUniform("textures[1]", mesh->getTextureIndex(1));
-		sceneShader->setUniform("lightSpaceMatrix", lightSpaceMatrix);
-		sceneShader->setUniform("shadowMap", depthMapTexture->getTextureIndex());
-		sceneShader->setUniform("shadowmapBias", shadowmapBias);
-		// TODO: 延迟渲染的时候记得取消注释
-		//sceneShader->setUniform("material.Kd", glm::vec3(0.270588f, 0.552941f, 0.874510f));
-
-		glm::mat4 worldMatrix = model->getTransform();
-		worldMatrix = glm::scale(worldMatrix, glm::vec3(1.0f, 1.0f, globalScale));
-		glm::mat4 mvpMatrix = inProjectionMatrix * inViewMaterix * worldMatrix;
-
-		sceneShader->setUniform("worldMatrix", worldMatrix);
-		//sceneShader->setUniform("viewMatrix", inViewMaterix);
-		sceneShader->setUniform("mvpMatrix", mvpMatrix);
-		sceneShader->setUniform("projectionMatrix", inProjectionMatrix);
-		//sceneShader->setUniform("normalMatrix", glm::transpose(glm::inverse(worldMatrix)));
-		sceneShader->setUniform("normalMatrix", worldMatrix);
-
-		glDrawElements(GL_TRIANGLES, mesh->getIndexCount(), GL_UNSIGNED_INT, 0);
-	}
-}
-
-void drawDepthModel(const std::shared_ptr<Model>& model, const glm::mat4& inLightSpaceMatrix) {
-
-	for (auto& mesh : model->getMeshes()) {
-		mesh->use();
-
-		glm::mat4 worldMatrix = model->getTransform();
-
-		depthShader->setUniform("model", worldMatrix);
-		depthShader->setUniform("lightSpaceMatrix", inLightSpaceMatrix);
-
-		glDrawElements(GL_TRIANGLES, mesh->getIndexCount(), GL_UNSIGNED_INT, 0);
+		shader->setUniform("material.Ka", material->Ka);
+		shader->setUniform("material.Kd", material->Kd);
+		shader->setUniform("material.Ks", material->Ks);
+		shader->setUniform("material.Ke", material->Ke);
+		shader->setUniform("material.shininess", material->shininess);
+		shader->setUniform("material.reflectionFactor", material->reflectionFactor);
+		shader->setUniform("material.refractionFactor", material->refractionFactor);
+		// The deferred path reads these from its material table, see GBufferMaterial
+		shader->setUniform("material.ior", material->ior);
+		shader->setUniform("material.eta", material->eta);
 	}
 }
 
@@ -1912,7 +2085,7 @@ void drawRenderWindow(const std::shared_ptr<Model>& model, const glm::mat4& inVi
 
 		textureShader->setUniform("albedo", sceneTexture->getTextureIndex());
 
-		glm::mat4 worldMatrix = model->getTransform();
+		glm::mat4 worldMatrix = model->getWorldTransform();
 		glm::mat4 mvpMatrix = inProjectionMatrix * inViewMaterix * worldMatrix;
 
 		textureShader->setUniform("worldMatrix", worldMatrix);
@@ -1923,56 +2096,6 @@ void drawRenderWindow(const std::shared_ptr<Model>& model, const glm::mat4& inVi
 	}
 }
 
-void drawModels(const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
-
-	sceneShader->use();
-	sceneShader->setUniform("drawSkybox", false);
-
-	for (size_t i = 1; i < models.size(); i++) {
-		drawModel(models[i], inViewMaterix, inProjectionMatrix);
-	}
-}
-
-void drawDepthModels(const glm::mat4& inLightSpaceMatrix) {
-
-	for (size_t i = 1; i < models.size(); i++) {
-		drawDepthModel(models[i], inLightSpaceMatrix);
-	}
-}
-
-void drawSmokes(const std::vector<std::shared_ptr<Model>>& inMmodels, glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
-
-	for (size_t i = 0; i < inMmodels.size(); i++) {
-		drawModel(inMmodels[i], inViewMaterix, inProjectionMatrix);
-	}
-}
-
-void drawDepthSmokes(const std::vector<std::shared_ptr<Model>>& inMmodels, const glm::mat4& inLightSpaceMatrix) {
-
-	for (size_t i = 0; i < inMmodels.size(); i++) {
-		drawDepthModel(inMmodels[i], inLightSpaceMatrix);
-	}
-}
-
-void drawChristmasTreeBall(const std::shared_ptr<Model>& model, const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix, bool bLight = false, const glm::vec4& lightColor = glm::vec4(1.0f)) {
-
-	for (auto& mesh : model->getMeshes()) {
-		mesh->use();
-
-		decorationShader->setUniform("albedo", mesh->getTextureIndex(0));
-		decorationShader->setUniform("bLight", bLight);
-		decorationShader->setUniform("lightColor", lightColor);
-
-		glm::mat4 worldMatrix = model->getTransform();
-		glm::mat4 mvpMatrix = inProjectionMatrix * inViewMaterix * worldMatrix;
-
-		decorationShader->setUniform("worldMatrix", worldMatrix);
-		decorationShader->setUniform("mvpMatrix", mvpMatrix);
-
-		glDrawElements(GL_TRIANGLES, mesh->getIndexCount(), GL_UNSIGNED_INT, 0);
-	}
-}
-
 void drawNormals(const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
 
 	lightCubeShader->use();
@@ -1980,7 +2103,7 @@ void drawNormals(const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMa
 	lightCubeShader->setUniform("color", glm::vec4(0.270588f, 0.552941f, 0.874510f, 1.0f));
 
 	for (size_t i = 1; i < models.size(); i++) {
-		glm::mat4 worldMatrix = models[i]->getTransform();
+		glm::mat4 worldMatrix = models[i]->getWorldTransform();
 		for (auto& mesh : models[i]->getMeshes()) {
 			mesh->useNormal();
 
@@ -2002,71 +2125,668 @@ void clear(Vec4f color, int32_t clearFlag) {
 //    glClear(clearFlag);
 //}
 
-void drawScene(glm::mat4 viewMatrix, glm::mat4 projectionMatrix) {
+// Everything drawn through the render queue, in draw order. The shadow pass
+// takes the shadow casters out of the same list.
+void gatherRenderItems() {
+
+	renderItems.clear();
+
+	auto addItem = [](const std::shared_ptr<Model>& model, bool bCastShadow) {
+		RenderItem item;
+		item.model = model.get();
+		item.transform = transformStage.addInstance(model->getWorldTransform(), true);
+		item.bCastShadow = bCastShadow;
+		item.bDynamic = model->bDynamic;
+		renderItems.push_back(item);
+	};
+
+	auto addBall = [](const std::shared_ptr<Model>& model, bool bLight, const glm::vec4& lightColor) {
+		RenderItem item;
+		item.model = model.get();
+		item.transform = transformStage.addInstance(model->getWorldTransform());
+		item.pipeline = DrawPipeline::Decoration;
+		item.bCastShadow = false;
+		item.bLight = bLight;
+		item.lightColor = lightColor;
+		renderItems.push_back(item);
+	};
 
-	drawModels(viewMatrix, projectionMatrix);
-	drawSmokes(smokesGroup[0], viewMatrix, projectionMatrix);
-	drawSmokes(smokesGroup[1], viewMatrix, projectionMatrix);
+	for (size_t i = 1; i < models.size(); i++) {
+		addItem(models[i], true);
+	}
 
-	drawModel(merryChristmasSnowman, viewMatrix, projectionMatrix);
-	drawModel(merryChristmasSnowmanArm, viewMatrix, projectionMatrix);
+	addItem(merryChristmasSnowman, false);
+	addItem(merryChristmasSnowmanArm, false);
 
-	drawModel(flagpole, viewMatrix, projectionMatrix);
-	drawModel(flag, viewMatrix, projectionMatrix);
+	addItem(flagpole, false);
+	addItem(flag, false);
 
-	decorationShader->use();
 	for (auto i = 0; i < 6; i++) {
 		bool bActivated = bActivatedChristmasTreeLight[i];
 
-		if (bActivated) {
-			drawChristmasTreeBall(redBalls[i], viewMatrix, projectionMatrix, bToggleChirstmasTreeLights[i][0], glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
-			drawChristmasTreeBall(goldenBalls[i], viewMatrix, projectionMatrix, bToggleChirstmasTreeLights[i][1], glm::vec4(1.0f, 0.93f, 0.39f, 1.0f));
-			drawChristmasTreeBall(purpleBalls[i], viewMatrix, projectionMatrix, bToggleChirstmasTreeLights[i][2], glm::vec4(0.94f, 0.55f, 0.92f, 1.0f));
-		}
-		else {
-			drawChristmasTreeBall(redBalls[i], viewMatrix, projectionMatrix, false, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
-			drawChristmasTreeBall(goldenBalls[i], viewMatrix, projectionMatrix, false, glm::vec4(1.0f, 0.93f, 0.39f, 1.0f));
-			drawChristmasTreeBall(purpleBalls[i], viewMatrix, projectionMatrix, false, glm::vec4(0.94f, 0.55f, 0.92f, 1.0f));
-		}
+		addBall(redBalls[i], bActivated && bToggleChirstmasTreeLights[i][0], glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+		addBall(goldenBalls[i], bActivated && bToggleChirstmasTreeLights[i][1], glm::vec4(1.0f, 0.93f, 0.39f, 1.0f));
+		addBall(purpleBalls[i], bActivated && bToggleChirstmasTreeLights[i][2], glm::vec4(0.94f, 0.55f, 0.92f, 1.0f));
 	}
-	sceneShader->use();
+
+	addItem(leftHouse, true);
+	addItem(rightHouse, true);
 }
 
-void renderToTexture(uint32_t width = 512, uint32_t height = 512) {
+// Camera facing, spinning quad of a snowflake
+glm::mat4 getParticleWorldMatrix(const glm::vec3& position, float rotationDegrees, float size = 0.3f) {
 
-	// Bind to texture's FBO
-	glBindFramebuffer(GL_FRAMEBUFFER, renderSceneFBO);
-	glViewport(0, 0, width, height); // Viewport for the texture
+	auto forward = glm::normalize(mainCamera.getEye() - position);
+	auto up = glm::vec3(0.0f, 1.0f, 0.0f);
+	auto right = glm::cross(forward, up);
 
-	glm::mat4 viewMatrix = mainCamera.getViewMatrix();
-	mainCamera.perspective(fov, aspect, nearPlane, farPlane);
-	glm::mat4 projectionMatrix = mainCamera.getProjectionMatrix();
+	//up = glm::cross(right, forward);
 
-	clear(clearColor, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	auto rotation = glm::transpose(glm::mat3(right, up, forward));
+	auto yawTransform = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(rotationDegrees), forward));
 
-	sceneShader->setUniform("skybox1", currentSkybox->getTextureIndex());
-	skyboxShader->setUniform("skybox1", currentSkybox->getTextureIndex());
+	glm::mat4 worldMatrix = glm::mat4(rotation * yawTransform * size);
+	worldMatrix[3] = glm::vec4(position, 1.0f);
 
-	drawSkybox(viewMatrix, projectionMatrix);
-	drawScene(viewMatrix, projectionMatrix);
+	return worldMatrix;
+}
 
-	//drawModel(teapot, viewMatrix, projectionMatrix);
-	//drawModel(cubemapSphere, viewMatrix, projectionMatrix);
-	drawModel(terrain, viewMatrix, projectionMatrix);
+// Flakes outside the camera frustum or thinned out by the LOD get no
+// transform and no draw
+void gatherParticleTransforms(const glm::mat4& viewProjection) {
 
-	//drawLights(viewMatrix, projectionMatrix);
+	firstParticleTransform = static_cast<uint32_t>(transformStage.getInstanceCount());
+	visibleParticleCount = 0;
 
-	//reflectionTextureShader->use();
-	//drawReflectionModel(reflectionFloor, viewMatrix, projectionMatrix);
+	if (!bDrawParticles || bGpuParticles) {
+		return;
+	}
 
-	// Unbind texture's FBO (back to default FB)
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	double startSeconds = glfwGetTime();
 
-	sceneShader->use();
-}
+	Frustum frustum(viewProjection);
+	glm::vec3 eye = mainCamera.getEye();
+	float maxRadius = 0.3f * particleLod.getSizeScale(particleLod.getKeepFraction(std::numeric_limits<float>::max()));
 
-//void drawScreenQuad(const std::shared_ptr<Texture>& renderTexture) {
-//    screenQuadShader->use();
+	for (size_t i = 0; i < particles.size(); i++) {
+		auto position = particles.getPosition(i);
+
+		if (!frustum.intersectsSphere(position, maxRadius)) {
+			continue;
+		}
+
+		float keepFraction = particleLod.getKeepFraction(glm::distance(eye, position));
+
+		if (ParticleLod::getFlakeKey(particles.getGravityEffect(i)) >= keepFraction) {
+			continue;
+		}
+
+		float size = 0.3f * particleLod.getSizeScale(keepFraction);
+
+		transformStage.addInstance(getParticleWorldMatrix(position, particles.getRotation(i), size));
+		visibleParticleCount++;
+	}
+
+	particleCpuMilliseconds += (glfwGetTime() - startSeconds) * 1000.0;
+}
+
+void gatherPointLights() {
+
+	pointLights.clear();
+
+	const glm::vec3 colors[3] = { { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.93f, 0.39f }, { 0.94f, 0.55f, 0.92f } };
+
+	for (auto i = 0; i < 6; i++) {
+		if (!bActivatedChristmasTreeLight[i]) {
+			continue;
+		}
+
+		const std::shared_ptr<Model> balls[3] = { redBalls[i], goldenBalls[i], purpleBalls[i] };
+
+		for (auto j = 0; j < 3; j++) {
+			if (!bToggleChirstmasTreeLights[i][j]) {
+				continue;
+			}
+
+			const auto& worldMatrix = balls[j]->getWorldTransform();
+
+			for (const auto& center : ornamentLightCenters[j]) {
+				PointLight light;
+				light.positionRadius = glm::vec4(glm::vec3(worldMatrix * glm::vec4(center, 1.0f)), ornamentLightRadius);
+				light.color = glm::vec4(colors[j] * ornamentLightIntensity, 1.0f);
+				pointLights.push_back(light);
+			}
+		}
+	}
+}
+
+void updateStaticShadowState() {
+
+	// FNV-1a over which static casters are visible and the versions of their
+	// world transforms, so a caster moving or swapped for another is seen too
+	uint64_t casterHash = 14695981039346656037ull;
+
+	auto addToHash = [&casterHash](uint64_t value) {
+		for (int32_t i = 0; i < 8; i++) {
+			casterHash = (casterHash ^ ((value >> (i * 8)) & 0xFF)) * 1099511628211ull;
+		}
+	};
+
+	for (const auto& item : renderItems) {
+		if (item.bCastShadow && !item.bDynamic && item.model->bVisible) {
+			addToHash(reinterpret_cast<uintptr_t>(item.model));
+			addToHash(item.model->getWorldVersion());
+		}
+	}
+
+	bool bCastersChanged = casterHash != staticShadowCasterHash;
+	staticShadowCasterHash = casterHash;
+
+	for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+		const auto& lightSpaceMatrix = shadowCascades.getCascade(i).lightSpaceMatrix;
+
+		if (bCastersChanged || lightSpaceMatrix != staticShadowLightSpaceMatrices[i]) {
+			staticShadowLightSpaceMatrices[i] = lightSpaceMatrix;
+			bStaticShadowDirty[i] = true;
+		}
+	}
+}
+
+// Runs the transform stage and builds the shadow and camera draw lists on the
+// thread pool
+void buildDrawLists(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+
+	transformStage.clear();
+
+	gatherRenderItems();
+	gatherParticleTransforms(projectionMatrix * viewMatrix);
+
+	shadowCascades.update(shadowLightDirection, viewMatrix, fov, aspect, nearPlane, std::min(shadowDistance, farPlane));
+
+	updateStaticShadowState();
+
+	renderPasses.resize(RenderPassCount);
+
+	for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+		const auto& cascade = shadowCascades.getCascade(i);
+
+		auto& staticPass = renderPasses[StaticShadowPass + i];
+		staticPass.viewMatrix = cascade.viewMatrix;
+		staticPass.projectionMatrix = cascade.projectionMatrix;
+		staticPass.bDepthOnly = true;
+		staticPass.casters = ShadowCasters::Static;
+		staticPass.bEnabled = bStaticShadowDirty[i];
+
+		auto& dynamicPass = renderPasses[ShadowPass + i];
+		dynamicPass.viewMatrix = cascade.viewMatrix;
+		dynamicPass.projectionMatrix = cascade.projectionMatrix;
+		dynamicPass.bDepthOnly = true;
+		dynamicPass.casters = ShadowCasters::Dynamic;
+	}
+
+	renderPasses[CameraPass].viewMatrix = viewMatrix;
+	renderPasses[CameraPass].projectionMatrix = projectionMatrix;
+
+	transformViews.resize(RenderPassCount);
+
+	for (size_t pass = 0; pass < RenderPassCount; pass++) {
+		transformViews[pass].viewProjection = renderPasses[pass].projectionMatrix * renderPasses[pass].viewMatrix;
+	}
+
+	transformViews[CameraPass].modelScale = glm::vec3(1.0f, 1.0f, globalScale);
+
+	std::vector<glm::mat4> viewProjections;
+
+	for (const auto& view : transformViews) {
+		viewProjections.push_back(view.viewProjection);
+	}
+
+	terrain.update(threadPool, mainCamera.getEye(), viewProjections);
+
+	transformStage.compute(threadPool, transformViews);
+
+	renderQueue.build(threadPool, transformStage, renderItems, renderPasses);
+
+	gatherPointLights();
+
+	lightClusters.build(threadPool, pointLights, viewMatrix, fov, aspect, nearPlane, std::min(clusterDistance, farPlane));
+}
+
+// The caller has bound an INSTANCED variant and set its view uniforms
+void drawSmokeInstances(Shader& shader, size_t pass, bool bDepthOnly) {
+
+	const auto& mesh = smokePuff->getMeshes()[0];
+
+	if (!bDepthOnly) {
+		shader.setUniform("diffuseLayer", mesh->getTextureLayer(0));
+		shader.setUniform("normalLayer", mesh->getTextureLayer(1));
+	}
+
+	shader.setUniform("modelScale", transformViews[pass].modelScale);
+
+	glBindVertexArray(bDepthOnly ? mesh->getDepthVertexArray() : mesh->getVertexArray());
+
+	smoke.draw(shader, Frustum(transformViews[pass].viewProjection), mesh->getIndexCount(), mesh->getBoundingSphere().w);
+}
+
+// The caller has bound a TERRAIN variant
+void drawTerrain(Shader& shader, size_t pass, bool bDepthOnly) {
+
+	if (!bDepthOnly) {
+		shader.setUniform("diffuseLayer", glm::ivec2(terrainTexture.array, terrainTexture.layer));
+		shader.setUniform("normalLayer", glm::ivec2(0));
+	}
+
+	terrain.draw(shader, pass);
+}
+
+void drawDepthCommands(size_t pass) {
+
+	depthShader->use();
+
+	uint32_t vertexArray = 0;
+
+	for (const auto& drawList : renderQueue.getDrawLists(pass)) {
+		for (const auto& command : drawList) {
+			// Ornaments don't cast shadows and are drawn after the depth
+			// pre-pass with depth writes on
+			if (command.pipeline != DrawPipeline::Scene) {
+				continue;
+			}
+
+			if (command.depthVertexArray != vertexArray) {
+				vertexArray = command.depthVertexArray;
+				glBindVertexArray(vertexArray);
+			}
+
+			depthShader->setUniform("mvpMatrix", transformStage.get(pass, command.transform).mvpMatrix);
+
+			glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, 0);
+		}
+	}
+
+	const auto& passView = renderPasses[pass];
+
+	// The terrain is drawn with the dynamic casters: its nodes change as the
+	// camera moves and its vertices morph with the camera's distance, so only
+	// depth from this frame matches what the camera pass draws
+	if (passView.casters != ShadowCasters::Static) {
+		const auto& shader = depthVariants->get(depthVariants->getFeatureBit("TERRAIN"));
+		shader->use();
+		drawTerrain(*shader, pass, true);
+		depthShader->use();
+	}
+
+	// Smoke moves every frame and stays out of the camera pre-pass, it is
+	// drawn with depth writes on in drawCommands instead
+	if (passView.bDepthOnly && passView.bEnabled && passView.casters != ShadowCasters::Static) {
+		const auto& shader = depthVariants->get(depthVariants->getFeatureBit("INSTANCED"));
+		shader->use();
+		shader->setUniform("viewProjection", transformViews[pass].viewProjection);
+		drawSmokeInstances(*shader, pass, true);
+		depthShader->use();
+	}
+}
+
+// Shadow and point light uniforms of a pass, for the shaders that include
+// lighting.glsl
+void updatePassLightingUniform(const std::shared_ptr<Shader>& shader, size_t pass) {
+
+	shader->use();
+
+	for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+		const auto& cascade = shadowCascades.getCascade(i);
+		shader->setUniform("cascadeMatrices[" + std::to_string(i) + "]", cascade.lightSpaceMatrix);
+		shader->setUniform("cascadeSplits[" + std::to_string(i) + "]", cascade.splitDistance);
+	}
+
+	shader->setUniform("viewMatrix", renderPasses[pass].viewMatrix);
+	shader->setUniform("shadowMap", depthMapTexture->getTextureIndex());
+	shader->setUniform("shadowmapBias", shadowmapBias);
+	shader->setUniform("shadowMapCompare", shadowFilter.getCompareUnit());
+	shader->setUniform("shadowMoments", shadowFilter.getMomentsUnit());
+	shader->setUniform("shadowExponent", shadowFilter.exponent);
+	shader->setUniform("lightBleedingReduction", shadowFilter.lightBleedingReduction);
+	shader->setUniform("clusterNear", lightClusters.getNearPlane());
+	shader->setUniform("clusterFar", lightClusters.getFarPlane());
+	shader->setUniform("clusterTanHalfFov", lightClusters.getTanHalfFov());
+}
+
+// Variant features that hold for every draw of a pass
+uint32_t getPassFeatures(const ShaderVariants& variants) {
+
+	uint32_t features = 0;
+
+	switch (static_cast<ShadowFilterMode>(shadowFilterMode)) {
+	case ShadowFilterMode::Hardware:
+		features |= variants.getFeatureBit("HARDWARE_SHADOWS");
+		break;
+	case ShadowFilterMode::Variance:
+		features |= variants.getFeatureBit("VARIANCE_SHADOWS");
+		break;
+	case ShadowFilterMode::Exponential:
+		features |= variants.getFeatureBit("EXPONENTIAL_SHADOWS");
+		break;
+	default:
+		break;
+	}
+
+	if (!pointLights.empty()) {
+		features |= variants.getFeatureBit("POINT_LIGHTS");
+	}
+
+	if (bShowProjector) {
+		features |= variants.getFeatureBit("PROJECTOR");
+	}
+
+	return features;
+}
+
+// Per material variant features, the bits are looked up once per pass
+struct SurfaceFeatureBits {
+	explicit SurfaceFeatureBits(const ShaderVariants& variants)
+		: normalMap(variants.getFeatureBit("NORMAL_MAP")), doubleSided(variants.getFeatureBit("DOUBLE_SIDED")) {
+	}
+
+	uint32_t get(const Material* material) const {
+		if (!material) {
+			return doubleSided;
+		}
+
+		return (material->hasNormalMap ? normalMap : 0) | (material->bDoubleSided ? doubleSided : 0);
+	}
+
+	uint32_t normalMap;
+	uint32_t doubleSided;
+};
+
+// bDecorationOnly skips the scene pipeline, which the deferred path has
+// already drawn into the G-buffer. bDepthPrepassed draws the scene pipeline
+// against the pre-pass depth instead of writing its own.
+void drawCommands(size_t pass, const glm::mat4& inProjectionMatrix, bool bDecorationOnly = false, bool bDepthPrepassed = false) {
+
+	uint32_t passFeatures = getPassFeatures(*sceneVariants);
+	SurfaceFeatureBits surfaceFeatures(*sceneVariants);
+
+	// Current scene variant, null after switching to another program
+	std::shared_ptr<Shader> shader;
+	// Uniforms stay with each program, so a variant gets the pass uniforms
+	// the first time it is used in the pass
+	std::vector<Shader*> preparedVariants;
+	const Material* material = nullptr;
+
+	auto useSceneVariant = [&](const Material* commandMaterial, uint32_t extraFeatures = 0) {
+		const auto& variant = sceneVariants->get(passFeatures | surfaceFeatures.get(commandMaterial) | extraFeatures);
+
+		if (variant == shader) {
+			return;
+		}
+
+		shader = variant;
+		shader->use();
+
+		if (std::find(preparedVariants.begin(), preparedVariants.end(), shader.get()) == preparedVariants.end()) {
+			preparedVariants.push_back(shader.get());
+			updateLightingUniform(shader);
+			updatePassLightingUniform(shader, pass);
+			shader->setUniform("projectionMatrix", inProjectionMatrix);
+		}
+
+		// The cached material belongs to the previous program
+		material = nullptr;
+	};
+
+	auto setDepthState = [bDepthPrepassed](DrawPipeline drawPipeline) {
+		if (bDepthPrepassed) {
+			bool bScene = (drawPipeline == DrawPipeline::Scene);
+			glDepthFunc(bScene ? GL_EQUAL : GL_LESS);
+			glDepthMask(bScene ? GL_FALSE : GL_TRUE);
+		}
+	};
+
+	auto pipeline = DrawPipeline::Scene;
+	uint32_t vertexArray = 0;
+
+	setDepthState(pipeline);
+
+	for (const auto& drawList : renderQueue.getDrawLists(pass)) {
+		for (const auto& command : drawList) {
+			if (bDecorationOnly && command.pipeline != DrawPipeline::Decoration) {
+				continue;
+			}
+
+			if (command.pipeline != pipeline) {
+				pipeline = command.pipeline;
+				setDepthState(pipeline);
+
+				if (pipeline == DrawPipeline::Decoration) {
+					decorationShader->use();
+				}
+
+				shader = nullptr;
+			}
+
+			if (command.vertexArray != vertexArray) {
+				vertexArray = command.vertexArray;
+				glBindVertexArray(vertexArray);
+			}
+
+			const auto& transform = transformStage.get(pass, command.transform);
+
+			if (pipeline == DrawPipeline::Decoration) {
+				decorationShader->setUniform("albedoLayer", command.textureLayers[0]);
+				decorationShader->setUniform("bLight", command.bLight);
+				decorationShader->setUniform("lightColor", command.lightColor);
+				decorationShader->setUniform("worldMatrix", transform.worldMatrix);
+				decorationShader->setUniform("mvpMatrix", transform.mvpMatrix);
+			}
+			else {
+				useSceneVariant(command.material);
+
+				// Uniforms stay with the program, so only changes need uploading
+				if (command.material && command.material != material) {
+					material = command.material;
+					updateMaterialUniform(shader, material);
+				}
+
+				shader->setUniform("diffuseLayer", command.textureLayers[0]);
+				shader->setUniform("normalLayer", command.textureLayers[1]);
+				shader->setUniform("worldMatrix", transform.worldMatrix);
+				shader->setUniform("mvpMatrix", transform.mvpMatrix);
+				shader->setUniform("normalMatrix", transform.normalMatrix);
+			}
+
+			glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, 0);
+		}
+	}
+
+	if (!bDecorationOnly) {
+		setDepthState(DrawPipeline::Scene);
+
+		useSceneVariant(terrainMaterial.get(), sceneVariants->getFeatureBit("TERRAIN"));
+
+		if (terrainMaterial.get() != material) {
+			material = terrainMaterial.get();
+			updateMaterialUniform(shader, material);
+		}
+
+		drawTerrain(*shader, pass, false);
+	}
+
+	if (bDepthPrepassed) {
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+
+	if (!bDecorationOnly) {
+		const Material* puffMaterial = smokePuff->getMeshes()[0]->getMaterial().get();
+
+		useSceneVariant(puffMaterial, sceneVariants->getFeatureBit("INSTANCED"));
+
+		if (puffMaterial != material) {
+			material = puffMaterial;
+			updateMaterialUniform(shader, material);
+		}
+
+		drawSmokeInstances(*shader, pass, false);
+	}
+
+	sceneShader->use();
+}
+
+void drawDepthPrepass(size_t pass) {
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	drawDepthCommands(pass);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Geometry pass of the deferred path, scene pipeline only
+void drawGeometryCommands(size_t pass) {
+
+	SurfaceFeatureBits surfaceFeatures(*gbufferVariants);
+
+	gBuffer.clearMaterials();
+
+	std::shared_ptr<Shader> shader;
+	uint32_t vertexArray = 0;
+	int32_t materialId = -1;
+
+	for (const auto& drawList : renderQueue.getDrawLists(pass)) {
+		for (const auto& command : drawList) {
+			if (command.pipeline != DrawPipeline::Scene) {
+				continue;
+			}
+
+			if (command.vertexArray != vertexArray) {
+				vertexArray = command.vertexArray;
+				glBindVertexArray(vertexArray);
+			}
+
+			const auto& variant = gbufferVariants->get(surfaceFeatures.get(command.material));
+
+			if (variant != shader) {
+				shader = variant;
+				shader->use();
+				materialId = -1;
+			}
+
+			int32_t id = gBuffer.getMaterialId(command.material);
+
+			if (id != materialId) {
+				materialId = id;
+				shader->setUniform("materialId", materialId);
+			}
+
+			const auto& transform = transformStage.get(pass, command.transform);
+
+			shader->setUniform("diffuseLayer", command.textureLayers[0]);
+			shader->setUniform("normalLayer", command.textureLayers[1]);
+			shader->setUniform("worldMatrix", transform.worldMatrix);
+			shader->setUniform("mvpMatrix", transform.mvpMatrix);
+			shader->setUniform("normalMatrix", transform.normalMatrix);
+
+			glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, 0);
+		}
+	}
+
+	shader = gbufferVariants->get(surfaceFeatures.get(terrainMaterial.get()) | gbufferVariants->getFeatureBit("TERRAIN"));
+	shader->use();
+	shader->setUniform("materialId", gBuffer.getMaterialId(terrainMaterial.get()));
+	shader->setUniform("viewMatrix", renderPasses[pass].viewMatrix);
+	drawTerrain(*shader, pass, false);
+
+	const Material* puffMaterial = smokePuff->getMeshes()[0]->getMaterial().get();
+
+	shader = gbufferVariants->get(surfaceFeatures.get(puffMaterial) | gbufferVariants->getFeatureBit("INSTANCED"));
+	shader->use();
+	shader->setUniform("materialId", gBuffer.getMaterialId(puffMaterial));
+	shader->setUniform("viewMatrix", renderPasses[pass].viewMatrix);
+	shader->setUniform("projectionMatrix", renderPasses[pass].projectionMatrix);
+	drawSmokeInstances(*shader, pass, false);
+
+	gBuffer.uploadMaterials();
+}
+
+// Fills the G-buffer, then lights every covered pixel once. The lighting pass
+// writes the G-buffer depth, so the forward draws that follow are occluded
+// correctly.
+void renderDeferred(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+
+	gBuffer.resize(WindowWidth, WindowHeight);
+	gBuffer.bind();
+
+	// The albedo alpha holds the material id, it must not be blended
+	glDisable(GL_BLEND);
+
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	drawGeometryCommands(CameraPass);
+
+	glEnable(GL_BLEND);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, WindowWidth, WindowHeight);
+
+	clear(clearColor, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	drawSkybox(viewMatrix, projectionMatrix);
+
+	const auto& lightingShader = deferredVariants->get(getPassFeatures(*deferredVariants));
+
+	updateLightingUniform(lightingShader);
+	updatePassLightingUniform(lightingShader, CameraPass);
+
+	lightingShader->setUniform("gAlbedo", gBuffer.getAlbedoUnit());
+	lightingShader->setUniform("gNormal", gBuffer.getNormalUnit());
+	lightingShader->setUniform("gDepth", gBuffer.getDepthUnit());
+	lightingShader->setUniform("inverseViewProjection", glm::inverse(projectionMatrix * viewMatrix));
+
+	glDepthFunc(GL_ALWAYS);
+
+	glBindVertexArray(fullscreenTriangleVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glDepthFunc(GL_LESS);
+
+	drawCommands(CameraPass, projectionMatrix, true);
+}
+
+void renderToTexture(uint32_t width = 512, uint32_t height = 512) {
+
+	// Bind to texture's FBO
+	glBindFramebuffer(GL_FRAMEBUFFER, renderSceneFBO);
+	glViewport(0, 0, width, height); // Viewport for the texture
+
+	glm::mat4 viewMatrix = mainCamera.getViewMatrix();
+	mainCamera.perspective(fov, aspect, nearPlane, farPlane);
+	glm::mat4 projectionMatrix = mainCamera.getProjectionMatrix();
+
+	clear(clearColor, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	sceneShader->setUniform("skybox1", currentSkybox->getTextureIndex());
+	skyboxShader->setUniform("skybox1", currentSkybox->getTextureIndex());
+
+	// Same camera as the main view, so this frame's camera pass is reused
+	drawSkybox(viewMatrix, projectionMatrix);
+	drawCommands(CameraPass, projectionMatrix);
+
+	//drawLights(viewMatrix, projectionMatrix);
+
+	//reflectionTextureShader->use();
+	//drawReflectionModel(reflectionFloor, viewMatrix, projectionMatrix);
+
+	// Unbind texture's FBO (back to default FB)
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	sceneShader->use();
+}
+
+//void drawScreenQuad(const std::shared_ptr<Texture>& renderTexture) {
+//    screenQuadShader->use();
 //
 //    glBindVertexArray(screenQuadVAO);
 //
@@ -2090,49 +2810,23 @@ void drawScreenQuad(const std::shared_ptr<Texture>& renderTexture) {
 	screenQuadShader->setUniform("near_plane", 1.0f);
 	screenQuadShader->setUniform("far_plane", 7.5f);
 	screenQuadShader->setUniform("depthMap", renderTexture->getTextureIndex());
+	screenQuadShader->setUniform("layer", 0);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
-void drawParticle(const Particle& particle, const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
+void drawParticles(size_t pass) {
 
 	glBindVertexArray(particleQuadVAO);
 
 	particleShader->setUniform("albedo", snowflakesTexture->getTextureIndex());
 
-	auto forward = glm::normalize(mainCamera.getEye() - particle.getPosition());
-	auto up = glm::vec3(0.0f, 1.0f, 0.0f);
-	auto right = glm::cross(forward, up);
-
-	//up = glm::cross(right, forward);
-
-	auto rotation = glm::mat4(1.0);
-
-	rotation[0][0] = right.x;
-	rotation[1][0] = right.y;
-	rotation[2][0] = right.z;
-
-	rotation[0][1] = up.x;
-	rotation[1][1] = up.y;
-	rotation[2][1] = up.z;
+	for (size_t i = 0; i < visibleParticleCount; i++) {
+		const auto& transform = transformStage.get(pass, firstParticleTransform + static_cast<uint32_t>(i));
 
-	rotation[0][2] = forward.x;
-	rotation[1][2] = forward.y;
-	rotation[2][2] = forward.z;
+		particleShader->setUniform("mvpMatrix", transform.mvpMatrix);
 
-	auto yawTransform = glm::rotate(glm::mat4(1.0f), glm::radians(particle.getRotation()), forward);
-
-	glm::mat4 worldMatrix = glm::translate(glm::mat4(1.0f), particle.getPosition()) * rotation * yawTransform * glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-	glm::mat4 mvpMatrix = inProjectionMatrix * inViewMaterix * worldMatrix;
-
-	particleShader->setUniform("mvpMatrix", mvpMatrix);
-
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
-void drawParticles(const std::vector<Particle>& inPparticles, const glm::mat4& inViewMaterix, const glm::mat4& inProjectionMatrix) {
-	for (const auto& particle : inPparticles) {
-		drawParticle(particle, inViewMaterix, inProjectionMatrix);
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 	}
 }
 
@@ -2314,93 +3008,164 @@ void renderCube() {
 }
 
 
-void renderDepthMap() {
+void renderStaticDepthMap(int32_t cascade) {
 
-	depthShader->use();
-
-	//auto lightView = glm::lookAt(projectorPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	auto lightProjection = glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
-	//float near_plane = 1.0f, far_plane = 7.5f;
-	//auto lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-	//auto lightView = glm::lookAt(glm::vec3(-2.0f, 4.0f, -1.0f), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-	auto lightView = glm::lookAt(glm::vec3(-10.0f, 8.0f, -10.0f), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-
-	lightSpaceMatrix = lightProjection * lightView;
-	depthShader->setUniform("lightSpaceMatrix", lightSpaceMatrix);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthMapTexture->getTextureId(), 0, cascade);
 
-	glViewport(0, 0, ShadowMapWidth, SHadowMapHeight);
+	glClear(GL_DEPTH_BUFFER_BIT);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+	const auto& lightSpaceMatrix = shadowCascades.getCascade(cascade).lightSpaceMatrix;
 
-	glClear(GL_DEPTH_BUFFER_BIT);
 	glm::mat4 model = glm::mat4(1.0f);
 	// cubes
 	model = glm::mat4(1.0f);
 	model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
 	model = glm::scale(model, glm::vec3(0.5f));
-	depthShader->setUniform("model", model);
+	depthShader->setUniform("mvpMatrix", lightSpaceMatrix * model);
 	renderCube();
 	model = glm::mat4(1.0f);
 	model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
 	model = glm::scale(model, glm::vec3(0.5f));
-	depthShader->setUniform("model", model);
+	depthShader->setUniform("mvpMatrix", lightSpaceMatrix * model);
 	renderCube();
 	model = glm::mat4(1.0f);
 	model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
 	model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
 	model = glm::scale(model, glm::vec3(0.25));
-	depthShader->setUniform("model", model);
+	depthShader->setUniform("mvpMatrix", lightSpaceMatrix * model);
 	renderCube();
 
-	drawDepthModels(lightSpaceMatrix);
+	drawDepthCommands(StaticShadowPass + cascade);
+
+	bStaticShadowDirty[cascade] = false;
+}
+
+void renderDepthMap() {
+
+	depthShader->use();
 
-	drawDepthSmokes(smokesGroup[0], lightSpaceMatrix);
-	drawDepthSmokes(smokesGroup[1], lightSpaceMatrix);
+	glViewport(0, 0, ShadowMapWidth, SHadowMapHeight);
 
-	drawDepthModel(terrain, lightSpaceMatrix);
+	glBindFramebuffer(GL_FRAMEBUFFER, staticDepthMapFBO);
 
-	leftHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
-	rightHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
+	for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+		if (bStaticShadowDirty[i]) {
+			renderStaticDepthMap(i);
+		}
+	}
+
+	// Start from the cached static depth and only draw what moves on top
+	glCopyImageSubData(staticDepthMapTexture->getTextureId(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+					   depthMapTexture->getTextureId(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+					   ShadowMapWidth, SHadowMapHeight, ShadowCascadeCount);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
 
-	drawDepthModel(leftHouse, lightSpaceMatrix);
-	drawDepthModel(rightHouse, lightSpaceMatrix);
+	for (int32_t i = 0; i < ShadowCascadeCount; i++) {
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMapTexture->getTextureId(), 0, i);
+
+		drawDepthCommands(ShadowPass + i);
+	}
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	auto filterMode = static_cast<ShadowFilterMode>(shadowFilterMode);
+
+	if (ShadowFilter::isPrefiltered(filterMode)) {
+		shadowFilterTimer.begin();
+		glBindVertexArray(fullscreenTriangleVAO);
+		shadowFilter.prefilter(*shadowMomentsShader, depthMapTexture->getTextureIndex(), filterMode);
+		shadowFilterTimer.end();
+	}
+	else {
+		shadowFilterTimer.reset();
+	}
 }
 
 void renderScene()
 {
+	glm::mat4 viewMatrix = mainCamera.getViewMatrix();
+	mainCamera.perspective(fov, aspect, nearPlane, farPlane);
+	glm::mat4 projectionMatrix = mainCamera.getProjectionMatrix();
+
+	buildDrawLists(viewMatrix, projectionMatrix);
+
+	smoke.upload();
+	terrain.upload();
+
 	renderDepthMap();
 
+	lightClusters.upload();
+
 	updateGlobalUniform();
 
-	glViewport(0, 0, WindowWidth, WindowHeight);
-	glm::mat4 viewMatrix = mainCamera.getViewMatrix();
-	mainCamera.perspective(fov, aspect, nearPlane, farPlane);
-	glm::mat4 projectionMatrix = mainCamera.getProjectionMatrix();
+	sceneTimer.begin();
 
-	//auto viewMatrix = glm::lookAt(projectorPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	//auto projectionMatrix = glm::perspective(glm::radians(fov), aspect, near, far);
+	if (bDeferredShading) {
+		renderDeferred(viewMatrix, projectionMatrix);
+	}
+	else {
+		glViewport(0, 0, WindowWidth, WindowHeight);
 
-	clear(clearColor, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		//auto viewMatrix = glm::lookAt(projectorPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		//auto projectionMatrix = glm::perspective(glm::radians(fov), aspect, near, far);
 
-	drawSkybox(viewMatrix, projectionMatrix);
-	drawScene(viewMatrix, projectionMatrix);
+		clear(clearColor, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		drawSkybox(viewMatrix, projectionMatrix);
+
+		shadingTimer.begin();
+
+		if (bDepthPrepass) {
+			depthPrepassTimer.begin();
+			drawDepthPrepass(CameraPass);
+			depthPrepassTimer.end();
+		}
+
+		drawCommands(CameraPass, projectionMatrix, false, bDepthPrepass);
+
+		shadingTimer.end();
+	}
+
+	if (bDrawParticles || bGpuParticles) {
+		gpuParticleTimer.begin();
 
-	drawModel(terrain, viewMatrix, projectionMatrix);
+		if (bGpuParticles) {
+			// The snow keeps falling while hidden, as the CPU snow does in
+			// updateParticles(), so it doesn't resume where it was hidden
+			gpuParticles.setActiveCount(static_cast<uint32_t>(gpuParticles.getCount() * particleLod.getDensity()));
 
-	leftHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
-	rightHouse->getMeshes()[0]->setTexture(0, currentHouseTexture);
+			particleSimulationShader->use();
+			particleLod.setUniforms(*particleSimulationShader);
+			gpuParticles.simulate(*particleSimulationShader, frameTime, projectionMatrix * viewMatrix, mainCamera.getEye());
 
-	drawModel(leftHouse, viewMatrix, projectionMatrix);
-	drawModel(rightHouse, viewMatrix, projectionMatrix);
+			if (bDrawParticles) {
+				gpuParticleShader->use();
+				gpuParticleShader->setUniform("viewProjection", projectionMatrix * viewMatrix);
+				gpuParticleShader->setUniform("eye", mainCamera.getEye());
+				gpuParticleShader->setUniform("albedo", snowflakesTexture->getTextureIndex());
+				particleLod.setUniforms(*gpuParticleShader);
+
+				glBindVertexArray(particleQuadVAO);
+				gpuParticles.draw();
+			}
+		}
+		else {
+			particleShader->use();
+			drawParticles(CameraPass);
+		}
+
+		gpuParticleTimer.end();
+
+		// The GPU time is a couple of frames old, which the controller's
+		// smoothing absorbs
+		particleLod.update(static_cast<float>(particleCpuMilliseconds + gpuParticleTimer.getMilliseconds()));
 
-	if (bDrawParticles) {
-		particleShader->use();
-		drawParticles(particles, viewMatrix, projectionMatrix);
 		sceneShader->use();
 	}
 
+	sceneTimer.end();
+
 	//if (bDrawNormals) {
 	//	drawNormals(viewMatrix, projectionMatrix);
 	//}
@@ -2416,9 +3181,100 @@ void renderScene()
 	}
 }
 
+// Keeps depthPrepassCosts current and, in auto mode, now and then tries the
+// other setting for a short while and keeps whichever is cheaper
+constexpr int32_t DepthPrepassSettleFrames = 600;
+constexpr int32_t DepthPrepassTrialFrames = 60;
+// Results of the previous setting still in flight
+constexpr int32_t DepthPrepassTimerLatency = 8;
+
+int32_t depthPrepassFrame = 0;
+bool bDepthPrepassTrial = false;
+
+void updateDepthPrepass() {
+
+	if (bDeferredShading) {
+		return;
+	}
+
+	depthPrepassFrame++;
+
+	if (depthPrepassFrame == DepthPrepassTimerLatency) {
+		shadingTimer.reset();
+	}
+
+	if (depthPrepassFrame > DepthPrepassTimerLatency && shadingTimer.getSampleCount() > 0) {
+		depthPrepassCosts[bDepthPrepass ? 1 : 0] = shadingTimer.getMeanMilliseconds();
+	}
+
+	auto mode = static_cast<DepthPrepassMode>(depthPrepassMode);
+
+	if (mode != DepthPrepassMode::Auto) {
+		bool bEnabled = (mode == DepthPrepassMode::On);
+
+		if (bEnabled != bDepthPrepass) {
+			bDepthPrepass = bEnabled;
+			bDepthPrepassTrial = false;
+			depthPrepassFrame = 0;
+		}
+
+		return;
+	}
+
+	if (depthPrepassFrame < (bDepthPrepassTrial ? DepthPrepassTrialFrames : DepthPrepassSettleFrames)) {
+		return;
+	}
+
+	if (bDepthPrepassTrial) {
+		// Go back unless the trial setting was cheaper
+		if (depthPrepassCosts[bDepthPrepass ? 1 : 0] >= depthPrepassCosts[bDepthPrepass ? 0 : 1]) {
+			bDepthPrepass = !bDepthPrepass;
+		}
+
+		bDepthPrepassTrial = false;
+	}
+	else {
+		bDepthPrepass = !bDepthPrepass;
+		bDepthPrepassTrial = true;
+	}
+
+	depthPrepassFrame = 0;
+}
+
+// Results of the previous shadow filter mode still in flight
+constexpr int32_t ShadowFilterTimerLatency = 8;
+
+// Mode the scene timer is measuring, and frames drawn with it so far
+int32_t timedShadowFilterMode = static_cast<int32_t>(ShadowFilterMode::PCF);
+int32_t shadowFilterFrame = 0;
+
+// Called once per frame after the scene is drawn. The scene timer is reset
+// once the frames of the previous mode have left it, so each mode's cost only
+// averages frames drawn with that mode.
+void updateShadowFilterCost() {
+
+	if (timedShadowFilterMode != shadowFilterMode) {
+		timedShadowFilterMode = shadowFilterMode;
+		shadowFilterFrame = 0;
+	}
+
+	shadowFilterFrame++;
+
+	if (shadowFilterFrame == ShadowFilterTimerLatency) {
+		sceneTimer.reset();
+	}
+
+	if (shadowFilterFrame > ShadowFilterTimerLatency && sceneTimer.getSampleCount() > 0) {
+		shadowFilterSceneCosts[shadowFilterMode] = sceneTimer.getMeanMilliseconds();
+	}
+}
+
 void render()
 {
 	renderScene();
+	updateShadowFilterCost();
+	updateDepthPrepass();
+	updateShadingBenchmark();
 	renderImGui();
 }
 
@@ -2441,7 +3297,6 @@ std::shared_ptr<Model> createSphere(float radius, int32_t sliceCount, int32_t st
 	}
 
 	auto model = std::make_shared<Model>();
-	mesh->setTexture(0, getTexture("Globe"));
 	model->addMesh(mesh);
 
 	model->setPosition(position);
@@ -2474,6 +3329,7 @@ std::shared_ptr<Model> createSmoke(float radius, const glm::vec3& position) {
 	model->addMesh(mesh);
 
 	model->setPosition(glm::vec3(position.x, position.y, position.z));
+	model->bDynamic = true;
 
 	model->computeTangentSpace();
 	model->prepareDraw();
@@ -2527,33 +3383,40 @@ void loadModels() {
 	model->scale(glm::vec3(100.0f));
 	models.push_back(model);
 
-	auto terrianMeshData = geometryGenerator.CreateGrid(50.0f, 50.0f, 50, 50, 10.0f);
+	constexpr float TerrainSize = 50.0f;
+	const glm::vec3 terrainPosition = glm::vec3(0.0f, -2.25f, 0.0f);
 
-	auto mesh = std::make_shared<Mesh>();
+	terrainNoise.offset = 0.5f;
+	terrainNoise.amplitude = 0.5f;
 
-	for (size_t i = 0; i < terrianMeshData.Vertices.size(); i++) {
-		Vertex vertex;
-		glm::vec4 newPosition = glm::vec4(terrianMeshData.Vertices[i].Position, 1.0);
-		newPosition.y = getSmoothNoise(newPosition.x, newPosition.z);
-		vertex.position = newPosition;
-		vertex.normal = terrianMeshData.Vertices[i].Normal;
-		vertex.texCoord = terrianMeshData.Vertices[i].TexC;
-		mesh->addVertex(vertex);
-	}
+	terrain.quadtree.noise = terrainNoise;
+	terrain.quadtree.baseHeight = terrainPosition.y;
+	terrain.create(threadPool);
 
-	for (auto index : terrianMeshData.Indices32) {
-		mesh->addIndex(index);
-	}
+	// Common, except that the terrain is only seen from above
+	terrainMaterial = std::make_shared<Material>(*material);
+	terrainMaterial->bDoubleSided = false;
+	addMaterial("Terrain", terrainMaterial);
 
-	terrain = std::make_shared<Model>();
+	terrainTexture = materialTextures.get("CartoonSnow");
 
-	mesh->addTexture(defaultAlbedo);
-	mesh->setMaterial(material);
-	mesh->setTexture(0, getTexture("CartoonSnow"));
+	// On the finest grid of the terrain, so the ground contact matches what
+	// is drawn up close
+	float groundSpacing = terrain.quadtree.getNodeSize(0) / static_cast<float>(terrain.quadtree.gridResolution);
+	int32_t groundResolution = static_cast<int32_t>(TerrainSize / groundSpacing) + 1;
+
+	std::vector<float> groundHeights(static_cast<size_t>(groundResolution) * groundResolution);
+	terrainNoise.generate(threadPool, groundHeights.data(), groundResolution, groundResolution, glm::vec2(-TerrainSize * 0.5f), glm::vec2(groundSpacing));
 
-	terrain->addMesh(mesh);
+	terrainHeights.resize(groundResolution, groundResolution, glm::vec2(-TerrainSize * 0.5f), glm::vec2(groundSpacing));
+
+	for (int32_t row = 0; row < groundResolution; row++) {
+		for (int32_t column = 0; column < groundResolution; column++) {
+			terrainHeights.setHeight(column, row, groundHeights[static_cast<size_t>(row) * groundResolution + column] + terrainPosition.y);
+		}
+	}
 
-	terrain->setPosition(glm::vec3(0.0f, -2.25f, 0.0f));
+	particles.ground = &terrainHeights;
 
 	model = loadModel("./assets/models/ChristmasTree.obj");
 	model->scale(glm::vec3(1.0f, 1.0f, 1.0f));
@@ -2562,6 +3425,7 @@ void loadModels() {
 	models.push_back(model);
 
 	movingSphere = loadModel("./assets/models/sphere.obj");
+	movingSphere->bDynamic = true;
 	movingSphere->setPosition(glm::vec3(2.0f, 10.0f, 0.0f));
 
 	models.push_back(movingSphere);
@@ -2668,6 +3532,18 @@ void loadModels() {
 	purpleBalls[5]->scale(glm::vec3(1.0f, 1.0f, 1.0f));
 	purpleBalls[5]->setPosition(glm::vec3(5.5f, -1.6f, 2.0f));
 
+	// All balls of a color share the mesh, so the light positions are found once
+	const std::shared_ptr<Model> ornaments[3] = { redBalls[0], goldenBalls[0], purpleBalls[0] };
+
+	for (auto i = 0; i < 3; i++) {
+		ornamentLightCenters[i].clear();
+
+		for (const auto& mesh : ornaments[i]->getMeshes()) {
+			auto centers = mesh->computeIslandCenters();
+			ornamentLightCenters[i].insert(ornamentLightCenters[i].end(), centers.begin(), centers.end());
+		}
+	}
+
 	leftHouse = loadModel("./assets/models/House.obj");
 	leftHouse->scale(glm::vec3(4.0f, 4.0f, 4.0f));
 	leftHouse->rotate(-90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
@@ -2678,13 +3554,12 @@ void loadModels() {
 	rightHouse->rotate(-90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
 	rightHouse->setPosition(glm::vec3(8.0f, 0.5f, -5.0f));
 
-	smokeSpawnPositions1[0] = { leftHouse->getPosition().x - 2.0f, leftHouse->getPosition().y + 4.5f, leftHouse->getPosition().z + 0.675f };
-	smokeSpawnPositions1[1] = { leftHouse->getPosition().x - 2.0f, leftHouse->getPosition().y + 4.0f, leftHouse->getPosition().z + 0.675f };
-	smokeSpawnPositions1[2] = { leftHouse->getPosition().x - 2.0f, leftHouse->getPosition().y + 3.5f, leftHouse->getPosition().z + 0.675f };
+	setHouseTexture(currentHouseTexture);
 
-	smokeSpawnPositions2[0] = { rightHouse->getPosition().x - 2.0f, rightHouse->getPosition().y + 4.5f, rightHouse->getPosition().z + 0.675f };
-	smokeSpawnPositions2[1] = { rightHouse->getPosition().x - 2.0f, rightHouse->getPosition().y + 4.0f, rightHouse->getPosition().z + 0.675f };
-	smokeSpawnPositions2[2] = { rightHouse->getPosition().x - 2.0f, rightHouse->getPosition().y + 3.5f, rightHouse->getPosition().z + 0.675f };
+	// Chimneys of both houses
+	for (const auto& house : { leftHouse, rightHouse }) {
+		smoke.addEmitter(house->getPosition() + glm::vec3(-2.0f, 3.5f, 0.675f), 3);
+	}
 
 	leftSnowman = loadModel("./assets/models/SnowmanBodyV2.obj");
 	leftSnowman->setPosition(glm::vec3(-2.5f, -1.8f, 5.0f));
@@ -2692,7 +3567,7 @@ void loadModels() {
 	models.push_back(leftSnowman);
 
 	leftSnowmanArm = loadModel("./assets/models/SnowmanArmV2.obj");
-	leftSnowmanArm->setPosition(glm::vec3(-2.5f, -1.8f, 5.0f));
+	leftSnowmanArm->setParent(leftSnowman.get());
 
 	models.push_back(leftSnowmanArm);
 
@@ -2705,7 +3580,7 @@ void loadModels() {
 	models.push_back(middleSnowman);
 
 	middleSnowmanArm = loadModel("./assets/models/SnowmanArmV2.obj");
-	middleSnowmanArm->setPosition(glm::vec3(0.0f, -1.8f, 5.0f));
+	middleSnowmanArm->setParent(middleSnowman.get());
 
 	models.push_back(middleSnowmanArm);
 
@@ -2722,13 +3597,24 @@ void loadModels() {
 	rightSnowmanArm = loadModel("./assets/models/SnowmanArmV2.obj");
 	rightSnowmanArm->scale(glm::vec3(1.0f, 1.0f, 1.0f));
 	//    model->rotate(-45.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	rightSnowmanArm->setPosition(glm::vec3(2.5f, -1.8f, 5.0f));
+	rightSnowmanArm->setParent(rightSnowman.get());
 
 	models.push_back(rightSnowmanArm);
 
 	snowmen.push_back(rightSnowman);
 	snowmen.push_back(rightSnowmanArm);
 
+	for (auto& snowman : snowmen) {
+		snowman->bDynamic = true;
+	}
+
+	// Stand the bodies on the terrain, the arms follow
+	for (size_t i = 0; i < snowmen.size(); i += 2) {
+		auto position = snowmen[i]->getPosition();
+		position.y = terrainHeights.sample(position.x, position.z);
+		snowmen[i]->setPosition(position);
+	}
+
 	model = loadModel("./assets/models/Present.obj");
 	model->setPosition(glm::vec3(-2.0f, -1.8f, 1.0f));
 
@@ -2762,24 +3648,16 @@ void loadModels() {
 	merryChristmasSnowman->setPosition(glm::vec3(0.0f, -1.5f, -10.0f));
 
 	merryChristmasSnowmanArm = loadModel("./assets/models/SnowmanArmV2.obj");
-	merryChristmasSnowmanArm->rotate(180.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	merryChristmasSnowmanArm->setPosition(glm::vec3(0.0f, -1.5f, -10.0f));
+	merryChristmasSnowmanArm->setParent(merryChristmasSnowman.get());
 
 	flagpole = loadModel("./assets/models/Flagpole.obj");
-	flagpole->rotate(180.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	flagpole->setPosition(glm::vec3(0.0f, -1.5f, -10.0f));
+	flagpole->setParent(merryChristmasSnowman.get());
 
 	flag = loadModel("./assets/models/Flag.obj");
-	flag->rotate(180.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	flag->setPosition(glm::vec3(0.0f, -1.5f, -10.0f));
+	flag->setParent(merryChristmasSnowman.get());
 
-	smokesGroup[0].push_back(createSmoke(0.125f, smokeSpawnPositions1[0]));
-	smokesGroup[0].push_back(createSmoke(0.125f, smokeSpawnPositions1[1]));
-	smokesGroup[0].push_back(createSmoke(0.125f, smokeSpawnPositions1[2]));
-
-	smokesGroup[1].push_back(createSmoke(0.125f, smokeSpawnPositions2[0]));
-	smokesGroup[1].push_back(createSmoke(0.125f, smokeSpawnPositions2[1]));
-	smokesGroup[1].push_back(createSmoke(0.125f, smokeSpawnPositions2[2]));
+	smokePuff = createSmoke(0.125f, glm::vec3(0.0f));
+	smokePuff->getMeshes()[0]->setMaterial(getMaterial("Common"));
 
 	giftBoxBody = loadModel("./assets/models/GiftBoxBody.obj");
 	giftBoxBody->setPosition(glm::vec3(0.0f, -1.8f, -10.0f));
@@ -2787,6 +3665,7 @@ void loadModels() {
 	models.push_back(giftBoxBody);
 
 	giftBoxCover = loadModel("./assets/models/GiftBoxCover.obj");
+	giftBoxCover->bDynamic = true;
 	giftBoxCover->setPosition(glm::vec3(0.0f, -1.8f, -10.0f));
 
 	models.push_back(giftBoxCover);
@@ -2798,9 +3677,6 @@ void loadModels() {
 		m->prepareDraw();
 	}
 
-	terrain->computeTangentSpace();
-	terrain->prepareDraw();
-
 	leftHouse->computeTangentSpace();
 	leftHouse->prepareDraw();
 
@@ -2829,6 +3705,8 @@ void loadModels() {
 
 	flag->computeTangentSpace();
 	flag->prepareDraw();
+
+	materialTextures.build();
 }
 
 void prepareTextures()
@@ -2838,7 +3716,7 @@ void prepareTextures()
 
 	sceneTexture = std::make_shared<Texture>("sceneTexture", WindowWidth, WindowHeight, GL_LINEAR, false, GL_RGB16F, GL_RGBA, GL_FLOAT);
 
-	defaultAlbedo = std::make_shared<Texture>("defaultAlbedo", 1, 1);
+	defaultAlbedo = materialTextures.addSolidColor("defaultAlbedo", 255, 255, 255);
 
 	skyboxDusk = addCubemapTexture("Dusk", "./assets/textures/sunset", GL_CLAMP_TO_EDGE, true);
 	skyboxDay = addCubemapTexture("Day", "./assets/textures/day", GL_CLAMP_TO_EDGE, true);
@@ -2848,17 +3726,22 @@ void prepareTextures()
 
 	//addTexture("Projection", "./assets/textures/Kanna.jpg", GL_CLAMP_TO_BORDER);
 
-	addTexture("CartoonGrass", "./assets/textures/CartoonGrass.jpg");
-	addTexture("CartoonSnow", "./assets/textures/Snow.jpg");
-	addTexture("Markus", "./assets/textures/markus.png");
-	houseTexture = addTexture("House", "./assets/textures/House.png");
-	houseLightTexture = addTexture("HouseLight", "./assets/textures/HouseLight.png");
+	addMaterialTexture("CartoonGrass", "./assets/textures/CartoonGrass.jpg");
+	addMaterialTexture("CartoonSnow", "./assets/textures/Snow.jpg");
+	addMaterialTexture("Markus", "./assets/textures/markus.png");
+	houseTexture = addMaterialTexture("House", "./assets/textures/House.png");
+	houseLightTexture = addMaterialTexture("HouseLight", "./assets/textures/HouseLight.png");
 	snowflakesTexture = addTexture("Snowflakes", "./assets/textures/Snowflakes.png");
 
 	currentHouseTexture = houseTexture;
 
 	depthMapTexture = std::make_shared<Texture>();
-	depthMapTexture->createDepthMap(ShadowMapWidth, SHadowMapHeight);
+	depthMapTexture->createDepthMapArray(ShadowMapWidth, SHadowMapHeight, ShadowCascadeCount);
+
+	staticDepthMapTexture = std::make_shared<Texture>();
+	staticDepthMapTexture->createDepthMapArray(ShadowMapWidth, SHadowMapHeight, ShadowCascadeCount);
+
+	shadowFilter.create(depthMapTexture->getTextureId(), ShadowMapWidth, ShadowCascadeCount);
 }
 
 void writeToPNG(const std::string& path, int32_t width, int32_t height, uint8_t* pixelBuffer) 
@@ -2990,16 +3873,43 @@ int main() try
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_MULTISAMPLE);
 
-	prepareTextures();
+	// Linked programs are reused across runs, see Shader::build()
+	Shader::setBinaryCacheDirectory("./cache/shaders");
+
+	Shader::enableParallelCompile((GLADloadproc)&glfwGetProcAddress);
+
+	double shaderStartSeconds = glfwGetTime();
 
 	prepareShaderResources();
-	sceneShader->printActiveAttributes();
-	sceneShader->printActiveUniforms();
+
+	double shaderSubmitSeconds = glfwGetTime();
 
 	mainCamera.perspective(fov, aspect, nearPlane, farPlane);
 
+	// Texture decoding overlaps with the driver's compiling
+	prepareTextures();
+
 	loadModels();
 
+	double shaderWaitSeconds = glfwGetTime();
+
+	startupShaders.finish();
+
+	std::cout << "Shaders submitted in " << (shaderSubmitSeconds - shaderStartSeconds) * 1000.0 << " ms, waited "
+			  << (glfwGetTime() - shaderWaitSeconds) * 1000.0 << " ms after loading models"
+			  << (Shader::isParallelCompileEnabled() ? " (parallel compile)" : "") << std::endl;
+
+	sceneShader->printActiveAttributes();
+	sceneShader->printActiveUniforms();
+
+	bindMaterialTextureUnits(*sceneShader);
+	bindMaterialTextureUnits(*decorationShader);
+	bindMaterialTextureUnits(*gbufferShader);
+
+	// Variants compiled from now on need the same units
+	sceneVariants->onCreate = [](Shader& shader) { bindMaterialTextureUnits(shader); };
+	gbufferVariants->onCreate = [](Shader& shader) { bindMaterialTextureUnits(shader); };
+
 	prepareGeometryData();
 
 	initImGui();
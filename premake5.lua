@@ -24,6 +24,12 @@ workspace "COMP3811-cw2"
 		-- (MSVC will not compile code with VLAs.)
 		buildoptions { "-Werror=vla" }
 
+	-- TerrainNoise gives the same heights on every platform, and Heightfield
+	-- and Random the same from their scalar and AVX2 paths, which rules out
+	-- fusing their multiplies and adds where -march=native allows FMA
+	filter { "toolset:gcc or toolset:clang", "files:main/TerrainNoise.cpp or main/Heightfield.cpp or main/Random.cpp" }
+		buildoptions { "-ffp-contract=off" }
+
 	filter "toolset:msc-*"
 		warnings "extra" -- this enables /W4; default is /W3
 		--buildoptions { "/W4" }
@@ -65,6 +71,11 @@ workspace "COMP3811-cw2"
 	filter "*"
 
 
+newoption {
+	trigger = "no-gl-bench",
+	description = "Build the bench without the benchmarks that need an OpenGL context (and GLFW)"
+}
+
 -- Third party dependencies
 include "third_party" 
 
@@ -91,6 +102,72 @@ project "main"
 
 	files( sources )
 
+project "bench"
+	local sources = { 
+		"bench/**.cpp",
+		"bench/**.hpp"
+	}
+
+	-- The CPU side code under test, built once more for the bench
+	local tested = {
+		"main/GeometryGenerator.cpp",
+		"main/Heightfield.cpp",
+		"main/Model.cpp",
+		"main/ModelLoader.cpp",
+		"main/ParticlePool.cpp",
+		"main/Random.cpp",
+		"main/SceneNode.cpp",
+		"main/Shader.cpp",
+		"main/Terrain.cpp",
+		"main/TerrainNoise.cpp",
+		"main/Texture.cpp",
+		"main/ThreadPool.cpp"
+	}
+
+	kind "ConsoleApp"
+	location "bench"
+
+	files( sources )
+	files( tested )
+
+	-- glm is kept with the main sources
+	includedirs( "main" )
+
+	links "vmlib"
+	links "support"
+
+	links "x-stb"
+	links "x-glad"
+
+	-- The uniform benchmarks need a window system for their context
+	filter "options:no-gl-bench"
+		removefiles "bench/uniforms.cpp"
+		defines { "BENCH_NO_GL=1" }
+
+	filter "not options:no-gl-bench"
+		links "x-glfw"
+
+	filter "*"
+
+project "tests"
+	local sources = { 
+		"tests/**.cpp",
+		"tests/**.hpp"
+	}
+
+	-- The CPU side code under test, built once more for the tests
+	local tested = {
+		"main/Random.cpp"
+	}
+
+	kind "ConsoleApp"
+	location "tests"
+
+	files( sources )
+	files( tested )
+
+	links "vmlib"
+
 project "main-shaders"
 	local shaders = { 
 		"assets/*.vert",
@@ -0,0 +1,246 @@
+// vmlib batch kernels against a scalar double precision reference. Counts
+// around the eight lanes of a vector cover the scalar tails; counts past
+// kBatchParallelThreshold, split by threads and by uneven chunks, cover the
+// tails at every chunk boundary. Outputs have one more element than the count,
+// which must stay untouched.
+
+#include "tests.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../vmlib/batch.hpp"
+
+namespace {
+	// Never written by the kernels
+	constexpr float Sentinel = 12345.0f;
+
+	// SoA storage for the views of batch.hpp, one spare element at the end
+	struct Soa {
+		std::vector<float> x, y, z, w;
+
+		explicit Soa(size_t count) : x(count + 1, Sentinel), y(count + 1, Sentinel), z(count + 1, Sentinel), w(count + 1, Sentinel) {}
+
+		Vec3fArrays vec3() { return { x.data(), y.data(), z.data() }; }
+		ConstVec3fArrays constVec3() const { return { x.data(), y.data(), z.data() }; }
+		Vec4fArrays vec4() { return { x.data(), y.data(), z.data(), w.data() }; }
+		ConstVec4fArrays constVec4() const { return { x.data(), y.data(), z.data(), w.data() }; }
+
+		bool isSpareUntouched() const {
+			return x.back() == Sentinel && y.back() == Sentinel && z.back() == Sentinel && w.back() == Sentinel;
+		}
+	};
+
+	// Row r of the matrix times (x, y, z, w), and a bound on the rounding
+	// error of doing the same in floats, with or without FMA
+	struct Dot {
+		double value;
+		double tolerance;
+	};
+
+	Dot dot(const Mat44f& matrix, size_t row, double x, double y, double z, double w) {
+		double terms[4] = { matrix(row, 0) * x, matrix(row, 1) * y, matrix(row, 2) * z, matrix(row, 3) * w };
+		double magnitude = std::abs(terms[0]) + std::abs(terms[1]) + std::abs(terms[2]) + std::abs(terms[3]);
+
+		return { terms[0] + terms[1] + terms[2] + terms[3], 1e-6 + magnitude * 4e-7 };
+	}
+
+	// A ParallelFor that runs chunks of 8k + 3 elements one after the other,
+	// so every boundary falls mid-vector
+	ParallelFor makeUnevenParallelFor() {
+		return [](size_t count, size_t minChunkSize, const ParallelTask& task) {
+			size_t chunkSize = (std::max<size_t>(minChunkSize, 1) / 8) * 8 + 3;
+			size_t chunk = 0;
+
+			for (size_t begin = 0; begin < count; begin += chunkSize) {
+				task(chunk++, begin, std::min(count, begin + chunkSize));
+			}
+		};
+	}
+
+	void testCount(Checks& checks, size_t count, const ParallelFor* parallel, const std::string& variant) {
+		std::mt19937 generator(static_cast<uint32_t>(count));
+		std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+		Soa points(count);
+		Soa extents(count);
+
+		for (size_t i = 0; i < count; i++) {
+			points.x[i] = position(generator);
+			points.y[i] = position(generator);
+			points.z[i] = position(generator);
+			points.w[i] = size(generator);
+			extents.x[i] = points.x[i] + size(generator);
+			extents.y[i] = points.y[i] + size(generator);
+			extents.z[i] = points.z[i] + size(generator);
+		}
+
+		Mat44f model = make_translation({ 3.0f, -1.0f, 8.0f }) * make_rotation_y(40.0f) * make_scaling(1.5f, 2.0f, 0.5f);
+		Mat44f viewProjection = make_perspective_projection(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * make_translation({ 0.0f, 0.0f, -20.0f });
+
+		// batch/<kernel>/<count>/<variant>
+		auto name = [count, &variant](const char* kernel) {
+			return std::string("batch/") + kernel + "/" + std::to_string(count) + "/" + variant;
+		};
+
+		auto wrongAt = [](size_t index) {
+			return "first wrong at " + std::to_string(index);
+		};
+
+		// Points
+		{
+			Soa results(count);
+			transform_points(model, points.constVec3(), results.vec3(), count, parallel);
+
+			size_t wrong = count;
+
+			for (size_t i = 0; i < count && wrong == count; i++) {
+				const float outputs[3] = { results.x[i], results.y[i], results.z[i] };
+
+				for (size_t row = 0; row < 3; row++) {
+					Dot expected = dot(model, row, points.x[i], points.y[i], points.z[i], 1.0);
+
+					if (!(std::abs(outputs[row] - expected.value) <= expected.tolerance)) {
+						wrong = i;
+					}
+				}
+			}
+
+			checks.check(name("points"), wrong == count && results.isSpareUntouched(), wrongAt(wrong));
+
+			// In place, as the header allows
+			Soa inPlace = points;
+			transform_points(model, inPlace.constVec3(), inPlace.vec3(), count, parallel);
+
+			bool bSame = std::equal(inPlace.x.begin(), inPlace.x.begin() + count, results.x.begin()) &&
+				std::equal(inPlace.y.begin(), inPlace.y.begin() + count, results.y.begin()) &&
+				std::equal(inPlace.z.begin(), inPlace.z.begin() + count, results.z.begin());
+
+			checks.check(name("points in place"), bSame);
+		}
+
+		// Vec4s
+		{
+			Soa results(count);
+			transform_vec4s(viewProjection, points.constVec4(), results.vec4(), count, parallel);
+
+			size_t wrong = count;
+
+			for (size_t i = 0; i < count && wrong == count; i++) {
+				const float outputs[4] = { results.x[i], results.y[i], results.z[i], results.w[i] };
+
+				for (size_t row = 0; row < 4; row++) {
+					Dot expected = dot(viewProjection, row, points.x[i], points.y[i], points.z[i], points.w[i]);
+
+					if (!(std::abs(outputs[row] - expected.value) <= expected.tolerance)) {
+						wrong = i;
+					}
+				}
+			}
+
+			checks.check(name("vec4s"), wrong == count && results.isSpareUntouched(), wrongAt(wrong));
+
+			Soa inPlace = points;
+			transform_vec4s(viewProjection, inPlace.constVec4(), inPlace.vec4(), count, parallel);
+
+			bool bSame = std::equal(inPlace.x.begin(), inPlace.x.begin() + count, results.x.begin()) &&
+				std::equal(inPlace.y.begin(), inPlace.y.begin() + count, results.y.begin()) &&
+				std::equal(inPlace.z.begin(), inPlace.z.begin() + count, results.z.begin()) &&
+				std::equal(inPlace.w.begin(), inPlace.w.begin() + count, results.w.begin());
+
+			checks.check(name("vec4s in place"), bSame);
+		}
+
+		// Boxes, against the bounds of the eight transformed corners
+		{
+			Soa resultsMin(count);
+			Soa resultsMax(count);
+			transform_aabbs(model, points.constVec3(), extents.constVec3(), resultsMin.vec3(), resultsMax.vec3(), count, parallel);
+
+			size_t wrong = count;
+
+			for (size_t i = 0; i < count && wrong == count; i++) {
+				const float outputsMin[3] = { resultsMin.x[i], resultsMin.y[i], resultsMin.z[i] };
+				const float outputsMax[3] = { resultsMax.x[i], resultsMax.y[i], resultsMax.z[i] };
+
+				for (size_t row = 0; row < 3; row++) {
+					double expectedMin = INFINITY;
+					double expectedMax = -INFINITY;
+					double tolerance = 0.0;
+
+					for (int32_t corner = 0; corner < 8; corner++) {
+						double x = (corner & 1) ? extents.x[i] : points.x[i];
+						double y = (corner & 2) ? extents.y[i] : points.y[i];
+						double z = (corner & 4) ? extents.z[i] : points.z[i];
+
+						Dot transformed = dot(model, row, x, y, z, 1.0);
+						expectedMin = std::min(expectedMin, transformed.value);
+						expectedMax = std::max(expectedMax, transformed.value);
+						tolerance = std::max(tolerance, transformed.tolerance);
+					}
+
+					// Centre and half extent round once more each
+					tolerance *= 2.0;
+
+					if (!(std::abs(outputsMin[row] - expectedMin) <= tolerance && std::abs(outputsMax[row] - expectedMax) <= tolerance)) {
+						wrong = i;
+					}
+				}
+			}
+
+			checks.check(name("aabbs"), wrong == count && resultsMin.isSpareUntouched() && resultsMax.isSpareUntouched(), wrongAt(wrong));
+		}
+
+		// Spheres, rounding may only flip those that touch a plane
+		{
+			FrustumPlanes frustum = make_frustum_planes(viewProjection);
+
+			std::vector<uint8_t> visible(count + 1, 0xFF);
+			size_t visibleCount = cull_spheres(frustum, points.constVec4(), visible.data(), count, parallel);
+
+			size_t wrong = count;
+			size_t flaggedCount = 0;
+
+			for (size_t i = 0; i < count; i++) {
+				double closest = INFINITY;
+
+				for (const auto& plane : frustum.planes) {
+					double distance = static_cast<double>(plane.x) * points.x[i] + static_cast<double>(plane.y) * points.y[i] + static_cast<double>(plane.z) * points.z[i] + plane.w + points.w[i];
+					closest = std::min(closest, distance);
+				}
+
+				uint8_t expected = closest >= 0.0 ? 1 : 0;
+				flaggedCount += visible[i] == 1 ? 1 : 0;
+
+				if (wrong == count && (visible[i] > 1 || (visible[i] != expected && std::abs(closest) > 1e-4))) {
+					wrong = i;
+				}
+			}
+
+			checks.check(name("spheres"), wrong == count && visible[count] == 0xFF, wrongAt(wrong));
+			checks.check(name("spheres count"), visibleCount == flaggedCount, std::to_string(visibleCount) + " returned, " + std::to_string(flaggedCount) + " flagged");
+		}
+	}
+}
+
+void testBatch(Checks& checks) {
+	// Around the lanes of a vector, all on the calling thread
+	for (size_t count : { 0, 1, 7, 8, 9, 15, 16, 17, 100, 1003 }) {
+		testCount(checks, count, nullptr, "serial");
+	}
+
+	ParallelFor threads = make_thread_parallel_for(3);
+	ParallelFor uneven = makeUnevenParallelFor();
+
+	// Just under the threshold runs serially anyway, the others are split
+	// into chunks that don't end on a multiple of eight
+	for (size_t count : { kBatchParallelThreshold - 1, kBatchParallelThreshold, kBatchParallelThreshold + 5, 3 * kBatchParallelThreshold + 7 }) {
+		testCount(checks, count, &threads, "threads");
+		testCount(checks, count, &uneven, "uneven");
+	}
+}
@@ -0,0 +1,29 @@
+// Correctness tests of the CPU side code that has no GL dependency. Run from
+// the repository root, e.g.
+//   bin/tests-release-x64-gcc.exe
+// Prints the failed checks and exits with 1 if there were any.
+
+#include "tests.hpp"
+
+#include <cstdio>
+
+void Checks::check(const std::string& name, bool bPassed, const std::string& details) {
+	checkCount++;
+
+	if (!bPassed) {
+		failureCount++;
+		std::printf("FAILED %s %s\n", name.c_str(), details.c_str());
+	}
+}
+
+int main(int, char**) {
+	Checks checks;
+
+	testBatch(checks);
+	testMat44(checks);
+	testRandom(checks);
+
+	std::printf("%zu of %zu checks passed\n", checks.getCheckCount() - checks.getFailureCount(), checks.getCheckCount());
+
+	return checks.getFailureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// The Mat44f operators of vmlib/mat44.hpp, which take the vector path of
+// simd.hpp at run time, against their scalar versions and a double precision
+// reference. A constant expression exercises the compile time path.
+
+#include "tests.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "../vmlib/mat44.hpp"
+
+namespace {
+	// Row r of the matrix times (x, y, z, w) in doubles, and a bound on the
+	// rounding error of doing the same in floats, in any order, with or
+	// without FMA
+	struct Dot {
+		double value;
+		double tolerance;
+	};
+
+	Dot dot(const Mat44f& matrix, size_t row, double x, double y, double z, double w) {
+		double terms[4] = { matrix(row, 0) * x, matrix(row, 1) * y, matrix(row, 2) * z, matrix(row, 3) * w };
+		double magnitude = std::abs(terms[0]) + std::abs(terms[1]) + std::abs(terms[2]) + std::abs(terms[3]);
+
+		return { terms[0] + terms[1] + terms[2] + terms[3], 1e-6 + magnitude * 4e-7 };
+	}
+
+	Mat44f makeRandomMatrix(std::mt19937& generator) {
+		std::uniform_real_distribution<float> element(-8.0f, 8.0f);
+		Mat44f matrix;
+
+		for (float& value : matrix.v) {
+			value = element(generator);
+		}
+
+		return matrix;
+	}
+
+	// Compile time products, the scalar path is the only one allowed there
+	constexpr Mat44f kConstantProduct = make_translation({ 1.0f, -2.0f, 3.0f }) * make_scaling(2.0f, 4.0f, 0.5f);
+	constexpr Vec4f kConstantTransformed = kConstantProduct * Vec4f{ 1.0f, 1.0f, 2.0f, 1.0f };
+
+	static_assert(kConstantProduct(0, 0) == 2.0f && kConstantProduct(1, 1) == 4.0f && kConstantProduct(2, 2) == 0.5f, "constant product scale");
+	static_assert(kConstantProduct(0, 3) == 1.0f && kConstantProduct(1, 3) == -2.0f && kConstantProduct(2, 3) == 3.0f, "constant product translation");
+	static_assert(kConstantTransformed.x == 3.0f && kConstantTransformed.y == 2.0f && kConstantTransformed.z == 4.0f && kConstantTransformed.w == 1.0f, "constant transform");
+}
+
+void testMat44(Checks& checks) {
+	checks.check("mat44/simd enabled", VMLIB_SIMD == 1, "the operators only have their scalar path");
+
+	std::mt19937 generator(44);
+	std::uniform_real_distribution<float> component(-50.0f, 50.0f);
+
+	size_t wrongProduct = 0;
+	size_t wrongProductScalar = 0;
+	size_t wrongTransform = 0;
+	size_t wrongTransformScalar = 0;
+
+	constexpr size_t Trials = 1000;
+
+	for (size_t trial = 0; trial < Trials; trial++) {
+		Mat44f left = makeRandomMatrix(generator);
+		Mat44f right = makeRandomMatrix(generator);
+		Vec4f vector = { component(generator), component(generator), component(generator), component(generator) };
+
+		// Products
+		Mat44f product = left * right;
+		Mat44f productScalar = multiply_scalar(left, right);
+		bool bProductRight = true;
+		bool bProductScalarRight = true;
+
+		for (size_t row = 0; row < 4; row++) {
+			for (size_t column = 0; column < 4; column++) {
+				Dot expected = dot(left, row, right(0, column), right(1, column), right(2, column), right(3, column));
+
+				bProductRight = bProductRight && std::abs(product(row, column) - expected.value) <= expected.tolerance;
+				bProductScalarRight = bProductScalarRight && std::abs(product(row, column) - productScalar(row, column)) <= 2.0 * expected.tolerance;
+			}
+		}
+
+		wrongProduct += bProductRight ? 0 : 1;
+		wrongProductScalar += bProductScalarRight ? 0 : 1;
+
+		// Transforms
+		Vec4f transformed = left * vector;
+		Vec4f transformedScalar = multiply_scalar(left, vector);
+		const float outputs[4] = { transformed.x, transformed.y, transformed.z, transformed.w };
+		const float outputsScalar[4] = { transformedScalar.x, transformedScalar.y, transformedScalar.z, transformedScalar.w };
+		bool bTransformRight = true;
+		bool bTransformScalarRight = true;
+
+		for (size_t row = 0; row < 4; row++) {
+			Dot expected = dot(left, row, vector.x, vector.y, vector.z, vector.w);
+
+			bTransformRight = bTransformRight && std::abs(outputs[row] - expected.value) <= expected.tolerance;
+			bTransformScalarRight = bTransformScalarRight && std::abs(outputs[row] - outputsScalar[row]) <= 2.0 * expected.tolerance;
+		}
+
+		wrongTransform += bTransformRight ? 0 : 1;
+		wrongTransformScalar += bTransformScalarRight ? 0 : 1;
+	}
+
+	auto wrongOf = [](size_t wrong) {
+		return std::to_string(wrong) + " of " + std::to_string(Trials) + " wrong";
+	};
+
+	checks.check("mat44/product against doubles", wrongProduct == 0, wrongOf(wrongProduct));
+	checks.check("mat44/product against scalar", wrongProductScalar == 0, wrongOf(wrongProductScalar));
+	checks.check("mat44/transform against doubles", wrongTransform == 0, wrongOf(wrongTransform));
+	checks.check("mat44/transform against scalar", wrongTransformScalar == 0, wrongOf(wrongTransformScalar));
+
+	// Exact products, so the run time path must give the same values as the
+	// compile time one
+	Mat44f translation = make_translation({ 1.0f, -2.0f, 3.0f });
+	Mat44f scaling = make_scaling(2.0f, 4.0f, 0.5f);
+	Mat44f runtimeProduct = translation * scaling;
+	Vec4f runtimeTransformed = runtimeProduct * Vec4f{ 1.0f, 1.0f, 2.0f, 1.0f };
+
+	bool bSame = runtimeTransformed.x == kConstantTransformed.x && runtimeTransformed.y == kConstantTransformed.y &&
+		runtimeTransformed.z == kConstantTransformed.z && runtimeTransformed.w == kConstantTransformed.w;
+
+	for (size_t i = 0; i < 16; i++) {
+		bSame = bSame && runtimeProduct.v[i] == kConstantProduct.v[i];
+	}
+
+	checks.check("mat44/constant evaluated", bSame);
+}
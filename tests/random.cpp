@@ -0,0 +1,59 @@
+// RandomStream::fillUniform() against as many nextFloat() calls on a copy of
+// the stream. The values must be bit-identical, whatever the count and
+// however many outputs of the last step were already handed out.
+
+#include "tests.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../main/Random.hpp"
+
+namespace {
+	void testFill(Checks& checks, size_t count, uint32_t consumed, float minimum, float maximum) {
+		RandomStream filled(42, 3);
+		RandomStream called(42, 3);
+
+		for (uint32_t i = 0; i < consumed; i++) {
+			filled.nextUint();
+			called.nextUint();
+		}
+
+		std::vector<float> values(count + 1, -1.0f);
+		filled.fillUniform(values.data(), count, minimum, maximum);
+
+		size_t wrong = count;
+
+		for (size_t i = 0; i < count; i++) {
+			float expected = called.nextFloat(minimum, maximum);
+
+			bool bSame = std::memcmp(&expected, &values[i], sizeof(float)) == 0 && values[i] >= minimum && values[i] < maximum;
+
+			if (wrong == count && !bSame) {
+				wrong = i;
+			}
+		}
+
+		// Both streams continue from the same place
+		bool bInStep = filled.nextUint() == called.nextUint();
+
+		// random/fill/<count>/<consumed>/<minimum>
+		std::string name = "random/fill/" + std::to_string(count) + "/" + std::to_string(consumed) + "/" + std::to_string(static_cast<int32_t>(minimum));
+
+		checks.check(name, wrong == count && values[count] == -1.0f, "first wrong at " + std::to_string(wrong));
+		checks.check(name + " in step", bInStep);
+	}
+}
+
+void testRandom(Checks& checks) {
+	// Multiples of the eight lanes and not, after none, some or a whole
+	// step's outputs were taken
+	for (size_t count : { 0, 1, 7, 8, 9, 16, 17, 24, 100, 1003 }) {
+		for (uint32_t consumed : { 0u, 1u, 5u, 8u }) {
+			testFill(checks, count, consumed, 0.0f, 1.0f);
+			testFill(checks, count, consumed, -3.0f, 5.5f);
+		}
+	}
+}
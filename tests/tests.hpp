@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Pass/fail checks, unlike the bench no timing. Every failure is printed, and
+// main exits non-zero if there was one.
+class Checks {
+public:
+	void check(const std::string& name, bool bPassed, const std::string& details = "");
+
+	size_t getCheckCount() const {
+		return checkCount;
+	}
+
+	size_t getFailureCount() const {
+		return failureCount;
+	}
+
+private:
+	size_t checkCount = 0;
+	size_t failureCount = 0;
+};
+
+// One function per area
+void testBatch(Checks& checks);
+void testMat44(Checks& checks);
+void testRandom(Checks& checks);
@@ -0,0 +1,290 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "simd.hpp"
+
+namespace
+{
+	// Runs aRange( begin, end ) over [0, aCount), split across threads when
+	// there is enough work for it to pay
+	template< typename tRange >
+	void dispatch_( std::size_t aCount, ParallelFor const* aParallel, tRange const& aRange )
+	{
+		if( aParallel && *aParallel && aCount >= kBatchParallelThreshold )
+		{
+			(*aParallel)( aCount, kBatchMinChunkSize, [&aRange] ( std::size_t, std::size_t aBegin, std::size_t aEnd )
+			{
+				aRange( aBegin, aEnd );
+			} );
+		}
+		else
+		{
+			aRange( 0, aCount );
+		}
+	}
+
+	// The three rows of an affine transform, a lane per element
+	struct AffineRows8
+	{
+		simd::Float8 m[12];
+
+		explicit AffineRows8( Mat44f const& aMatrix ) noexcept
+		{
+			for( std::size_t i = 0; i < 12; ++i )
+				m[i] = simd::splat8( aMatrix.v[i] );
+		}
+	};
+}
+
+ParallelFor make_thread_parallel_for( unsigned aThreadCount )
+{
+	if( 0 == aThreadCount )
+		aThreadCount = std::max( 1u, std::thread::hardware_concurrency() );
+
+	return [aThreadCount] ( std::size_t aCount, std::size_t aMinChunkSize, ParallelTask const& aTask )
+	{
+		std::size_t const minChunk = std::max<std::size_t>( aMinChunkSize, 1 );
+		std::size_t const chunkCount = std::max<std::size_t>( 1, std::min<std::size_t>( aThreadCount, aCount / minChunk ) );
+		std::size_t const chunkSize = (aCount + chunkCount - 1) / chunkCount;
+
+		std::vector<std::thread> threads;
+		threads.reserve( chunkCount - 1 );
+
+		// Chunk 0 runs on the calling thread
+		for( std::size_t chunk = 1; chunk < chunkCount; ++chunk )
+		{
+			std::size_t const begin = std::min( aCount, chunk * chunkSize );
+			std::size_t const end = std::min( aCount, begin + chunkSize );
+			threads.emplace_back( [&aTask, chunk, begin, end] { aTask( chunk, begin, end ); } );
+		}
+
+		aTask( 0, 0, std::min( aCount, chunkSize ) );
+
+		for( auto& thread : threads )
+			thread.join();
+	};
+}
+
+
+void transform_points( Mat44f const& aMatrix, ConstVec3fArrays aIn, Vec3fArrays aOut, std::size_t aCount, ParallelFor const* aParallel )
+{
+	AffineRows8 const rows( aMatrix );
+
+	dispatch_( aCount, aParallel, [&] ( std::size_t aBegin, std::size_t aEnd )
+	{
+		using namespace simd;
+		auto const& m = rows.m;
+
+		std::size_t i = aBegin;
+		for( ; i + 8 <= aEnd; i += 8 )
+		{
+			Float8 const x = load8( aIn.x + i );
+			Float8 const y = load8( aIn.y + i );
+			Float8 const z = load8( aIn.z + i );
+
+			store8( aOut.x + i, mul_add( m[0], x, mul_add( m[1], y, mul_add( m[2], z, m[3] ) ) ) );
+			store8( aOut.y + i, mul_add( m[4], x, mul_add( m[5], y, mul_add( m[6], z, m[7] ) ) ) );
+			store8( aOut.z + i, mul_add( m[8], x, mul_add( m[9], y, mul_add( m[10], z, m[11] ) ) ) );
+		}
+
+		for( ; i < aEnd; ++i )
+		{
+			float const x = aIn.x[i], y = aIn.y[i], z = aIn.z[i];
+			aOut.x[i] = aMatrix( 0, 0 ) * x + aMatrix( 0, 1 ) * y + aMatrix( 0, 2 ) * z + aMatrix( 0, 3 );
+			aOut.y[i] = aMatrix( 1, 0 ) * x + aMatrix( 1, 1 ) * y + aMatrix( 1, 2 ) * z + aMatrix( 1, 3 );
+			aOut.z[i] = aMatrix( 2, 0 ) * x + aMatrix( 2, 1 ) * y + aMatrix( 2, 2 ) * z + aMatrix( 2, 3 );
+		}
+	} );
+}
+
+void transform_vec4s( Mat44f const& aMatrix, ConstVec4fArrays aIn, Vec4fArrays aOut, std::size_t aCount, ParallelFor const* aParallel )
+{
+	simd::Float8 m[16];
+	for( std::size_t i = 0; i < 16; ++i )
+		m[i] = simd::splat8( aMatrix.v[i] );
+
+	dispatch_( aCount, aParallel, [&] ( std::size_t aBegin, std::size_t aEnd )
+	{
+		using namespace simd;
+
+		std::size_t i = aBegin;
+		for( ; i + 8 <= aEnd; i += 8 )
+		{
+			Float8 const x = load8( aIn.x + i );
+			Float8 const y = load8( aIn.y + i );
+			Float8 const z = load8( aIn.z + i );
+			Float8 const w = load8( aIn.w + i );
+
+			store8( aOut.x + i, mul_add( m[0], x, mul_add( m[1], y, mul_add( m[2], z, mul( m[3], w ) ) ) ) );
+			store8( aOut.y + i, mul_add( m[4], x, mul_add( m[5], y, mul_add( m[6], z, mul( m[7], w ) ) ) ) );
+			store8( aOut.z + i, mul_add( m[8], x, mul_add( m[9], y, mul_add( m[10], z, mul( m[11], w ) ) ) ) );
+			store8( aOut.w + i, mul_add( m[12], x, mul_add( m[13], y, mul_add( m[14], z, mul( m[15], w ) ) ) ) );
+		}
+
+		for( ; i < aEnd; ++i )
+		{
+			float const x = aIn.x[i], y = aIn.y[i], z = aIn.z[i], w = aIn.w[i];
+			aOut.x[i] = aMatrix( 0, 0 ) * x + aMatrix( 0, 1 ) * y + aMatrix( 0, 2 ) * z + aMatrix( 0, 3 ) * w;
+			aOut.y[i] = aMatrix( 1, 0 ) * x + aMatrix( 1, 1 ) * y + aMatrix( 1, 2 ) * z + aMatrix( 1, 3 ) * w;
+			aOut.z[i] = aMatrix( 2, 0 ) * x + aMatrix( 2, 1 ) * y + aMatrix( 2, 2 ) * z + aMatrix( 2, 3 ) * w;
+			aOut.w[i] = aMatrix( 3, 0 ) * x + aMatrix( 3, 1 ) * y + aMatrix( 3, 2 ) * z + aMatrix( 3, 3 ) * w;
+		}
+	} );
+}
+
+void transform_aabbs( Mat44f const& aMatrix, ConstVec3fArrays aMin, ConstVec3fArrays aMax, Vec3fArrays aOutMin, Vec3fArrays aOutMax, std::size_t aCount, ParallelFor const* aParallel )
+{
+	AffineRows8 const rows( aMatrix );
+
+	Mat44f absolute = aMatrix;
+	for( auto& value : absolute.v )
+		value = std::abs( value );
+
+	AffineRows8 const absoluteRows( absolute );
+
+	dispatch_( aCount, aParallel, [&] ( std::size_t aBegin, std::size_t aEnd )
+	{
+		using namespace simd;
+		auto const& m = rows.m;
+		auto const& a = absoluteRows.m;
+		Float8 const half = splat8( 0.5f );
+
+		std::size_t i = aBegin;
+		for( ; i + 8 <= aEnd; i += 8 )
+		{
+			Float8 const minX = load8( aMin.x + i ), maxX = load8( aMax.x + i );
+			Float8 const minY = load8( aMin.y + i ), maxY = load8( aMax.y + i );
+			Float8 const minZ = load8( aMin.z + i ), maxZ = load8( aMax.z + i );
+
+			Float8 const cx = mul( add( minX, maxX ), half );
+			Float8 const cy = mul( add( minY, maxY ), half );
+			Float8 const cz = mul( add( minZ, maxZ ), half );
+			Float8 const ex = mul( sub( maxX, minX ), half );
+			Float8 const ey = mul( sub( maxY, minY ), half );
+			Float8 const ez = mul( sub( maxZ, minZ ), half );
+
+			Float8 const centerX = mul_add( m[0], cx, mul_add( m[1], cy, mul_add( m[2], cz, m[3] ) ) );
+			Float8 const centerY = mul_add( m[4], cx, mul_add( m[5], cy, mul_add( m[6], cz, m[7] ) ) );
+			Float8 const centerZ = mul_add( m[8], cx, mul_add( m[9], cy, mul_add( m[10], cz, m[11] ) ) );
+			Float8 const extentX = mul_add( a[0], ex, mul_add( a[1], ey, mul( a[2], ez ) ) );
+			Float8 const extentY = mul_add( a[4], ex, mul_add( a[5], ey, mul( a[6], ez ) ) );
+			Float8 const extentZ = mul_add( a[8], ex, mul_add( a[9], ey, mul( a[10], ez ) ) );
+
+			store8( aOutMin.x + i, sub( centerX, extentX ) );
+			store8( aOutMin.y + i, sub( centerY, extentY ) );
+			store8( aOutMin.z + i, sub( centerZ, extentZ ) );
+			store8( aOutMax.x + i, add( centerX, extentX ) );
+			store8( aOutMax.y + i, add( centerY, extentY ) );
+			store8( aOutMax.z + i, add( centerZ, extentZ ) );
+		}
+
+		for( ; i < aEnd; ++i )
+		{
+			float const c[3] = { (aMin.x[i] + aMax.x[i]) * 0.5f, (aMin.y[i] + aMax.y[i]) * 0.5f, (aMin.z[i] + aMax.z[i]) * 0.5f };
+			float const e[3] = { (aMax.x[i] - aMin.x[i]) * 0.5f, (aMax.y[i] - aMin.y[i]) * 0.5f, (aMax.z[i] - aMin.z[i]) * 0.5f };
+
+			float center[3], extent[3];
+			for( std::size_t r = 0; r < 3; ++r )
+			{
+				center[r] = aMatrix( r, 0 ) * c[0] + aMatrix( r, 1 ) * c[1] + aMatrix( r, 2 ) * c[2] + aMatrix( r, 3 );
+				extent[r] = absolute( r, 0 ) * e[0] + absolute( r, 1 ) * e[1] + absolute( r, 2 ) * e[2];
+			}
+
+			aOutMin.x[i] = center[0] - extent[0];
+			aOutMin.y[i] = center[1] - extent[1];
+			aOutMin.z[i] = center[2] - extent[2];
+			aOutMax.x[i] = center[0] + extent[0];
+			aOutMax.y[i] = center[1] + extent[1];
+			aOutMax.z[i] = center[2] + extent[2];
+		}
+	} );
+}
+
+
+FrustumPlanes make_frustum_planes( Mat44f const& aViewProjection ) noexcept
+{
+	auto const row = [&aViewProjection] ( std::size_t aI ) -> Vec4f
+	{
+		return { aViewProjection( aI, 0 ), aViewProjection( aI, 1 ), aViewProjection( aI, 2 ), aViewProjection( aI, 3 ) };
+	};
+
+	Vec4f const x = row( 0 ), y = row( 1 ), z = row( 2 ), w = row( 3 );
+
+	FrustumPlanes result{ {
+		w + x, w - x,
+		w + y, w - y,
+		w + z, w - z
+	} };
+
+	for( auto& plane : result.planes )
+	{
+		float const length = std::sqrt( plane.x * plane.x + plane.y * plane.y + plane.z * plane.z );
+		plane = plane / length;
+	}
+
+	return result;
+}
+
+std::size_t cull_spheres( FrustumPlanes const& aFrustum, ConstVec4fArrays aSpheres, std::uint8_t* aVisible, std::size_t aCount, ParallelFor const* aParallel )
+{
+	std::atomic<std::size_t> visibleCount{ 0 };
+
+	dispatch_( aCount, aParallel, [&] ( std::size_t aBegin, std::size_t aEnd )
+	{
+		using namespace simd;
+
+		Float8 planes[6][4];
+		for( std::size_t p = 0; p < 6; ++p )
+		{
+			Vec4f const& plane = aFrustum.planes[p];
+			planes[p][0] = splat8( plane.x );
+			planes[p][1] = splat8( plane.y );
+			planes[p][2] = splat8( plane.z );
+			planes[p][3] = splat8( plane.w );
+		}
+
+		std::size_t visible = 0;
+
+		std::size_t i = aBegin;
+		for( ; i + 8 <= aEnd; i += 8 )
+		{
+			Float8 const x = load8( aSpheres.x + i );
+			Float8 const y = load8( aSpheres.y + i );
+			Float8 const z = load8( aSpheres.z + i );
+			Float8 const radius = load8( aSpheres.w + i );
+
+			// Smallest signed distance plus radius over the planes, negative
+			// when outside any of them
+			Float8 closest = mul_add( planes[0][0], x, mul_add( planes[0][1], y, mul_add( planes[0][2], z, add( planes[0][3], radius ) ) ) );
+			for( std::size_t p = 1; p < 6; ++p )
+				closest = min( closest, mul_add( planes[p][0], x, mul_add( planes[p][1], y, mul_add( planes[p][2], z, add( planes[p][3], radius ) ) ) ) );
+
+			unsigned const mask = nonnegative_mask( closest );
+			for( std::size_t lane = 0; lane < 8; ++lane )
+			{
+				unsigned const inside = (mask >> lane) & 1u;
+				aVisible[i + lane] = std::uint8_t( inside );
+				visible += inside;
+			}
+		}
+
+		for( ; i < aEnd; ++i )
+		{
+			bool inside = true;
+			for( auto const& plane : aFrustum.planes )
+				inside = inside && plane.x * aSpheres.x[i] + plane.y * aSpheres.y[i] + plane.z * aSpheres.z[i] + plane.w + aSpheres.w[i] >= 0.0f;
+
+			aVisible[i] = inside ? 1 : 0;
+			visible += inside ? 1 : 0;
+		}
+
+		visibleCount += visible;
+	} );
+
+	return visibleCount.load();
+}
@@ -0,0 +1,93 @@
+#ifndef BATCH_HPP_3F0C6B52_8E1D_4A7B_9C25_71D4E0A8B6F3
+#define BATCH_HPP_3F0C6B52_8E1D_4A7B_9C25_71D4E0A8B6F3
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "vec4.hpp"
+#include "mat44.hpp"
+
+/** Kernels over many points, boxes or spheres at once.
+ *
+ * Inputs and outputs are structure-of-arrays views: element i of a
+ * Vec3fArrays is ( x[i], y[i], z[i] ). That keeps a vector register full of
+ * the same component of eight elements (simd::Float8), with no shuffles. The
+ * views do not own their storage; outputs may alias the matching inputs.
+ *
+ * Counts at or above kBatchParallelThreshold are split across threads when a
+ * ParallelFor is given, smaller ones always run on the calling thread.
+ */
+
+struct Vec3fArrays
+{
+	float* x;
+	float* y;
+	float* z;
+};
+struct ConstVec3fArrays
+{
+	float const* x;
+	float const* y;
+	float const* z;
+};
+
+struct Vec4fArrays
+{
+	float* x;
+	float* y;
+	float* z;
+	float* w;
+};
+struct ConstVec4fArrays
+{
+	float const* x;
+	float const* y;
+	float const* z;
+	float const* w;
+};
+
+/* Runs aTask( chunk, begin, end ) over chunks of [0, aCount) no smaller than
+ * aMinChunkSize and returns when every chunk is done. The shape of
+ * ThreadPool::parallelFor() in main, so a pool can be passed through a
+ * lambda; make_thread_parallel_for() is a pool-less fallback.
+ */
+using ParallelTask = std::function<void( std::size_t, std::size_t, std::size_t )>;
+using ParallelFor = std::function<void( std::size_t aCount, std::size_t aMinChunkSize, ParallelTask const& aTask )>;
+
+constexpr std::size_t kBatchParallelThreshold = std::size_t(1) << 15;
+constexpr std::size_t kBatchMinChunkSize = std::size_t(1) << 13;
+
+// Starts aThreadCount std::threads per call, 0 is one per hardware thread
+ParallelFor make_thread_parallel_for( unsigned aThreadCount = 0 );
+
+
+// aOut[i] = aMatrix * ( aIn[i], 1 ), w dropped: affine matrices only
+void transform_points( Mat44f const& aMatrix, ConstVec3fArrays aIn, Vec3fArrays aOut, std::size_t aCount, ParallelFor const* aParallel = nullptr );
+
+// aOut[i] = aMatrix * aIn[i]
+void transform_vec4s( Mat44f const& aMatrix, ConstVec4fArrays aIn, Vec4fArrays aOut, std::size_t aCount, ParallelFor const* aParallel = nullptr );
+
+// World-space boxes around the transformed boxes, as transform_points() does
+// with the centres and |aMatrix| with the half extents (Arvo)
+void transform_aabbs( Mat44f const& aMatrix, ConstVec3fArrays aMin, ConstVec3fArrays aMax, Vec3fArrays aOutMin, Vec3fArrays aOutMax, std::size_t aCount, ParallelFor const* aParallel = nullptr );
+
+
+/* Frustum planes ( a, b, c, d ) with normals pointing inwards and
+ * normalized, so a * x + b * y + c * z + d is a signed distance. Left,
+ * right, bottom, top, near, far, taken from the rows of aViewProjection
+ * (Gribb and Hartmann), OpenGL clip space.
+ */
+struct FrustumPlanes
+{
+	Vec4f planes[6];
+};
+
+FrustumPlanes make_frustum_planes( Mat44f const& aViewProjection ) noexcept;
+
+// aVisible[i] = 1 when sphere ( x, y, z ) of radius w is at least partly
+// inside the frustum, 0 when it is fully outside a plane. Returns the count
+// of visible spheres.
+std::size_t cull_spheres( FrustumPlanes const& aFrustum, ConstVec4fArrays aSpheres, std::uint8_t* aVisible, std::size_t aCount, ParallelFor const* aParallel = nullptr );
+
+#endif // BATCH_HPP_3F0C6B52_8E1D_4A7B_9C25_71D4E0A8B6F3
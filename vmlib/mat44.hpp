@@ -8,6 +8,7 @@
 #include "vec3.hpp"
 #include "vec4.hpp"
 #include "utils.hpp"
+#include "simd.hpp"
 
 /** Mat44f: 4x4 matrix with floats
  *
@@ -54,13 +55,12 @@ constexpr Mat44f kIdentity44f = { {
 	0.f, 0.f, 0.f, 1.f
 } };
 
-// Common operators for Mat44f.
-// Note that you will need to implement these yourself.
+// Scalar versions of the operators and functions below. They are constexpr,
+// so the operators fall back to them in constant expressions.
 
 constexpr
-Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
+Mat44f multiply_scalar( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 {
-	//TODO: your implementation goes here
 	Vec4f leftRow0 = { aLeft(0, 0), aLeft(0, 1),  aLeft(0, 2),  aLeft(0, 3) };
 	Vec4f leftRow1 = { aLeft(1, 0), aLeft(1, 1),  aLeft(1, 2),  aLeft(1, 3) };
 	Vec4f leftRow2 = { aLeft(2, 0), aLeft(2, 1),  aLeft(2, 2),  aLeft(2, 3) };
@@ -96,9 +96,8 @@ Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 }
 
 constexpr
-Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
+Vec4f multiply_scalar( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
 {
-	//TODO: your implementation goes here
 	Vec4f leftRow0 = { aLeft(0, 0), aLeft(0, 1),  aLeft(0, 2),  aLeft(0, 3) };
 	Vec4f leftRow1 = { aLeft(1, 0), aLeft(1, 1),  aLeft(1, 2),  aLeft(1, 3) };
 	Vec4f leftRow2 = { aLeft(2, 0), aLeft(2, 1),  aLeft(2, 2),  aLeft(2, 3) };
@@ -113,148 +112,370 @@ Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
 	return result;
 }
 
-// Functions:
+constexpr
+Mat44f transpose_scalar( Mat44f const& aMatrix ) noexcept
+{
+	Mat44f result = kIdentity44f;
 
-inline
-Mat44f make_rotation_x( float aAngle ) noexcept
+	for( std::size_t i = 0; i < 4; ++i )
+	{
+		for( std::size_t j = 0; j < 4; ++j )
+			result(j, i) = aMatrix(i, j);
+	}
+
+	return result;
+}
+
+// Cofactors over the determinant. The matrix must be invertible.
+constexpr
+Mat44f invert_scalar( Mat44f const& aMatrix ) noexcept
 {
-	//TODO: your implementation goes here
+	float const* m = aMatrix.v;
 	Mat44f result = kIdentity44f;
+	float* inv = result.v;
 
-	result(0, 0) = 1.0f;
-	result(0, 1) = 0.0f;
-	result(0, 2) = 0.0f;
-	result(0, 3) = 0.0f;
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
 
-	result(1, 0) = 0.0f;
-	result(1, 1) = std::cos(toRadians(aAngle));
-	result(1, 2) = -std::sin(toRadians(aAngle));
-	result(1, 3) = 0.0f;
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
 
-	result(2, 0) = 0.0f;
-	result(2, 1) = std::sin(toRadians(aAngle));
-	result(2, 2) = std::cos(toRadians(aAngle));
-	result(2, 3) = 0.0f;
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
 
-	result(3, 0) = 0.0f;
-	result(3, 1) = 0.0f;
-	result(3, 2) = 0.0f;
-	result(3, 3) = 1.0f;
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float const determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+
+	for( std::size_t i = 0; i < 16; ++i )
+		inv[i] /= determinant;
 
 	return result;
 }
 
+// Vector versions, see simd.hpp. Rows are loaded whole, so a product row is
+// the left row's elements broadcast against the right rows.
+
 inline
-Mat44f make_rotation_y( float aAngle ) noexcept
+Mat44f multiply_simd( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 {
-	//TODO: your implementation goes here
 	Mat44f result;
 
-	result(0, 0) = std::cos(toRadians(aAngle));
-	result(0, 1) = 0.0f;
-	result(0, 2) = std::sin(toRadians(aAngle));
-	result(0, 3) = 0.0f;
+#	if defined(VMLIB_SIMD_AVX512)
+	// The whole matrix in one register, each right row copied to all four
+	// 128-bit lanes. The masked forms with every lane set give GCC 12 a
+	// defined source, its unmasked ones warn about _mm512_undefined_ps().
+	__m512 const left = _mm512_loadu_ps( aLeft.v );
+	__m512 const right = _mm512_loadu_ps( aRight.v );
+	__mmask16 const all = 0xFFFF;
+
+	__m512 rows = _mm512_mul_ps( _mm512_mask_permute_ps( left, all, left, 0x00 ), _mm512_mask_shuffle_f32x4( right, all, right, right, 0x00 ) );
+	rows = _mm512_add_ps( rows, _mm512_mul_ps( _mm512_mask_permute_ps( left, all, left, 0x55 ), _mm512_mask_shuffle_f32x4( right, all, right, right, 0x55 ) ) );
+	rows = _mm512_add_ps( rows, _mm512_mul_ps( _mm512_mask_permute_ps( left, all, left, 0xAA ), _mm512_mask_shuffle_f32x4( right, all, right, right, 0xAA ) ) );
+	rows = _mm512_add_ps( rows, _mm512_mul_ps( _mm512_mask_permute_ps( left, all, left, 0xFF ), _mm512_mask_shuffle_f32x4( right, all, right, right, 0xFF ) ) );
+
+	_mm512_storeu_ps( result.v, rows );
+#	elif defined(VMLIB_SIMD_AVX)
+	// Two result rows per 8-wide register. vbroadcastf128 has no alignment
+	// requirement.
+	__m256 const rightPair0 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>( aRight.v + 0 ) );
+	__m256 const rightPair1 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>( aRight.v + 4 ) );
+	__m256 const rightPair2 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>( aRight.v + 8 ) );
+	__m256 const rightPair3 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>( aRight.v + 12 ) );
+
+	for( std::size_t i = 0; i < 16; i += 8 )
+	{
+		__m256 const left = _mm256_loadu_ps( aLeft.v + i );
+
+		__m256 row = _mm256_mul_ps( _mm256_permute_ps( left, 0x00 ), rightPair0 );
+		row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( left, 0x55 ), rightPair1 ) );
+		row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( left, 0xAA ), rightPair2 ) );
+		row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( left, 0xFF ), rightPair3 ) );
+
+		_mm256_storeu_ps( result.v + i, row );
+	}
+#	else
+	simd::Float4 const right0 = simd::load( aRight.v + 0 );
+	simd::Float4 const right1 = simd::load( aRight.v + 4 );
+	simd::Float4 const right2 = simd::load( aRight.v + 8 );
+	simd::Float4 const right3 = simd::load( aRight.v + 12 );
 
-	result(1, 0) = 0.0f;
-	result(1, 1) = 1.0f;
-	result(1, 2) = 0.0f;
-	result(1, 3) = 0.0f;
+	for( std::size_t i = 0; i < 16; i += 4 )
+	{
+		simd::Float4 const left = simd::load( aLeft.v + i );
 
-	result(2, 0) = -std::sin(toRadians(aAngle));
-	result(2, 1) = 0.0f;
-	result(2, 2) = std::sin(toRadians(aAngle));
-	result(2, 3) = std::cos(toRadians(aAngle));
+		simd::Float4 row = simd::mul( simd::broadcast<0>( left ), right0 );
+		row = simd::add( row, simd::mul( simd::broadcast<1>( left ), right1 ) );
+		row = simd::add( row, simd::mul( simd::broadcast<2>( left ), right2 ) );
+		row = simd::add( row, simd::mul( simd::broadcast<3>( left ), right3 ) );
 
-	result(3, 0) = 0.0f;
-	result(3, 1) = 0.0f;
-	result(3, 2) = 0.0f;
-	result(3, 3) = 1.0f;
+		simd::store( result.v + i, row );
+	}
+#	endif
 
 	return result;
 }
 
 inline
-Mat44f make_rotation_z( float aAngle ) noexcept
+Vec4f multiply_simd( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
 {
-	//TODO: your implementation goes here
-	Mat44f result = kIdentity44f;
+	simd::Float4 const product = simd::dot4(
+		simd::load( aLeft.v + 0 ),
+		simd::load( aLeft.v + 4 ),
+		simd::load( aLeft.v + 8 ),
+		simd::load( aLeft.v + 12 ),
+		simd::set( aRight.x, aRight.y, aRight.z, aRight.w )
+	);
+
+	Vec4f result;
+	simd::store( &result.x, product );
+	return result;
+}
 
-	result(0, 0) = std::cos(toRadians(aAngle));
-	result(0, 1) = -std::sin(toRadians(aAngle));
-	result(0, 2) = 0.0f;
-	result(0, 3) = 0.0f;
+inline
+Mat44f transpose_simd( Mat44f const& aMatrix ) noexcept
+{
+	simd::Float4 row0 = simd::load( aMatrix.v + 0 );
+	simd::Float4 row1 = simd::load( aMatrix.v + 4 );
+	simd::Float4 row2 = simd::load( aMatrix.v + 8 );
+	simd::Float4 row3 = simd::load( aMatrix.v + 12 );
 
-	result(1, 0) = std::sin(toRadians(aAngle));
-	result(1, 1) = std::cos(toRadians(aAngle));
-	result(1, 2) = 0.0f;
-	result(1, 3) = 0.0f;
+	simd::transpose( row0, row1, row2, row3 );
 
-	result(2, 0) = 0.0f;
-	result(2, 1) = 0.0f;
-	result(2, 2) = 1.0f;
-	result(2, 3) = 0.0f;
+	Mat44f result;
+	simd::store( result.v + 0, row0 );
+	simd::store( result.v + 4, row1 );
+	simd::store( result.v + 8, row2 );
+	simd::store( result.v + 12, row3 );
+	return result;
+}
 
-	result(3, 0) = 0.0f;
-	result(3, 1) = 0.0f;
-	result(3, 2) = 0.0f;
-	result(3, 3) = 1.0f;
+namespace detail
+{
+	// 2x2 matrices held row by row in one vector
 
-	return result;
+	// aLeft * aRight
+	inline
+	simd::Float4 mat2_mul( simd::Float4 aLeft, simd::Float4 aRight ) noexcept
+	{
+		return simd::add(
+			simd::mul( aLeft, simd::swizzle< 0, 3, 0, 3 >( aRight ) ),
+			simd::mul( simd::swizzle< 1, 0, 3, 2 >( aLeft ), simd::swizzle< 2, 1, 2, 1 >( aRight ) )
+		);
+	}
+	// adjugate( aLeft ) * aRight
+	inline
+	simd::Float4 mat2_adj_mul( simd::Float4 aLeft, simd::Float4 aRight ) noexcept
+	{
+		return simd::sub(
+			simd::mul( simd::swizzle< 3, 3, 0, 0 >( aLeft ), aRight ),
+			simd::mul( simd::swizzle< 1, 1, 2, 2 >( aLeft ), simd::swizzle< 2, 3, 0, 1 >( aRight ) )
+		);
+	}
+	// aLeft * adjugate( aRight )
+	inline
+	simd::Float4 mat2_mul_adj( simd::Float4 aLeft, simd::Float4 aRight ) noexcept
+	{
+		return simd::sub(
+			simd::mul( aLeft, simd::swizzle< 3, 0, 3, 0 >( aRight ) ),
+			simd::mul( simd::swizzle< 1, 0, 3, 2 >( aLeft ), simd::swizzle< 2, 1, 2, 1 >( aRight ) )
+		);
+	}
 }
 
+// Blockwise inverse over the four 2x2 sub-matrices
+//   ⎛ A  B ⎞
+//   ⎝ C  D ⎠
+// with the 2x2 adjugates in place of 2x2 inverses. The matrix must be
+// invertible.
 inline
-Mat44f make_translation( Vec3f aTranslation ) noexcept
+Mat44f invert_simd( Mat44f const& aMatrix ) noexcept
 {
-	//TODO: your implementation goes here
-	Mat44f result = kIdentity44f;
-
-	result(0, 3) = aTranslation.x;
-	result(1, 3) = aTranslation.y;
-	result(2, 3) = aTranslation.z;
+	using namespace detail;
+
+	simd::Float4 const row0 = simd::load( aMatrix.v + 0 );
+	simd::Float4 const row1 = simd::load( aMatrix.v + 4 );
+	simd::Float4 const row2 = simd::load( aMatrix.v + 8 );
+	simd::Float4 const row3 = simd::load( aMatrix.v + 12 );
+
+	simd::Float4 const a = simd::shuffle< 0, 1, 0, 1 >( row0, row1 );
+	simd::Float4 const b = simd::shuffle< 2, 3, 2, 3 >( row0, row1 );
+	simd::Float4 const c = simd::shuffle< 0, 1, 0, 1 >( row2, row3 );
+	simd::Float4 const d = simd::shuffle< 2, 3, 2, 3 >( row2, row3 );
+
+	// ( |A|, |B|, |C|, |D| )
+	simd::Float4 const determinants = simd::sub(
+		simd::mul( simd::shuffle< 0, 2, 0, 2 >( row0, row2 ), simd::shuffle< 1, 3, 1, 3 >( row1, row3 ) ),
+		simd::mul( simd::shuffle< 1, 3, 1, 3 >( row0, row2 ), simd::shuffle< 0, 2, 0, 2 >( row1, row3 ) )
+	);
+	simd::Float4 const detA = simd::broadcast<0>( determinants );
+	simd::Float4 const detB = simd::broadcast<1>( determinants );
+	simd::Float4 const detC = simd::broadcast<2>( determinants );
+	simd::Float4 const detD = simd::broadcast<3>( determinants );
+
+	simd::Float4 const adjDC = mat2_adj_mul( d, c );
+	simd::Float4 const adjAB = mat2_adj_mul( a, b );
+
+	// Adjugates of the inverse's blocks, times |M|
+	simd::Float4 x = simd::sub( simd::mul( detD, a ), mat2_mul( b, adjDC ) );
+	simd::Float4 w = simd::sub( simd::mul( detA, d ), mat2_mul( c, adjAB ) );
+	simd::Float4 y = simd::sub( simd::mul( detB, c ), mat2_mul_adj( d, adjAB ) );
+	simd::Float4 z = simd::sub( simd::mul( detC, b ), mat2_mul_adj( a, adjDC ) );
+
+	// |M| = |A| |D| + |B| |C| - tr( adj(A) B adj(D) C )
+	simd::Float4 const trace = simd::sum( simd::mul( adjAB, simd::swizzle< 0, 2, 1, 3 >( adjDC ) ) );
+	simd::Float4 const determinant = simd::sub( simd::add( simd::mul( detA, detD ), simd::mul( detB, detC ) ), trace );
+
+	// Signs of the 2x2 adjugate, undone by the shuffles below
+	simd::Float4 const scale = simd::div( simd::set( 1.f, -1.f, -1.f, 1.f ), determinant );
+
+	x = simd::mul( x, scale );
+	y = simd::mul( y, scale );
+	z = simd::mul( z, scale );
+	w = simd::mul( w, scale );
 
+	Mat44f result;
+	simd::store( result.v + 0, simd::shuffle< 3, 1, 3, 1 >( x, y ) );
+	simd::store( result.v + 4, simd::shuffle< 2, 0, 2, 0 >( x, y ) );
+	simd::store( result.v + 8, simd::shuffle< 3, 1, 3, 1 >( z, w ) );
+	simd::store( result.v + 12, simd::shuffle< 2, 0, 2, 0 >( z, w ) );
 	return result;
 }
 
-inline
-Mat44f make_scaling( float aSX, float aSY, float aSZ ) noexcept
+// Common operators for Mat44f. Vector code at run time, the scalar versions
+// at compile time.
+
+constexpr
+Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 {
-	//TODO: your implementation goes here
-	Mat44f result = kIdentity44f;
+#	if VMLIB_SIMD
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return multiply_simd( aLeft, aRight );
+#	endif
+	return multiply_scalar( aLeft, aRight );
+}
 
-	result(0, 0) = aSX;
-	result(1, 1) = aSY;
-	result(2, 2) = aSZ;
+constexpr
+Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
+{
+#	if VMLIB_SIMD
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return multiply_simd( aLeft, aRight );
+#	endif
+	return multiply_scalar( aLeft, aRight );
+}
 
-	return result;
+// Functions:
+
+constexpr
+Mat44f transpose( Mat44f const& aMatrix ) noexcept
+{
+#	if VMLIB_SIMD
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return transpose_simd( aMatrix );
+#	endif
+	return transpose_scalar( aMatrix );
 }
 
+constexpr
+Mat44f invert( Mat44f const& aMatrix ) noexcept
+{
+#	if VMLIB_SIMD
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return invert_simd( aMatrix );
+#	endif
+	return invert_scalar( aMatrix );
+}
+
+// The builders take their sines and cosines once and write whole rows; the
+// trigonometry is what they cost.
+
 inline
-Mat44f make_perspective_projection( float aFovInRadians, float aAspect, float aNear, float aFar ) noexcept
+Mat44f make_rotation_x( float aAngle ) noexcept
 {
-	//TODO: your implementation goes here
-	Mat44f result = kIdentity44f;
+	float const c = std::cos( toRadians( aAngle ) );
+	float const s = std::sin( toRadians( aAngle ) );
+
+	return { {
+		1.f, 0.f, 0.f, 0.f,
+		0.f,   c,  -s, 0.f,
+		0.f,   s,   c, 0.f,
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
 
-	result(0, 0) = 1.0f / (aAspect * std::tan(aFovInRadians));
-	result(0, 1) = 0.0f;
-	result(0, 2) = 0.0f;
-	result(0, 3) = 0.0f;
+inline
+Mat44f make_rotation_y( float aAngle ) noexcept
+{
+	float const c = std::cos( toRadians( aAngle ) );
+	float const s = std::sin( toRadians( aAngle ) );
+
+	return { {
+		  c, 0.f,   s, 0.f,
+		0.f, 1.f, 0.f, 0.f,
+		 -s, 0.f,   c, 0.f,
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
 
-	result(1, 0) = 0.0f;
-	result(1, 1) = 1.0f / std::tan(aFovInRadians);
-	result(1, 2) = 0.0f;
-	result(1, 3) = 0.0f;
+inline
+Mat44f make_rotation_z( float aAngle ) noexcept
+{
+	float const c = std::cos( toRadians( aAngle ) );
+	float const s = std::sin( toRadians( aAngle ) );
+
+	return { {
+		  c,  -s, 0.f, 0.f,
+		  s,   c, 0.f, 0.f,
+		0.f, 0.f, 1.f, 0.f,
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
 
-	result(2, 0) = 0.0f;
-	result(2, 1) = 0.0f;
-	result(2, 2) = -(aFar + aNear) / (aFar - aNear);
-	result(2, 3) = -2.0f * aFar * aNear / (aFar - aNear);
+constexpr
+Mat44f make_translation( Vec3f aTranslation ) noexcept
+{
+	return { {
+		1.f, 0.f, 0.f, aTranslation.x,
+		0.f, 1.f, 0.f, aTranslation.y,
+		0.f, 0.f, 1.f, aTranslation.z,
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
 
-	result(3, 0) = 0.0f;
-	result(3, 1) = 0.0f;
-	result(3, 2) = -1.0f;
-	result(3, 3) = 0.0f;
+constexpr
+Mat44f make_scaling( float aSX, float aSY, float aSZ ) noexcept
+{
+	return { {
+		aSX, 0.f, 0.f, 0.f,
+		0.f, aSY, 0.f, 0.f,
+		0.f, 0.f, aSZ, 0.f,
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
 
-	return result;
+// aFovInRadians is the full vertical field of view, as in glm::perspective()
+inline
+Mat44f make_perspective_projection( float aFovInRadians, float aAspect, float aNear, float aFar ) noexcept
+{
+	float const s = 1.f / std::tan( aFovInRadians * 0.5f );
+	float const depth = 1.f / (aFar - aNear);
+
+	return { {
+		s / aAspect, 0.f, 0.f, 0.f,
+		0.f, s, 0.f, 0.f,
+		0.f, 0.f, -(aFar + aNear) * depth, -2.f * aFar * aNear * depth,
+		0.f, 0.f, -1.f, 0.f
+	} };
 }
 
 inline Mat44f lookAt(const Vec3f& eye, const Vec3f& center, const Vec3f& up)
@@ -0,0 +1,504 @@
+#ifndef SIMD_HPP_ADFDA120_E966_41E6_A402_F628D2BF3ED9
+#define SIMD_HPP_ADFDA120_E966_41E6_A402_F628D2BF3ED9
+
+#include <cstddef>
+
+/** Four-wide float vectors for the run time paths of the vmlib operators.
+ *
+ * Backed by SSE on x86 (always there on x86-64), NEON on ARM and a plain
+ * array elsewhere. The operators only use what the simd namespace declares,
+ * so another instruction set is one more block below.
+ *
+ * The operators stay constexpr. VMLIB_SIMD is 1 when they may take the
+ * vector path, which needs a vector instruction set and a way to tell
+ * whether they are being evaluated at compile time (C++20's
+ * std::is_constant_evaluated(), available as a builtin in C++17 mode on GCC
+ * 9+, clang 9+ and MSVC 19.25+). Define VMLIB_NO_SIMD to always use the
+ * scalar path.
+ */
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	define VMLIB_SIMD_SSE 1
+#	include <xmmintrin.h>
+#	if defined(__AVX__)
+#		define VMLIB_SIMD_AVX 1
+#		include <immintrin.h>
+#	endif
+#	if defined(__AVX512F__)
+#		define VMLIB_SIMD_AVX512 1
+#	endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define VMLIB_SIMD_NEON 1
+#	include <arm_neon.h>
+#endif
+
+#if defined(__has_builtin)
+#	if __has_builtin(__builtin_is_constant_evaluated)
+#		define VMLIB_HAS_IS_CONSTANT_EVALUATED 1
+#	endif
+#endif
+#if !defined(VMLIB_HAS_IS_CONSTANT_EVALUATED) && ((defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925))
+#	define VMLIB_HAS_IS_CONSTANT_EVALUATED 1
+#endif
+
+#if (defined(VMLIB_SIMD_SSE) || defined(VMLIB_SIMD_NEON)) && defined(VMLIB_HAS_IS_CONSTANT_EVALUATED) && !defined(VMLIB_NO_SIMD)
+#	define VMLIB_SIMD 1
+#	define VMLIB_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#	define VMLIB_SIMD 0
+#endif
+
+namespace simd
+{
+#if defined(VMLIB_SIMD_SSE)
+	using Float4 = __m128;
+
+	inline
+	Float4 load( float const* aValues ) noexcept
+	{
+		return _mm_loadu_ps( aValues );
+	}
+	inline
+	void store( float* aValues, Float4 aVec ) noexcept
+	{
+		_mm_storeu_ps( aValues, aVec );
+	}
+	inline
+	Float4 set( float aX, float aY, float aZ, float aW ) noexcept
+	{
+		return _mm_setr_ps( aX, aY, aZ, aW );
+	}
+
+	inline
+	Float4 add( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_add_ps( aLeft, aRight );
+	}
+	inline
+	Float4 sub( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_sub_ps( aLeft, aRight );
+	}
+	inline
+	Float4 mul( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_mul_ps( aLeft, aRight );
+	}
+	inline
+	Float4 div( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_div_ps( aLeft, aRight );
+	}
+
+	inline
+	Float4 min( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_min_ps( aLeft, aRight );
+	}
+	inline
+	Float4 max( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return _mm_max_ps( aLeft, aRight );
+	}
+	inline
+	Float4 abs( Float4 aVec ) noexcept
+	{
+		return _mm_andnot_ps( _mm_set1_ps( -0.0f ), aVec );
+	}
+
+	// Bit i set when lane i is >= 0
+	inline
+	unsigned nonnegative_mask( Float4 aVec ) noexcept
+	{
+		return unsigned( _mm_movemask_ps( _mm_cmpge_ps( aVec, _mm_setzero_ps() ) ) );
+	}
+
+	// ( aA[X], aA[Y], aB[Z], aB[W] ), as _mm_shuffle_ps()
+	template< int tX, int tY, int tZ, int tW >
+	inline
+	Float4 shuffle( Float4 aA, Float4 aB ) noexcept
+	{
+		return _mm_shuffle_ps( aA, aB, _MM_SHUFFLE( tW, tZ, tY, tX ) );
+	}
+
+	inline
+	void transpose( Float4& aRow0, Float4& aRow1, Float4& aRow2, Float4& aRow3 ) noexcept
+	{
+		_MM_TRANSPOSE4_PS( aRow0, aRow1, aRow2, aRow3 );
+	}
+#elif defined(VMLIB_SIMD_NEON)
+	using Float4 = float32x4_t;
+
+	inline
+	Float4 load( float const* aValues ) noexcept
+	{
+		return vld1q_f32( aValues );
+	}
+	inline
+	void store( float* aValues, Float4 aVec ) noexcept
+	{
+		vst1q_f32( aValues, aVec );
+	}
+	inline
+	Float4 set( float aX, float aY, float aZ, float aW ) noexcept
+	{
+		float const values[4] = { aX, aY, aZ, aW };
+		return vld1q_f32( values );
+	}
+
+	inline
+	Float4 add( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return vaddq_f32( aLeft, aRight );
+	}
+	inline
+	Float4 sub( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return vsubq_f32( aLeft, aRight );
+	}
+	inline
+	Float4 mul( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return vmulq_f32( aLeft, aRight );
+	}
+	inline
+	Float4 div( Float4 aLeft, Float4 aRight ) noexcept
+	{
+#	if defined(__aarch64__) || defined(_M_ARM64)
+		return vdivq_f32( aLeft, aRight );
+#	else
+		// Estimate refined by two Newton-Raphson steps
+		Float4 reciprocal = vrecpeq_f32( aRight );
+		reciprocal = vmulq_f32( vrecpsq_f32( aRight, reciprocal ), reciprocal );
+		reciprocal = vmulq_f32( vrecpsq_f32( aRight, reciprocal ), reciprocal );
+		return vmulq_f32( aLeft, reciprocal );
+#	endif
+	}
+
+	inline
+	Float4 min( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return vminq_f32( aLeft, aRight );
+	}
+	inline
+	Float4 max( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return vmaxq_f32( aLeft, aRight );
+	}
+	inline
+	Float4 abs( Float4 aVec ) noexcept
+	{
+		return vabsq_f32( aVec );
+	}
+
+	// Bit i set when lane i is >= 0
+	inline
+	unsigned nonnegative_mask( Float4 aVec ) noexcept
+	{
+		uint32x4_t const lanes = vcgeq_f32( aVec, vdupq_n_f32( 0.0f ) );
+		return ( vgetq_lane_u32( lanes, 0 ) & 1u )
+			| ( vgetq_lane_u32( lanes, 1 ) & 2u )
+			| ( vgetq_lane_u32( lanes, 2 ) & 4u )
+			| ( vgetq_lane_u32( lanes, 3 ) & 8u );
+	}
+
+	// ( aA[X], aA[Y], aB[Z], aB[W] ), as _mm_shuffle_ps(). Lane moves with
+	// constant indices, which the compiler turns into the matching permute.
+	template< int tX, int tY, int tZ, int tW >
+	inline
+	Float4 shuffle( Float4 aA, Float4 aB ) noexcept
+	{
+		Float4 result = vdupq_n_f32( vgetq_lane_f32( aA, tX ) );
+		result = vsetq_lane_f32( vgetq_lane_f32( aA, tY ), result, 1 );
+		result = vsetq_lane_f32( vgetq_lane_f32( aB, tZ ), result, 2 );
+		return vsetq_lane_f32( vgetq_lane_f32( aB, tW ), result, 3 );
+	}
+
+	inline
+	void transpose( Float4& aRow0, Float4& aRow1, Float4& aRow2, Float4& aRow3 ) noexcept
+	{
+		float32x4x2_t const rows01 = vtrnq_f32( aRow0, aRow1 );
+		float32x4x2_t const rows23 = vtrnq_f32( aRow2, aRow3 );
+
+		aRow0 = vcombine_f32( vget_low_f32( rows01.val[0] ), vget_low_f32( rows23.val[0] ) );
+		aRow1 = vcombine_f32( vget_low_f32( rows01.val[1] ), vget_low_f32( rows23.val[1] ) );
+		aRow2 = vcombine_f32( vget_high_f32( rows01.val[0] ), vget_high_f32( rows23.val[0] ) );
+		aRow3 = vcombine_f32( vget_high_f32( rows01.val[1] ), vget_high_f32( rows23.val[1] ) );
+	}
+#else
+	// No vector unit, the same operations lane by lane
+	struct Float4
+	{
+		float v[4];
+	};
+
+	inline
+	Float4 load( float const* aValues ) noexcept
+	{
+		return { { aValues[0], aValues[1], aValues[2], aValues[3] } };
+	}
+	inline
+	void store( float* aValues, Float4 aVec ) noexcept
+	{
+		for( std::size_t i = 0; i < 4; ++i )
+			aValues[i] = aVec.v[i];
+	}
+	inline
+	Float4 set( float aX, float aY, float aZ, float aW ) noexcept
+	{
+		return { { aX, aY, aZ, aW } };
+	}
+
+	inline
+	Float4 add( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return { { aLeft.v[0] + aRight.v[0], aLeft.v[1] + aRight.v[1], aLeft.v[2] + aRight.v[2], aLeft.v[3] + aRight.v[3] } };
+	}
+	inline
+	Float4 sub( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return { { aLeft.v[0] - aRight.v[0], aLeft.v[1] - aRight.v[1], aLeft.v[2] - aRight.v[2], aLeft.v[3] - aRight.v[3] } };
+	}
+	inline
+	Float4 mul( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return { { aLeft.v[0] * aRight.v[0], aLeft.v[1] * aRight.v[1], aLeft.v[2] * aRight.v[2], aLeft.v[3] * aRight.v[3] } };
+	}
+	inline
+	Float4 div( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		return { { aLeft.v[0] / aRight.v[0], aLeft.v[1] / aRight.v[1], aLeft.v[2] / aRight.v[2], aLeft.v[3] / aRight.v[3] } };
+	}
+
+	inline
+	Float4 min( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		Float4 result;
+		for( std::size_t i = 0; i < 4; ++i )
+			result.v[i] = aRight.v[i] < aLeft.v[i] ? aRight.v[i] : aLeft.v[i];
+		return result;
+	}
+	inline
+	Float4 max( Float4 aLeft, Float4 aRight ) noexcept
+	{
+		Float4 result;
+		for( std::size_t i = 0; i < 4; ++i )
+			result.v[i] = aLeft.v[i] < aRight.v[i] ? aRight.v[i] : aLeft.v[i];
+		return result;
+	}
+	inline
+	Float4 abs( Float4 aVec ) noexcept
+	{
+		Float4 result;
+		for( std::size_t i = 0; i < 4; ++i )
+			result.v[i] = aVec.v[i] < 0.0f ? -aVec.v[i] : aVec.v[i];
+		return result;
+	}
+
+	// Bit i set when lane i is >= 0
+	inline
+	unsigned nonnegative_mask( Float4 aVec ) noexcept
+	{
+		unsigned mask = 0;
+		for( std::size_t i = 0; i < 4; ++i )
+			mask |= ( aVec.v[i] >= 0.0f ? 1u : 0u ) << i;
+		return mask;
+	}
+
+	template< int tX, int tY, int tZ, int tW >
+	inline
+	Float4 shuffle( Float4 aA, Float4 aB ) noexcept
+	{
+		return { { aA.v[tX], aA.v[tY], aB.v[tZ], aB.v[tW] } };
+	}
+
+	inline
+	void transpose( Float4& aRow0, Float4& aRow1, Float4& aRow2, Float4& aRow3 ) noexcept
+	{
+		Float4 const rows[4] = { aRow0, aRow1, aRow2, aRow3 };
+
+		for( std::size_t i = 0; i < 4; ++i )
+		{
+			aRow0.v[i] = rows[i].v[0];
+			aRow1.v[i] = rows[i].v[1];
+			aRow2.v[i] = rows[i].v[2];
+			aRow3.v[i] = rows[i].v[3];
+		}
+	}
+#endif
+
+	// Built on the above for every backend
+
+	inline
+	Float4 splat( float aValue ) noexcept
+	{
+		return set( aValue, aValue, aValue, aValue );
+	}
+
+	template< int tX, int tY, int tZ, int tW >
+	inline
+	Float4 swizzle( Float4 aVec ) noexcept
+	{
+		return shuffle< tX, tY, tZ, tW >( aVec, aVec );
+	}
+
+	template< int tLane >
+	inline
+	Float4 broadcast( Float4 aVec ) noexcept
+	{
+		return shuffle< tLane, tLane, tLane, tLane >( aVec, aVec );
+	}
+
+	// Sum of the four lanes, in every lane
+	inline
+	Float4 sum( Float4 aVec ) noexcept
+	{
+		Float4 const pairs = add( aVec, swizzle< 1, 0, 3, 2 >( aVec ) );
+		return add( pairs, swizzle< 2, 3, 0, 1 >( pairs ) );
+	}
+
+	// ( dot( aRow0, aVec ), ..., dot( aRow3, aVec ) ), without horizontal adds
+	inline
+	Float4 dot4( Float4 aRow0, Float4 aRow1, Float4 aRow2, Float4 aRow3, Float4 aVec ) noexcept
+	{
+		aRow0 = mul( aRow0, aVec );
+		aRow1 = mul( aRow1, aVec );
+		aRow2 = mul( aRow2, aVec );
+		aRow3 = mul( aRow3, aVec );
+
+		transpose( aRow0, aRow1, aRow2, aRow3 );
+
+		return add( add( aRow0, aRow1 ), add( aRow2, aRow3 ) );
+	}
+
+	/* Eight-wide float vectors for the structure-of-arrays kernels (see
+	 * batch.hpp), a lane per element. A single AVX register where there is
+	 * one, a pair of Float4s elsewhere.
+	 */
+#if defined(VMLIB_SIMD_AVX)
+	using Float8 = __m256;
+
+	inline
+	Float8 load8( float const* aValues ) noexcept
+	{
+		return _mm256_loadu_ps( aValues );
+	}
+	inline
+	void store8( float* aValues, Float8 aVec ) noexcept
+	{
+		_mm256_storeu_ps( aValues, aVec );
+	}
+	inline
+	Float8 splat8( float aValue ) noexcept
+	{
+		return _mm256_set1_ps( aValue );
+	}
+
+	inline
+	Float8 add( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return _mm256_add_ps( aLeft, aRight );
+	}
+	inline
+	Float8 sub( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return _mm256_sub_ps( aLeft, aRight );
+	}
+	inline
+	Float8 mul( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return _mm256_mul_ps( aLeft, aRight );
+	}
+	inline
+	Float8 min( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return _mm256_min_ps( aLeft, aRight );
+	}
+	inline
+	Float8 max( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return _mm256_max_ps( aLeft, aRight );
+	}
+	inline
+	Float8 abs( Float8 aVec ) noexcept
+	{
+		return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), aVec );
+	}
+
+	// Bit i set when lane i is >= 0
+	inline
+	unsigned nonnegative_mask( Float8 aVec ) noexcept
+	{
+		return unsigned( _mm256_movemask_ps( _mm256_cmp_ps( aVec, _mm256_setzero_ps(), _CMP_GE_OQ ) ) );
+	}
+#else
+	struct Float8
+	{
+		Float4 lo, hi;
+	};
+
+	inline
+	Float8 load8( float const* aValues ) noexcept
+	{
+		return { load( aValues ), load( aValues + 4 ) };
+	}
+	inline
+	void store8( float* aValues, Float8 aVec ) noexcept
+	{
+		store( aValues, aVec.lo );
+		store( aValues + 4, aVec.hi );
+	}
+	inline
+	Float8 splat8( float aValue ) noexcept
+	{
+		Float4 const value = splat( aValue );
+		return { value, value };
+	}
+
+	inline
+	Float8 add( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return { add( aLeft.lo, aRight.lo ), add( aLeft.hi, aRight.hi ) };
+	}
+	inline
+	Float8 sub( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return { sub( aLeft.lo, aRight.lo ), sub( aLeft.hi, aRight.hi ) };
+	}
+	inline
+	Float8 mul( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return { mul( aLeft.lo, aRight.lo ), mul( aLeft.hi, aRight.hi ) };
+	}
+	inline
+	Float8 min( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return { min( aLeft.lo, aRight.lo ), min( aLeft.hi, aRight.hi ) };
+	}
+	inline
+	Float8 max( Float8 aLeft, Float8 aRight ) noexcept
+	{
+		return { max( aLeft.lo, aRight.lo ), max( aLeft.hi, aRight.hi ) };
+	}
+	inline
+	Float8 abs( Float8 aVec ) noexcept
+	{
+		return { abs( aVec.lo ), abs( aVec.hi ) };
+	}
+
+	inline
+	unsigned nonnegative_mask( Float8 aVec ) noexcept
+	{
+		return nonnegative_mask( aVec.lo ) | ( nonnegative_mask( aVec.hi ) << 4 );
+	}
+#endif
+
+	// aA * aB + aC
+	inline
+	Float8 mul_add( Float8 aA, Float8 aB, Float8 aC ) noexcept
+	{
+		return add( mul( aA, aB ), aC );
+	}
+}
+
+#endif // SIMD_HPP_ADFDA120_E966_41E6_A402_F628D2BF3ED9